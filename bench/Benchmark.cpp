@@ -0,0 +1,160 @@
+#include "Benchmark.hpp"
+#include "Json.hpp"
+#include "Scenes.hpp"
+#include "HeadlessRunner.hpp"
+#include "buffer/MemoryStats.hpp"
+#include "profiler/Telemetry.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+
+BenchmarkResult Benchmark::run(const std::string& scene_name, uint32_t particles, std::string& device) {
+  BenchmarkResult result;
+  result.scene = scene_name;
+  result.particles = particles;
+
+  // Whole submits only, so every profiler sample covers the same step count
+  uint32_t batch = std::max(HeadlessRunner::steps_per_submit, 1u);
+  uint32_t steps = (std::max(measured_steps, 1u) + batch - 1) / batch * batch;
+
+  try {
+    BenchScene layout = Scenes::build(scene_name, particles, seed);
+
+    Scene::instances = particles;
+    Scene::max_instances = particles;
+    Scene::seed = seed;
+    Scene::cpu_simulation = false;
+    Scene::boundary_meshes = layout.boundary_meshes;
+    Scene::rigid_bodies = layout.bodies;
+
+    MemoryStats::reset_peak();
+
+    HeadlessRunner runner;
+    device = runner.device_name();
+
+    SimulationBackend& simulation = runner.get_scene().simulation();
+    simulation.set_boundary(layout.half_extent, layout.half_extent, layout.half_extent);
+    simulation.load_particles(runner.get_commandpool(), layout.particles);
+
+    if (warmup_steps > 0) {
+      runner.run(warmup_steps);
+    }
+
+    Profiler* profiler = runner.get_profiler();
+    if (profiler) {
+      profiler->clear_stats();
+    }
+
+    HeadlessRunner::Result measured = runner.run(steps);
+
+    result.steps = measured.steps;
+    result.seconds = measured.seconds;
+    if (measured.seconds > 0.0) {
+      result.steps_per_second = measured.steps / measured.seconds;
+      result.particle_updates_per_second = result.steps_per_second * particles;
+    }
+    for (const auto& category : MemoryStats::categories) {
+      result.peak_device_memory += category.peak;
+    }
+    result.peak_block_memory = MemoryStats::peak;
+
+    if (profiler) {
+      for (PassTiming timing : profiler->summary()) {
+        timing.mean /= batch;
+        timing.p50 /= batch;
+        timing.p95 /= batch;
+        timing.p99 /= batch;
+        result.passes.push_back(timing);
+      }
+    }
+  } catch (const std::runtime_error& error) {
+    result.error = error.what();
+  }
+
+  return result;
+}
+
+void Benchmark::write_json(std::ostream& out, const std::string& device, const std::vector<BenchmarkResult>& results) {
+  out << std::setprecision(9);
+  out << "{\n";
+  out << "  \"device\": " << Json::quote(device) << ",\n";
+  out << "  \"warmup_steps\": " << warmup_steps << ",\n";
+  out << "  \"steps_per_submit\": " << HeadlessRunner::steps_per_submit << ",\n";
+  out << "  \"seed\": " << seed << ",\n";
+  out << "  \"results\": [";
+
+  for (size_t i = 0; i < results.size(); i++) {
+    const BenchmarkResult& result = results[i];
+    out << (i == 0 ? "\n" : ",\n");
+    out << "    {\n";
+    out << "      \"scene\": " << Json::quote(result.scene) << ",\n";
+    out << "      \"particles\": " << result.particles << ",\n";
+
+    if (!result.error.empty()) {
+      out << "      \"error\": " << Json::quote(result.error) << "\n";
+      out << "    }";
+      continue;
+    }
+
+    out << "      \"steps\": " << result.steps << ",\n";
+    out << "      \"seconds\": " << result.seconds << ",\n";
+    out << "      \"steps_per_second\": " << result.steps_per_second << ",\n";
+    out << "      \"particle_updates_per_second\": " << result.particle_updates_per_second << ",\n";
+    out << "      \"peak_device_memory_bytes\": " << result.peak_device_memory << ",\n";
+    out << "      \"peak_block_memory_bytes\": " << result.peak_block_memory << ",\n";
+    out << "      \"passes\": [";
+
+    for (size_t j = 0; j < result.passes.size(); j++) {
+      const PassTiming& pass = result.passes[j];
+      out << (j == 0 ? "\n" : ",\n");
+      out << "        {\"name\": " << Json::quote(pass.name)
+          << ", \"depth\": " << pass.depth
+          << ", \"mean_ms\": " << pass.mean
+          << ", \"p50_ms\": " << pass.p50
+          << ", \"p95_ms\": " << pass.p95
+          << ", \"p99_ms\": " << pass.p99 << "}";
+    }
+
+    out << (result.passes.empty() ? "]\n" : "\n      ]\n");
+    out << "    }";
+  }
+
+  out << (results.empty() ? "]\n" : "\n  ]\n");
+  out << "}\n";
+}
+
+uint32_t Benchmark::compare(std::ostream& out, const std::vector<BenchmarkResult>& results, const std::string& baseline_path, double threshold) {
+  Json baseline = Json::load(baseline_path);
+
+  uint32_t regressions = 0;
+  for (const auto& result : results) {
+    if (!result.error.empty()) continue;
+
+    const Json* match = nullptr;
+    for (const auto& entry : baseline["results"].array) {
+      if (entry["scene"].string == result.scene && entry["particles"].number == result.particles) {
+        match = &entry;
+        break;
+      }
+    }
+
+    // New cases and cases that failed last time have nothing to compare with
+    if (!match || (*match)["steps_per_second"].type != Json::Type::number) continue;
+
+    double before = (*match)["steps_per_second"].number;
+    if (before <= 0.0) continue;
+
+    double change = result.steps_per_second / before - 1.0;
+    bool regressed = change < -threshold;
+    regressions += regressed;
+
+    out << std::left << std::setw(8) << result.scene << std::right << std::setw(10) << result.particles
+        << std::fixed << std::setprecision(1)
+        << std::setw(12) << before << " ->" << std::setw(10) << result.steps_per_second << " steps/s"
+        << std::showpos << std::setw(9) << change * 100.0 << "%" << std::noshowpos
+        << (regressed ? "  REGRESSION" : "") << '\n';
+  }
+
+  return regressions;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "profiler/Profiler.hpp"
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct BenchmarkResult {
+  std::string scene;
+  uint32_t particles = 0;
+  uint32_t steps = 0;
+  double seconds = 0.0;
+  double steps_per_second = 0.0;
+  double particle_updates_per_second = 0.0;
+  // Sum of the per category peaks, the bytes the simulation asked for
+  uint64_t peak_device_memory = 0;
+  // Peak of the vkAllocateMemory blocks holding them, slack included
+  uint64_t peak_block_memory = 0;
+  // Mean and percentiles per simulation step, not per submit
+  std::vector<PassTiming> passes;
+  // Set instead of the timings when the case could not run, e.g. out of memory
+  std::string error;
+};
+
+// Runs one scene at one particle count on a fresh headless device, so peak
+// memory and pipeline state never carry over between cases
+struct Benchmark {
+  inline static uint32_t warmup_steps = 128;
+  inline static uint32_t measured_steps = 512;
+  inline static uint32_t seed = 1;
+
+  static BenchmarkResult run(const std::string& scene, uint32_t particles, std::string& device);
+
+  static void write_json(std::ostream& out, const std::string& device, const std::vector<BenchmarkResult>& results);
+
+  // Prints every case slower than the baseline by more than the threshold,
+  // a fraction of its steps per second, and returns how many there were
+  static uint32_t compare(std::ostream& out, const std::vector<BenchmarkResult>& results, const std::string& baseline_path, double threshold);
+};
@@ -0,0 +1,198 @@
+#include "Json.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+struct JsonParser {
+  const std::string& text;
+  size_t position = 0;
+
+  void skip_space() {
+    while (position < text.size() && (text[position] == ' ' || text[position] == '\n' || text[position] == '\r' || text[position] == '\t')) {
+      position++;
+    }
+  }
+
+  void fail(const std::string& message) const {
+    throw std::runtime_error("JSON " + message + " at offset " + std::to_string(position));
+  }
+
+  void expect(char c) {
+    skip_space();
+    if (position >= text.size() || text[position] != c) {
+      fail(std::string("expected '") + c + "'");
+    }
+    position++;
+  }
+
+  bool consume(const char* word) {
+    size_t length = std::char_traits<char>::length(word);
+    if (text.compare(position, length, word) == 0) {
+      position += length;
+      return true;
+    }
+    return false;
+  }
+
+  std::string parse_string() {
+    expect('"');
+    std::string result;
+    while (position < text.size() && text[position] != '"') {
+      char c = text[position++];
+      if (c != '\\') {
+        result += c;
+        continue;
+      }
+      if (position >= text.size()) fail("unterminated escape");
+
+      char escaped = text[position++];
+      switch (escaped) {
+        case 'n': result += '\n'; break;
+        case 't': result += '\t'; break;
+        case 'r': result += '\r'; break;
+        case 'b': result += '\b'; break;
+        case 'f': result += '\f'; break;
+        // Only ASCII is ever written, anything wider reads as '?'
+        case 'u':
+          position += 4;
+          result += '?';
+          break;
+        default: result += escaped; break;
+      }
+    }
+    expect('"');
+    return result;
+  }
+
+  Json parse_value() {
+    skip_space();
+    if (position >= text.size()) fail("unexpected end");
+
+    Json value;
+    char c = text[position];
+    if (c == '{') {
+      value.type = Json::Type::object;
+      position++;
+      skip_space();
+      if (position < text.size() && text[position] == '}') {
+        position++;
+        return value;
+      }
+      while (true) {
+        skip_space();
+        std::string key = parse_string();
+        expect(':');
+        value.object.emplace_back(key, parse_value());
+        skip_space();
+        if (position < text.size() && text[position] == ',') {
+          position++;
+          continue;
+        }
+        expect('}');
+        return value;
+      }
+    }
+
+    if (c == '[') {
+      value.type = Json::Type::array;
+      position++;
+      skip_space();
+      if (position < text.size() && text[position] == ']') {
+        position++;
+        return value;
+      }
+      while (true) {
+        value.array.push_back(parse_value());
+        skip_space();
+        if (position < text.size() && text[position] == ',') {
+          position++;
+          continue;
+        }
+        expect(']');
+        return value;
+      }
+    }
+
+    if (c == '"') {
+      value.type = Json::Type::string;
+      value.string = parse_string();
+      return value;
+    }
+
+    if (consume("true")) {
+      value.type = Json::Type::boolean;
+      value.boolean = true;
+      return value;
+    }
+    if (consume("false")) {
+      value.type = Json::Type::boolean;
+      return value;
+    }
+    if (consume("null")) {
+      return value;
+    }
+
+    const char* begin = text.c_str() + position;
+    char* end = nullptr;
+    value.number = std::strtod(begin, &end);
+    if (end == begin) fail("unexpected character");
+    value.type = Json::Type::number;
+    position += end - begin;
+    return value;
+  }
+};
+
+const Json& Json::operator[](const std::string& key) const {
+  static const Json null;
+  if (type != Type::object) return null;
+
+  for (const auto& entry : object) {
+    if (entry.first == key) return entry.second;
+  }
+  return null;
+}
+
+Json Json::parse(const std::string& text) {
+  JsonParser parser{text};
+  Json value = parser.parse_value();
+  parser.skip_space();
+  if (parser.position != text.size()) {
+    parser.fail("trailing characters");
+  }
+  return value;
+}
+
+Json Json::load(const std::string& path) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    throw std::runtime_error("Unable to open " + path);
+  }
+
+  std::stringstream contents;
+  contents << file.rdbuf();
+  return parse(contents.str());
+}
+
+std::string Json::quote(const std::string& text) {
+  std::string result = "\"";
+  for (char c : text) {
+    switch (c) {
+      case '"': result += "\\\""; break;
+      case '\\': result += "\\\\"; break;
+      case '\n': result += "\\n"; break;
+      case '\t': result += "\\t"; break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char escaped[8];
+          std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+          result += escaped;
+        } else {
+          result += c;
+        }
+    }
+  }
+  return result + "\"";
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// Just enough JSON to read back a results file written by the benchmark
+struct Json {
+  enum class Type { null, boolean, number, string, array, object };
+
+  Type type = Type::null;
+  bool boolean = false;
+  double number = 0.0;
+  std::string string;
+  std::vector<Json> array;
+  // Kept in file order, a map of an incomplete type is not portable
+  std::vector<std::pair<std::string, Json>> object;
+
+  // Missing keys and wrong types read as null, so lookups chain
+  const Json& operator[](const std::string& key) const;
+
+  static Json parse(const std::string& text);
+  static Json load(const std::string& path);
+
+  // Quotes and escapes a string for writing
+  static std::string quote(const std::string& text);
+};
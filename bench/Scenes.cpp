@@ -0,0 +1,162 @@
+#include "Scenes.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+static float spacing() {
+  return std::cbrt(1.0f / Scenes::PARTICLES_PER_UNIT);
+}
+
+static float fluid_volume(uint32_t particles) {
+  return particles / Scenes::PARTICLES_PER_UNIT;
+}
+
+static FluidData at_rest(float x, float y, float z) {
+  FluidData data{};
+  data.position = {x, y, z, 0};
+  return data;
+}
+
+// Fills whole lattice layers over the footprint from the floor up, jittered
+// by a tenth of the spacing so no two particles share a hash key by accident
+static void fill_layers(std::vector<FluidData>& values, uint32_t count, float x0, float x1, float z0, float z1, float y0, std::mt19937& gen) {
+  float step = spacing();
+  std::uniform_real_distribution<float> jitter(-0.1f * step, 0.1f * step);
+
+  uint32_t nx = std::max(static_cast<uint32_t>((x1 - x0) / step), 1u);
+  uint32_t nz = std::max(static_cast<uint32_t>((z1 - z0) / step), 1u);
+
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t layer = i / (nx * nz);
+    uint32_t cell = i % (nx * nz);
+    float x = x0 + (cell % nx + 0.5f) * step;
+    float z = z0 + (cell / nx + 0.5f) * step;
+    float y = y0 + (layer + 0.5f) * step;
+    values.push_back(at_rest(x + jitter(gen), y + jitter(gen), z + jitter(gen)));
+  }
+}
+
+static void fill_sphere(std::vector<FluidData>& values, uint32_t count, glm::vec3 centre, glm::vec3 velocity, std::mt19937& gen) {
+  float step = spacing();
+  std::uniform_real_distribution<float> jitter(-0.1f * step, 0.1f * step);
+
+  // Lattice points inside the sphere fall a little short of its volume, so the
+  // radius grows until enough of them fit
+  float radius = std::cbrt(3.0f * count / (4.0f * 3.14159265f * Scenes::PARTICLES_PER_UNIT));
+  std::vector<glm::vec3> points;
+  while (points.size() < count) {
+    points.clear();
+    int32_t n = static_cast<int32_t>(std::ceil(radius / step));
+    for (int32_t i = -n; i <= n; i++) {
+      for (int32_t j = -n; j <= n; j++) {
+        for (int32_t k = -n; k <= n; k++) {
+          glm::vec3 offset = glm::vec3(i, j, k) * step;
+          if (glm::dot(offset, offset) <= radius * radius) {
+            points.push_back(centre + offset);
+          }
+        }
+      }
+    }
+    radius *= 1.05f;
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    FluidData data = at_rest(points[i].x + jitter(gen), points[i].y + jitter(gen), points[i].z + jitter(gen));
+    data.velocity = glm::vec4(velocity, 0);
+    values.push_back(data);
+  }
+}
+
+// Water column against the left wall, 40% of the width, falling into an
+// empty box. The box is sized so the column stands half the box tall.
+static BenchScene dam(uint32_t particles, uint32_t seed) {
+  BenchScene scene;
+  scene.half_extent = std::max(2.5f, std::cbrt(fluid_volume(particles) / 1.6f));
+  scene.particles.reserve(particles);
+
+  float extent = scene.half_extent;
+  std::mt19937 gen(seed);
+  fill_layers(scene.particles, particles, -extent, -0.2f * extent, -extent, extent, -extent, gen);
+  return scene;
+}
+
+// Flat pool a quarter of the box deep, mostly measures the steady state cost
+// once the warm-up has let it settle
+static BenchScene tank(uint32_t particles, uint32_t seed) {
+  BenchScene scene;
+  scene.half_extent = std::max(2.5f, std::cbrt(fluid_volume(particles) / 2.0f));
+  scene.particles.reserve(particles);
+
+  float extent = scene.half_extent;
+  std::mt19937 gen(seed);
+  fill_layers(scene.particles, particles, -extent, extent, -extent, extent, -extent, gen);
+  return scene;
+}
+
+// The tank with a fifth of the particles pulled out into a ball already
+// falling towards it
+static BenchScene splash(uint32_t particles, uint32_t seed) {
+  BenchScene scene;
+  scene.half_extent = std::max(2.5f, std::cbrt(fluid_volume(particles) / 2.0f));
+  scene.particles.reserve(particles);
+
+  float extent = scene.half_extent;
+  uint32_t drop = particles / 5;
+  std::mt19937 gen(seed);
+  fill_layers(scene.particles, particles - drop, -extent, extent, -extent, extent, -extent, gen);
+  fill_sphere(scene.particles, drop, {0.0f, 0.4f * extent, 0.0f}, {0.0f, -3.0f, 0.0f}, gen);
+  return scene;
+}
+
+// The dam break running into a block in the middle of the floor, so every
+// particle near it walks the baked distance field
+static BenchScene obstacle(uint32_t particles, uint32_t seed) {
+  BenchScene scene = dam(particles, seed);
+
+  float extent = scene.half_extent;
+  glm::vec3 half_size(0.15f * extent, 0.25f * extent, 0.5f * extent);
+  glm::vec3 centre(0.3f * extent, -extent + half_size.y, 0.0f);
+
+  BoundaryMesh block{};
+  block.shape = "box";
+  block.transform = glm::scale(glm::translate(glm::mat4(1.0f), centre), half_size);
+  scene.boundary_meshes.push_back(block);
+  return scene;
+}
+
+// The tank with a 4x4 grid of spheres and boxes dropped into it, half of
+// them lighter than the fluid, so the broad phase, the contacts and the
+// fluid forces on the bodies are all in the timing
+static BenchScene bodies(uint32_t particles, uint32_t seed) {
+  BenchScene scene = tank(particles, seed);
+
+  float extent = scene.half_extent;
+  float size = 0.08f * extent;
+  for (uint32_t i = 0; i < 16; i++) {
+    RigidBodyDesc body{};
+    body.shape = i % 2 == 0 ? RigidShape::Sphere : RigidShape::Box;
+    body.position = glm::vec3((i % 4 - 1.5f) * 0.4f * extent, 0.3f * extent, (i / 4 - 1.5f) * 0.4f * extent);
+    body.half_extent = glm::vec3(size);
+    body.density = (i / 2) % 2 == 0 ? 100.0f : 400.0f;
+    scene.bodies.push_back(body);
+  }
+  return scene;
+}
+
+const std::vector<std::string>& Scenes::names() {
+  static const std::vector<std::string> all = {"dam", "tank", "splash", "obstacle", "bodies"};
+  return all;
+}
+
+BenchScene Scenes::build(const std::string& name, uint32_t particles, uint32_t seed) {
+  if (name == "dam") return dam(particles, seed);
+  if (name == "tank") return tank(particles, seed);
+  if (name == "splash") return splash(particles, seed);
+  if (name == "obstacle") return obstacle(particles, seed);
+  if (name == "bodies") return bodies(particles, seed);
+  throw std::runtime_error("Unknown benchmark scene '" + name + "'");
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "system/SimulationBackend.hpp"
+#include "scene/Scene.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A fixed particle layout and the box it sits in, the same name, count and
+// seed always give the same particles
+struct BenchScene {
+  std::vector<FluidData> particles;
+  // Half extent of the cubic boundary, the floor is at -half_extent
+  float half_extent;
+  // Baked into the distance field before the first step
+  std::vector<BoundaryMesh> boundary_meshes;
+  std::vector<RigidBodyDesc> bodies;
+};
+
+struct Scenes {
+  // dam, tank, splash, obstacle and bodies
+  static const std::vector<std::string>& names();
+
+  static BenchScene build(const std::string& name, uint32_t particles, uint32_t seed);
+
+  // Matches the default startup layout, 30000 particles in 125 cubic units
+  static constexpr float PARTICLES_PER_UNIT = 240.0f;
+};
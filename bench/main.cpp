@@ -0,0 +1,145 @@
+#include "Benchmark.hpp"
+#include "Scenes.hpp"
+#include "HeadlessRunner.hpp"
+#include "profiler/Profiler.hpp"
+#include "profiler/Telemetry.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+static std::string usage() {
+  return
+    "Usage: fluidsim_bench [options]\n"
+    "  --scene <name>        dam, tank, splash, obstacle, bodies or all, all by default\n"
+    "  --particles <n,n,..>  Particle counts to sweep, 10000,100000,500000,1000000,2000000 by default\n"
+    "  --warmup <n>          Steps run before measuring, 128 by default\n"
+    "  --steps <n>           Measured steps, rounded up to whole submits, 512 by default\n"
+    "  --batch <n>           Steps recorded per submit, 16 by default\n"
+    "  --seed <n>            Seed of the layout jitter, 1 by default\n"
+    "  --out <file>          Results JSON, bench.json by default, - for stdout\n"
+    "  --baseline <file>     Results JSON to compare steps/s against\n"
+    "  --threshold <x>       Slowdown that fails the comparison, 0.05 by default\n";
+}
+
+static uint32_t parse_uint(const std::string& flag, const std::string& value) {
+  size_t end = 0;
+  unsigned long result = 0;
+  try {
+    result = std::stoul(value, &end);
+  } catch (const std::exception&) {
+    end = 0;
+  }
+
+  if (end != value.size() || result > UINT32_MAX) {
+    throw std::runtime_error(flag + " expects an unsigned integer, got '" + value + "'");
+  }
+  return static_cast<uint32_t>(result);
+}
+
+int main(int argc, char** argv) {
+  std::vector<std::string> scenes = Scenes::names();
+  std::vector<uint32_t> counts = {10000, 100000, 500000, 1000000, 2000000};
+  std::string out_path = "bench.json";
+  std::string baseline_path;
+  double threshold = 0.05;
+
+  try {
+    for (int i = 1; i < argc; i++) {
+      std::string flag = argv[i];
+
+      auto value = [&]() -> std::string {
+        if (i + 1 >= argc) {
+          throw std::runtime_error(flag + " needs a value");
+        }
+        return argv[++i];
+      };
+
+      if (flag == "--scene") {
+        std::string name = value();
+        if (name != "all") {
+          if (std::find(scenes.begin(), scenes.end(), name) == scenes.end()) {
+            throw std::runtime_error("Unknown scene '" + name + "'\n" + usage());
+          }
+          scenes = {name};
+        }
+      } else if (flag == "--particles") {
+        counts.clear();
+        std::stringstream list(value());
+        std::string item;
+        while (std::getline(list, item, ',')) {
+          counts.push_back(parse_uint(flag, item));
+        }
+      } else if (flag == "--warmup") {
+        Benchmark::warmup_steps = parse_uint(flag, value());
+      } else if (flag == "--steps") {
+        Benchmark::measured_steps = parse_uint(flag, value());
+      } else if (flag == "--batch") {
+        HeadlessRunner::steps_per_submit = std::max(parse_uint(flag, value()), 1u);
+      } else if (flag == "--seed") {
+        Benchmark::seed = parse_uint(flag, value());
+      } else if (flag == "--out") {
+        out_path = value();
+      } else if (flag == "--baseline") {
+        baseline_path = value();
+      } else if (flag == "--threshold") {
+        threshold = std::stod(value());
+      } else {
+        throw std::runtime_error("Unknown option '" + flag + "'\n" + usage());
+      }
+    }
+  } catch (const std::exception& error) {
+    std::cerr << error.what() << '\n';
+    return 1;
+  }
+
+  // Every pass is timed, nothing is printed or written per run
+  Profiler::enabled = true;
+  Profiler::report_interval = 0;
+  Telemetry::csv_path = "";
+  Trace::path = "";
+  HeadlessRunner::verbose = false;
+
+  std::string device;
+  std::vector<BenchmarkResult> results;
+  for (const auto& scene : scenes) {
+    for (uint32_t count : counts) {
+      BenchmarkResult result = Benchmark::run(scene, count, device);
+      if (result.error.empty()) {
+        std::cerr << scene << " " << count << ": " << result.steps_per_second << " steps/s, "
+                  << result.particle_updates_per_second << " particle updates/s" << '\n';
+      } else {
+        std::cerr << scene << " " << count << ": " << result.error << '\n';
+      }
+      results.push_back(result);
+    }
+  }
+
+  if (out_path == "-") {
+    Benchmark::write_json(std::cout, device, results);
+  } else {
+    std::ofstream file(out_path);
+    if (!file.is_open()) {
+      std::cerr << "Unable to write " << out_path << '\n';
+      return 1;
+    }
+    Benchmark::write_json(file, device, results);
+  }
+
+  if (!baseline_path.empty()) {
+    try {
+      uint32_t regressions = Benchmark::compare(std::cerr, results, baseline_path, threshold);
+      if (regressions > 0) {
+        std::cerr << regressions << " case(s) slower than " << baseline_path << " by more than " << threshold * 100.0 << "%" << '\n';
+        return 1;
+      }
+    } catch (const std::runtime_error& error) {
+      std::cerr << error.what() << '\n';
+      return 1;
+    }
+  }
+
+  return 0;
+}
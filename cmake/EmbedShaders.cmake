@@ -0,0 +1,25 @@
+# Writes OUTPUT, a C++ source holding every file of SPIRV_FILES as a word
+# array, keyed by its path relative to SHADER_DIR under shaders/.
+# Run with cmake -DSHADER_DIR=... -DSPIRV_FILES=... -DOUTPUT=... -P
+
+set(ARRAYS "")
+set(ENTRIES "")
+set(INDEX 0)
+
+foreach(SPIRV ${SPIRV_FILES})
+    file(RELATIVE_PATH REL_PATH ${SHADER_DIR} ${SPIRV})
+    file(READ ${SPIRV} HEX HEX)
+    string(LENGTH "${HEX}" HEX_LENGTH)
+    math(EXPR BYTES "${HEX_LENGTH} / 2")
+
+    # SPIR-V is a stream of little endian words
+    string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1," WORDS "${HEX}")
+
+    string(APPEND ARRAYS "static const uint32_t shader_${INDEX}[] = {${WORDS}};\n")
+    string(APPEND ENTRIES "  {\"shaders/${REL_PATH}\", shader_${INDEX}, ${BYTES}},\n")
+    math(EXPR INDEX "${INDEX} + 1")
+endforeach()
+
+set(SOURCE "// Generated by cmake/EmbedShaders.cmake, do not edit\n\n#include \"pipeline/EmbeddedShaders.hpp\"\n\n${ARRAYS}\nconst EmbeddedShader EMBEDDED_SHADERS[] = {\n${ENTRIES}  {nullptr, nullptr, 0}\n};\n")
+
+file(WRITE ${OUTPUT} "${SOURCE}")
@@ -0,0 +1,405 @@
+#include "Golden.hpp"
+#include "HeadlessRunner.hpp"
+#include "system/Solver.hpp"
+#include "system/CpuFluidSystem.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <random>
+#include <stdexcept>
+
+static constexpr uint32_t EMPTY = std::numeric_limits<uint32_t>::max();
+static constexpr uint32_t MAX_REPORTED = 10;
+static constexpr uint32_t VERSION = 3;
+
+// mt19937 output is fixed by the standard, the distributions are not
+static float uniform(std::mt19937& gen, float low, float high) {
+  return low + (high - low) * static_cast<float>(gen() / 4294967296.0);
+}
+
+static FluidData at(float x, float y, float z) {
+  FluidData data{};
+  data.position = {x, y, z, 0};
+  return data;
+}
+
+// Pairs inside and just outside the smoothing radius, some straddling cell
+// edges, so the key, table and neighbour walk all get corner cases
+static GoldenCase cluster() {
+  GoldenCase golden_case{"cluster", {}, 2.0f};
+  golden_case.particles = {
+    at(0.1f, 0.1f, 0.0f), at(0.7f, 0.2f, 0.0f), at(0.8f, 0.6f, 0.0f),
+    at(-0.3f, 0.1f, 0.0f), at(-0.2f, -0.1f, 0.0f), at(0.8f, -0.2f, 0.0f),
+    at(-0.2f, 0.8f, 0.0f), at(0.3f, 0.8f, 0.0f), at(0.2f, -0.2f, 0.0f),
+    at(1.2f, 0.2f, 0.0f), at(1.24f, 0.42f, 0.0f), at(1.33f, 0.12f, 0.0f),
+    at(1.33f, 0.01f, 0.0f), at(1.18f, 0.01f, 0.0f)
+  };
+  return golden_case;
+}
+
+// 8x8x8 block on the floor at half the smoothing radius, every particle has
+// a full neighbourhood except at the faces
+static GoldenCase lattice() {
+  GoldenCase golden_case{"lattice", {}, 2.0f};
+  for (uint32_t i = 0; i < 512; i++) {
+    float x = -0.35f + 0.1f * (i % 8);
+    float y = -1.95f + 0.1f * (i / 64);
+    float z = -0.35f + 0.1f * ((i / 8) % 8);
+    golden_case.particles.push_back(at(x, y, z));
+  }
+  return golden_case;
+}
+
+// Scattered particles already moving, walls and collisions in one step
+static GoldenCase scattered() {
+  GoldenCase golden_case{"scattered", {}, 2.0f};
+  std::mt19937 gen(7);
+  for (uint32_t i = 0; i < 1000; i++) {
+    FluidData data = at(uniform(gen, -1.9f, 1.9f), uniform(gen, -1.9f, 1.9f), uniform(gen, -1.9f, 1.9f));
+    data.velocity = {uniform(gen, -1.0f, 1.0f), uniform(gen, -1.0f, 1.0f), uniform(gen, -1.0f, 1.0f), 0};
+    golden_case.particles.push_back(data);
+  }
+  return golden_case;
+}
+
+// A small pool with an emitter pouring into it and a sink over one corner of
+// the floor, so emission, removal and the dead particles leaving through the
+// sort are all captured
+static GoldenCase flow() {
+  GoldenCase golden_case{"flow", {}, 1.0f};
+  for (uint32_t i = 0; i < 216; i++) {
+    float x = -0.5f + 0.1f * (i % 6);
+    float y = -0.95f + 0.1f * (i / 36);
+    float z = -0.5f + 0.1f * ((i / 6) % 6);
+    golden_case.particles.push_back(at(x, y, z));
+  }
+
+  ParticleEmitter emitter{};
+  emitter.position = glm::vec3(0.0f, 0.5f, 0.0f);
+  emitter.radius = 0.15f;
+  emitter.velocity = glm::vec3(0.0f, -1.0f, 0.0f);
+  emitter.rate = 16;
+  golden_case.emitters.push_back(emitter);
+
+  golden_case.sinks.push_back({glm::vec3(-0.6f, -1.0f, -0.6f), glm::vec3(-0.35f, -0.7f, -0.35f)});
+  golden_case.spare = emitter.rate * Golden::steps;
+  return golden_case;
+}
+
+// The lattice under a weak upward pull, so a solver ignoring the configured
+// gravity drifts the wrong way from the first step
+static GoldenCase rising() {
+  GoldenCase golden_case = lattice();
+  golden_case.name = "rising";
+  golden_case.gravity = 4.0f;
+  return golden_case;
+}
+
+const std::vector<std::string>& Golden::names() {
+  static const std::vector<std::string> all = {"cluster", "lattice", "scattered", "flow", "rising"};
+  return all;
+}
+
+GoldenCase Golden::build(const std::string& name) {
+  if (name == "cluster") return cluster();
+  if (name == "lattice") return lattice();
+  if (name == "scattered") return scattered();
+  if (name == "flow") return flow();
+  if (name == "rising") return rising();
+  throw std::runtime_error("Unknown golden case '" + name + "'");
+}
+
+GoldenRun Golden::capture(const GoldenCase& golden_case) {
+  uint32_t count = static_cast<uint32_t>(golden_case.particles.size());
+  Scene::instances = count;
+  Scene::max_instances = count + golden_case.spare;
+  Scene::seed = 0;
+  Scene::cpu_simulation = false;
+  Scene::emitters = golden_case.emitters;
+  Scene::sinks = golden_case.sinks;
+  Solver::constants.gravity = golden_case.gravity;
+
+  HeadlessRunner runner;
+  FluidSystem& system = *runner.get_scene().fluid_system;
+  system.set_boundary(golden_case.half_extent, golden_case.half_extent, golden_case.half_extent);
+  system.load_particles(runner.get_commandpool(), golden_case.particles);
+
+  GoldenRun run;
+  run.device = runner.device_name();
+  run.table_cells = Solver::constants.table_cells;
+  for (uint32_t step = 0; step < steps; step++) {
+    run.steps.push_back(system.capture_step(runner.get_commandpool()));
+  }
+  return run;
+}
+
+GoldenRun Golden::capture_cpu(const GoldenCase& golden_case) {
+  if (!golden_case.emitters.empty() || !golden_case.sinks.empty()) {
+    throw std::runtime_error("the CPU backend has no emitters or sinks");
+  }
+
+  uint32_t count = static_cast<uint32_t>(golden_case.particles.size());
+  Scene::instances = count;
+  Scene::max_instances = count;
+  Scene::seed = 0;
+  Scene::cpu_simulation = false;
+  Scene::emitters = {};
+  Scene::sinks = {};
+  Solver::constants.gravity = golden_case.gravity;
+
+  // Only for the command pool the backend interface takes
+  HeadlessRunner runner;
+  CpuFluidSystem system(count);
+  system.set_boundary(golden_case.half_extent, golden_case.half_extent, golden_case.half_extent);
+  system.load_particles(runner.get_commandpool(), golden_case.particles);
+
+  GoldenRun run;
+  run.device = "cpu";
+  run.table_cells = Solver::constants.table_cells;
+  for (uint32_t step = 0; step < steps; step++) {
+    system.step();
+
+    // Cell order after the step like the GPU buffers, density rides in predicted_position.w
+    std::vector<FluidData> particles = system.read_particles(runner.get_commandpool());
+    StageCapture density{"density", {}, {}, std::vector<float>(particles.size())};
+    for (size_t i = 0; i < particles.size(); i++) {
+      density.density[i] = particles[i].predicted_position.w;
+    }
+    run.steps.push_back({density, {"move", particles, {}, {}}});
+  }
+  return run;
+}
+
+void Golden::keep_stages(GoldenRun& run, const std::vector<std::string>& stages) {
+  for (auto& captures : run.steps) {
+    captures.erase(std::remove_if(captures.begin(), captures.end(), [&](const StageCapture& capture) {
+      return std::find(stages.begin(), stages.end(), capture.stage) == stages.end();
+    }), captures.end());
+  }
+}
+
+// One header line per stage, "step <n> <stage> <kind> <count>", then count
+// lines of values. The table only lists filled cells as "cell start".
+void Golden::write(const std::string& path, const GoldenCase& golden_case, const GoldenRun& run) {
+  std::ofstream file(path);
+  if (!file.is_open()) {
+    throw std::runtime_error("Unable to write " + path);
+  }
+
+  file << std::setprecision(9);
+  file << "fluidsim-golden " << VERSION << '\n';
+  file << "case " << golden_case.name << '\n';
+  file << "device " << run.device << '\n';
+  file << "table_cells " << run.table_cells << '\n';
+  file << "steps " << run.steps.size() << '\n';
+
+  for (size_t step = 0; step < run.steps.size(); step++) {
+    for (const auto& capture : run.steps[step]) {
+      if (!capture.particles.empty()) {
+        file << "step " << step << " " << capture.stage << " particles " << capture.particles.size() << '\n';
+        for (const auto& data : capture.particles) {
+          // The key is raw bits in position.w, written as the integer
+          const float* values = &data.position.x;
+          for (int i = 0; i < 12; i++) {
+            file << (i == 0 ? "" : " ");
+            if (i == 3) file << data.key();
+            else file << values[i];
+          }
+          file << '\n';
+        }
+      }
+
+      if (!capture.table.empty()) {
+        uint32_t filled = 0;
+        for (uint32_t start : capture.table) filled += start != EMPTY;
+
+        file << "step " << step << " " << capture.stage << " table " << filled << '\n';
+        for (size_t cell = 0; cell < capture.table.size(); cell++) {
+          if (capture.table[cell] != EMPTY) {
+            file << cell << " " << capture.table[cell] << '\n';
+          }
+        }
+      }
+
+      if (!capture.density.empty()) {
+        file << "step " << step << " " << capture.stage << " density " << capture.density.size() << '\n';
+        for (float value : capture.density) {
+          file << value << '\n';
+        }
+      }
+    }
+  }
+}
+
+GoldenRun Golden::read(const std::string& path) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    throw std::runtime_error("Unable to open " + path + ", record it with --record");
+  }
+
+  std::string word;
+  uint32_t version = 0;
+  if (!(file >> word >> version) || word != "fluidsim-golden" || version != VERSION) {
+    throw std::runtime_error(path + " is not a version " + std::to_string(VERSION) + " golden file, record it again with --record");
+  }
+
+  GoldenRun run;
+  std::string name;
+  size_t step_count = 0;
+  file >> word >> name >> word;
+  std::getline(file >> std::ws, run.device);
+  file >> word >> run.table_cells;
+  file >> word >> step_count;
+  run.steps.resize(step_count);
+
+  size_t step;
+  std::string stage;
+  std::string kind;
+  size_t count;
+  while (file >> word >> step >> stage >> kind >> count) {
+    if (word != "step" || step >= step_count) {
+      throw std::runtime_error(path + " has a malformed stage header");
+    }
+
+    auto& captures = run.steps[step];
+    if (captures.empty() || captures.back().stage != stage) {
+      captures.push_back({stage, {}, {}, {}});
+    }
+    StageCapture& capture = captures.back();
+
+    if (kind == "particles") {
+      capture.particles.resize(count);
+      for (auto& data : capture.particles) {
+        float* values = &data.position.x;
+        uint32_t key = 0;
+        for (int i = 0; i < 12; i++) {
+          if (i == 3) file >> key;
+          else file >> values[i];
+        }
+        data.set_key(key);
+      }
+    } else if (kind == "table") {
+      capture.table.assign(run.table_cells, EMPTY);
+      for (size_t i = 0; i < count; i++) {
+        size_t cell;
+        uint32_t start;
+        file >> cell >> start;
+        if (cell >= capture.table.size()) {
+          throw std::runtime_error(path + " has a table cell out of range");
+        }
+        capture.table[cell] = start;
+      }
+    } else if (kind == "density") {
+      capture.density.resize(count);
+      for (auto& value : capture.density) file >> value;
+    } else {
+      throw std::runtime_error(path + " has an unknown stage kind '" + kind + "'");
+    }
+
+    if (!file) {
+      throw std::runtime_error(path + " ends inside step " + std::to_string(step) + " " + stage);
+    }
+  }
+
+  return run;
+}
+
+static bool within(double actual, double expected, Tolerance tolerance) {
+  return std::abs(actual - expected) <= tolerance.absolute + tolerance.relative * std::abs(expected);
+}
+
+uint32_t Golden::compare(std::ostream& out, const GoldenRun& expected, const GoldenRun& actual) {
+  // Key in position.w and the dead flag in velocity.w have to match exactly
+  static const char* FIELDS[12] = {
+    "position.x", "position.y", "position.z", "key",
+    "velocity.x", "velocity.y", "velocity.z", "rest",
+    "predicted.x", "predicted.y", "predicted.z", "density"
+  };
+  static const Tolerance TOLERANCES[12] = {
+    POSITION, POSITION, POSITION, EXACT,
+    VELOCITY, VELOCITY, VELOCITY, EXACT,
+    POSITION, POSITION, POSITION, DENSITY
+  };
+
+  if (expected.device != actual.device) {
+    out << "  recorded on " << expected.device << ", running on " << actual.device << '\n';
+  }
+
+  // Every key and table cell depends on it, nothing else would compare
+  if (expected.table_cells != actual.table_cells) {
+    out << "  recorded with " << expected.table_cells << " table cells, running with " << actual.table_cells << '\n';
+    return 1;
+  }
+
+  uint32_t failed = 0;
+  size_t step_count = std::min(expected.steps.size(), actual.steps.size());
+  for (size_t step = 0; step < step_count; step++) {
+    for (const auto& want : expected.steps[step]) {
+      auto found = std::find_if(actual.steps[step].begin(), actual.steps[step].end(), [&](const StageCapture& capture) {
+        return capture.stage == want.stage;
+      });
+      if (found == actual.steps[step].end()) {
+        out << "  step " << step << " " << want.stage << ": stage missing" << '\n';
+        failed++;
+        continue;
+      }
+      const StageCapture& got = *found;
+
+      uint32_t mismatches = 0;
+      auto report = [&](const std::string& where, double got_value, double want_value) {
+        if (mismatches++ < MAX_REPORTED) {
+          out << "  step " << step << " " << want.stage << " " << where << ": got " << got_value << ", expected " << want_value << '\n';
+        }
+      };
+
+      if (got.particles.size() != want.particles.size() || got.density.size() != want.density.size() || got.table.size() != want.table.size()) {
+        out << "  step " << step << " " << want.stage << ": sizes differ" << '\n';
+        failed++;
+        continue;
+      }
+
+      for (size_t i = 0; i < want.particles.size(); i++) {
+        const float* got_values = &got.particles[i].position.x;
+        const float* want_values = &want.particles[i].position.x;
+        if (got.particles[i].key() != want.particles[i].key()) {
+          report("particle " + std::to_string(i) + " key", got.particles[i].key(), want.particles[i].key());
+        }
+        for (int field = 0; field < 12; field++) {
+          if (field == 3) continue;
+          if (!within(got_values[field], want_values[field], TOLERANCES[field])) {
+            report("particle " + std::to_string(i) + " " + FIELDS[field], got_values[field], want_values[field]);
+          }
+        }
+      }
+
+      for (size_t cell = 0; cell < want.table.size(); cell++) {
+        if (got.table[cell] != want.table[cell]) {
+          report("table cell " + std::to_string(cell), got.table[cell], want.table[cell]);
+        }
+      }
+
+      for (size_t i = 0; i < want.density.size(); i++) {
+        if (!within(got.density[i], want.density[i], DENSITY)) {
+          report("density " + std::to_string(i), got.density[i], want.density[i]);
+        }
+      }
+
+      if (mismatches > 0) {
+        if (mismatches > MAX_REPORTED) {
+          out << "  step " << step << " " << want.stage << ": " << mismatches - MAX_REPORTED << " more" << '\n';
+        }
+        failed++;
+      }
+    }
+  }
+
+  if (expected.steps.size() != actual.steps.size()) {
+    out << "  " << actual.steps.size() << " steps captured, " << expected.steps.size() << " recorded" << '\n';
+    failed++;
+  }
+
+  return failed;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "system/FluidSystem.hpp"
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// A small fixed particle set, built without std distributions so every
+// standard library places the same particles
+struct GoldenCase {
+  std::string name;
+  std::vector<FluidData> particles;
+  float half_extent;
+  std::vector<ParticleEmitter> emitters = {};
+  std::vector<ParticleSink> sinks = {};
+  // Free slots past the particles for the emitters to fill
+  uint32_t spare = 0;
+  // Solver::constants.gravity while the case runs
+  float gravity = SphConstants{}.gravity;
+};
+
+// Outputs of every stage for each captured step, in capture order
+struct GoldenRun {
+  std::string device;
+  // Solver::constants.table_cells, the files only list the filled cells
+  uint32_t table_cells = 0;
+  std::vector<std::vector<StageCapture>> steps;
+};
+
+// Values match when |actual - expected| <= absolute + relative * |expected|
+struct Tolerance {
+  double absolute;
+  double relative;
+};
+
+struct Golden {
+  // Steps captured per case, the first has no velocity yet, later ones do
+  inline static uint32_t steps = 3;
+
+  static constexpr Tolerance EXACT = {0.0, 0.0};
+  static constexpr Tolerance POSITION = {1e-5, 1e-4};
+  static constexpr Tolerance VELOCITY = {1e-4, 1e-3};
+  static constexpr Tolerance DENSITY = {1e-3, 1e-3};
+
+  static const std::vector<std::string>& names();
+  static GoldenCase build(const std::string& name);
+
+  // Runs the case on a fresh headless device
+  static GoldenRun capture(const GoldenCase& golden_case);
+
+  // Runs the case on CpuFluidSystem instead, which only has the
+  // CPU_STAGES outputs, and no emitters or sinks
+  static GoldenRun capture_cpu(const GoldenCase& golden_case);
+  inline static const std::vector<std::string> CPU_STAGES = {"density", "move"};
+
+  // Drops every other stage, so a run with fewer stages can be compared
+  static void keep_stages(GoldenRun& run, const std::vector<std::string>& stages);
+
+  static void write(const std::string& path, const GoldenCase& golden_case, const GoldenRun& run);
+  static GoldenRun read(const std::string& path);
+
+  // Prints the first few mismatches of every stage and returns how many
+  // stages had any
+  static uint32_t compare(std::ostream& out, const GoldenRun& expected, const GoldenRun& actual);
+};
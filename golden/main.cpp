@@ -0,0 +1,120 @@
+#include "Golden.hpp"
+#include "HeadlessRunner.hpp"
+#include "profiler/Profiler.hpp"
+#include "profiler/Telemetry.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+#ifndef GOLDEN_DATA_DIR
+#define GOLDEN_DATA_DIR "golden/data"
+#endif
+
+static std::string usage() {
+  return
+    "Usage: fluidsim_golden [options]\n"
+    "  --case <name>  cluster, lattice, scattered, flow, rising or all, all by default\n"
+    "  --data <dir>   Golden files, the source tree's golden/data by default\n"
+    "  --record       Write the golden files from this device instead of comparing\n"
+    "  --cpu          Compare the CPU backend's density and move stages against the files\n"
+    "Exits with 1 on a difference or when a case has no file.\n";
+}
+
+int main(int argc, char** argv) {
+  std::vector<std::string> cases = Golden::names();
+  std::string data_dir = GOLDEN_DATA_DIR;
+  bool record = false;
+  bool cpu = false;
+
+  try {
+    for (int i = 1; i < argc; i++) {
+      std::string flag = argv[i];
+
+      auto value = [&]() -> std::string {
+        if (i + 1 >= argc) {
+          throw std::runtime_error(flag + " needs a value");
+        }
+        return argv[++i];
+      };
+
+      if (flag == "--case") {
+        std::string name = value();
+        if (name != "all") {
+          if (std::find(cases.begin(), cases.end(), name) == cases.end()) {
+            throw std::runtime_error("Unknown case '" + name + "'\n" + usage());
+          }
+          cases = {name};
+        }
+      } else if (flag == "--data") {
+        data_dir = value();
+      } else if (flag == "--record") {
+        record = true;
+      } else if (flag == "--cpu") {
+        cpu = true;
+      } else {
+        throw std::runtime_error("Unknown option '" + flag + "'\n" + usage());
+      }
+    }
+  } catch (const std::runtime_error& error) {
+    std::cerr << error.what() << '\n';
+    return 1;
+  }
+
+  // Stages are submitted one at a time, so timings would mean nothing here
+  Profiler::enabled = false;
+  Telemetry::csv_path = "";
+  Trace::path = "";
+  HeadlessRunner::verbose = false;
+
+  if (record && cpu) {
+    std::cerr << "--record only takes the GPU run, the files are what --cpu compares against" << '\n';
+    return 1;
+  }
+
+  if (record) {
+    std::filesystem::create_directories(data_dir);
+  }
+
+  uint32_t failed_cases = 0;
+  for (const auto& name : cases) {
+    std::string path = data_dir + "/" + name + ".golden";
+
+    GoldenCase golden_case = Golden::build(name);
+    if (cpu && (!golden_case.emitters.empty() || !golden_case.sinks.empty())) {
+      std::cout << name << ": skipped, the CPU backend has no emitters or sinks" << '\n';
+      continue;
+    }
+
+    if (!record && !std::filesystem::exists(path)) {
+      // A harness with nothing to compare against must not pass
+      std::cout << name << ": no golden file at " << path << ", record it with --record" << '\n';
+      failed_cases++;
+      continue;
+    }
+
+    try {
+      GoldenRun run = cpu ? Golden::capture_cpu(golden_case) : Golden::capture(golden_case);
+
+      if (record) {
+        Golden::write(path, golden_case, run);
+        std::cout << name << ": recorded on " << run.device << '\n';
+        continue;
+      }
+
+      GoldenRun expected = Golden::read(path);
+      if (cpu) {
+        Golden::keep_stages(expected, Golden::CPU_STAGES);
+      }
+      uint32_t failed = Golden::compare(std::cout, expected, run);
+      std::cout << name << ": " << (failed == 0 ? "ok" : std::to_string(failed) + " stage(s) differ") << '\n';
+      failed_cases += failed > 0;
+    } catch (const std::runtime_error& error) {
+      std::cout << name << ": " << error.what() << '\n';
+      failed_cases++;
+    }
+  }
+
+  return failed_cases > 0 ? 1 : 0;
+}
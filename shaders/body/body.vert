@@ -0,0 +1,56 @@
+#version 450
+
+struct BodyData {
+    vec4 position;
+    vec4 orientation;
+    vec4 velocity;
+    vec4 angular;
+    vec4 extent;
+};
+
+layout(set = 0, binding = 0) buffer Bodies {
+    BodyData[] data;
+} bodies;
+
+layout(set = 1, binding = 0) uniform Camera {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} camera;
+
+// Each unit mesh only draws the bodies of its own shape
+layout(push_constant) uniform PushConstant {
+    float shape;
+} pc;
+
+layout(location = 0) in vec3 inPos;
+layout(location = 1) in vec3 inColor;
+layout(location = 2) in vec3 inNormal;
+layout(location = 3) in vec2 inUV;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragNormal;
+layout(location = 2) out vec2 fragUV;
+
+vec3 rotate(vec4 q, vec3 v) {
+    return v + 2.0 * cross(q.xyz, cross(q.xyz, v) + q.w * v);
+}
+
+void main() {
+    BodyData body = bodies.data[gl_InstanceIndex];
+
+    fragColor  = inColor;
+    fragNormal = rotate(body.orientation, inNormal);
+    fragUV     = inUV;
+
+    if (body.velocity.w != pc.shape) {
+        // Outside the clip volume, the whole triangle is discarded
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        return;
+    }
+
+    vec3 scale = body.velocity.w == 0.0 ? vec3(body.extent.x) : body.extent.xyz;
+    vec3 pos = body.position.xyz + rotate(body.orientation, inPos * scale);
+
+    gl_Position = camera.proj * camera.view * camera.model * vec4(pos, 1.0);
+}
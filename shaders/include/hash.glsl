@@ -0,0 +1,13 @@
+// Cell hash shared by every shader that touches the spatial table, the sort
+// keys, the neighbour walks and the sleep flags must agree on every cell.
+// The hash is taken unsigned, so negative cells wrap the same way everywhere.
+// src/system/CellHash.hpp is the host copy the CPU backend uses.
+
+const int HASH_K1 = 73856093;
+const int HASH_K2 = 19349663;
+const int HASH_K3 = 83492791;
+
+uint cell_key(ivec3 cell, uint cells) {
+    uint hash = uint(cell.x * HASH_K1) ^ uint(cell.y * HASH_K2) ^ uint(cell.z * HASH_K3);
+    return hash % cells;
+}
@@ -38,6 +38,11 @@ void main() {
     vec3 pos = instance_data.position.xyz;
         
     gl_Position = camera.proj * camera.view * camera.model * vec4(pos + inPos, 1.0);
+
+    // Removed by a sink this step, it leaves the live range after the next sort
+    if (instance_data.velocity.w < 0.0) {
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+    }
 }
 
 
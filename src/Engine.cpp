@@ -3,7 +3,9 @@
 
 
 #include "Renderer.hpp"
+#include "buffer/MemoryStats.hpp"
 #include <iostream>
+#include <cstdio>
 
 Engine::Engine() {
   context.init(window);
@@ -12,6 +14,14 @@ Engine::Engine() {
   scene.init(context, handler.descriptor_builder);
 
   renderer.build_resources(context, scene);
+
+  telemetry = std::make_unique<Telemetry>(context.device, context.physical_device, context.queue_index.index.value(), Swapchain::MAX_FRAMES_IN_FLIGHT);
+  renderer.set_telemetry(telemetry.get());
+
+  if (!Trace::path.empty()) {
+    trace = std::make_unique<Trace>(context.get_instance(), context.device, context.physical_device, context.queue_index.index.value(), context.get_commandpool(), context.calibrated_timestamps_enabled());
+    renderer.set_trace(trace.get());
+  }
 }
 
 void Engine::run() {
@@ -20,27 +30,64 @@ void Engine::run() {
   int frames = 0;
 
   while (!window.should_window_close()) {
+    TraceScope frame_scope(trace.get(), "frame");
     double current_time = window.time();
     float delta_time = static_cast<float>(current_time - last_time);
 
-    scene.camera->update(window, delta_time);
-    scene.fluid_system->update_boundary(window);
+    {
+      TraceScope scope(trace.get(), "camera update");
+      scene.camera->update(window, delta_time);
+    }
+    if (scene.replayer) {
+      scene.replayer->update(window, delta_time);
+    } else {
+      TraceScope scope(trace.get(), "update boundary");
+      scene.simulation().update_boundary(window);
+    }
 
-    renderer.draw(context, window, scene, current_frame);
+    renderer.draw(context, window, scene, handler.descriptor_builder, current_frame);
 
     current_frame = (current_frame + 1) % Swapchain::MAX_FRAMES_IN_FLIGHT;
-    window.poll_events();
+    {
+      TraceScope scope(trace.get(), "poll events");
+      window.poll_events();
+    }
+
+    telemetry->end_frame((window.time() - current_time) * 1000.0);
 
     frames++;
     if (current_time - frame_time >= 1.0) {
-      double fps = frames / delta_time;
-      std::string title = "My App - FPS | " + std::to_string((int)fps);
+      // Every frame since the last update, not just the latest one
+      double fps = frames / (current_time - frame_time);
+      FrameSummary summary = telemetry->summarize(Telemetry::Metric::cpu, frames);
+
+      char p99[16];
+      std::snprintf(p99, sizeof(p99), "%.2f", summary.p99);
+      std::string title = "My App - FPS | " + std::to_string((int)fps) + " | p99 " + p99 + " ms";
 
       window.set_title(title);
       frames = 0;
       frame_time = current_time;
+
+      // Keeps the GPU track from drifting against the host clock
+      if (trace) {
+        trace->recalibrate();
+      }
     }
 
     last_time = current_time; 
   }
+
+  vkDeviceWaitIdle(context.device);
+  if (!Checkpointer::path.empty()) {
+    scene.save_checkpoint(context.get_commandpool());
+  }
+  telemetry->flush();
+  telemetry->report(std::cout, Telemetry::report_window);
+  MemoryStats::report(std::cout);
+
+  if (trace) {
+    renderer.flush_profiler();
+    trace->write(Trace::path);
+  }
 }
@@ -2,6 +2,9 @@
 #pragma once
 
 #include "Renderer.hpp"
+#include "profiler/Telemetry.hpp"
+
+#include <memory>
 
 class Engine {
 
@@ -24,7 +27,10 @@ class Engine {
     Scene scene; 
 
     Renderer renderer;
-    
+
+    // After the context so the query pool goes first
+    std::unique_ptr<Telemetry> telemetry;
+    std::unique_ptr<Trace> trace;
 
     uint32_t current_frame = 0;
 };
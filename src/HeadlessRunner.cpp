@@ -0,0 +1,182 @@
+#include "HeadlessRunner.hpp"
+#include "buffer/MemoryStats.hpp"
+#include "command/UploadManager.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+
+HeadlessRunner::HeadlessRunner() {
+  context.init_headless();
+  handler.init(context.device);
+  scene.init(context, handler.descriptor_builder);
+
+  if (verbose) {
+    std::cout << "Headless on " << device_name() << '\n';
+  }
+
+  context.get_commandpool().create_command_buffer(commandbuffers.data(), IN_FLIGHT, VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
+  if (Profiler::enabled) {
+    profiler = std::make_unique<Profiler>(context.device, context.physical_device, context.get_instance(), context.queue_index.index.value(), IN_FLIGHT, context.debug_utils_enabled());
+    scene.fluid_system->set_profiler(profiler.get());
+  }
+
+  if (!Trace::path.empty()) {
+    trace = std::make_unique<Trace>(context.get_instance(), context.device, context.physical_device, context.queue_index.index.value(), context.get_commandpool(), context.calibrated_timestamps_enabled());
+    if (profiler) {
+      profiler->set_trace(trace.get());
+    }
+  }
+
+  telemetry = std::make_unique<Telemetry>(context.device, context.physical_device, context.queue_index.index.value(), IN_FLIGHT);
+
+  VkFenceCreateInfo fence_info{};
+  fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+  for (auto& fence : fences) {
+    if (vkCreateFence(context.device, &fence_info, nullptr, &fence) != VK_SUCCESS) {
+      throw std::runtime_error("Unable to create fence");
+    }
+  }
+}
+
+HeadlessRunner::~HeadlessRunner() {
+  vkDeviceWaitIdle(context.device);
+
+  for (auto& fence : fences) {
+    vkDestroyFence(context.device, fence, nullptr);
+  }
+}
+
+std::string HeadlessRunner::device_name() const {
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(context.physical_device, &properties);
+  return properties.deviceName;
+}
+
+void HeadlessRunner::record_step(VkCommandBuffer commandbuffer) {
+  // Frames normally get this from the submit boundary, here the previous step
+  // can sit in the same command buffer
+  VkMemoryBarrier step_barrier{};
+  step_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  step_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+  step_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+    0,
+    1, &step_barrier,
+    0, nullptr,
+    0, nullptr
+  );
+
+  // Nothing is drawn, so the CPU backend skips the upload Scene::step does
+  scene.simulation().run(context.get_commandpool(), commandbuffer);
+}
+
+HeadlessRunner::Result HeadlessRunner::run(uint32_t steps) {
+  auto start = std::chrono::steady_clock::now();
+
+  uint32_t submitted = 0;
+  uint32_t current = 0;
+  while (submitted < steps) {
+    auto submit_start = std::chrono::steady_clock::now();
+    {
+      TraceScope scope(trace.get(), "fence wait");
+      vkWaitForFences(context.device, 1, &fences[current], VK_TRUE, UINT64_MAX);
+      vkResetFences(context.device, 1, &fences[current]);
+    }
+    telemetry->add_present_wait(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - submit_start).count());
+    scene.grow(context.get_commandpool(), handler.descriptor_builder);
+
+    uint64_t record_start = trace ? Trace::now() : 0;
+
+    scene.begin_frame(current);
+    VkCommandBuffer commandbuffer = commandbuffers[current];
+    vkResetCommandBuffer(commandbuffer, 0);
+
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    if (vkBeginCommandBuffer(commandbuffer, &begin_info) != VK_SUCCESS) {
+      throw std::runtime_error("failed to begin recording command buffer!");
+    }
+
+    telemetry->begin_gpu(commandbuffer, current);
+
+    if (profiler) {
+      profiler->begin_frame(commandbuffer, current);
+    }
+
+    uint32_t batch = std::min(std::max(steps_per_submit, 1u), steps - submitted);
+    for (uint32_t i = 0; i < batch; i++) {
+      record_step(commandbuffer);
+    }
+
+    telemetry->end_gpu(commandbuffer);
+
+    if (vkEndCommandBuffer(commandbuffer) != VK_SUCCESS) {
+      throw std::runtime_error("Unable to end command buffer");
+    }
+
+    if (trace) {
+      trace->cpu_event("record", record_start, Trace::now());
+    }
+
+    VkSubmitInfo submit_info{};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &commandbuffer;
+
+    {
+      TraceScope scope(trace.get(), "queue submit");
+      context.get_commandpool().uploads().flush();
+      if (vkQueueSubmit(context.queue, 1, &submit_info, fences[current]) != VK_SUCCESS) {
+        throw std::runtime_error("Unable to submit simulation steps");
+      }
+    }
+
+    telemetry->add_steps(batch);
+    telemetry->end_frame(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - submit_start).count());
+
+    submitted += batch;
+    current = (current + 1) % IN_FLIGHT;
+  }
+
+  {
+    TraceScope scope(trace.get(), "queue wait idle");
+    vkQueueWaitIdle(context.queue);
+  }
+  if (!Checkpointer::path.empty()) {
+    scene.save_checkpoint(context.get_commandpool());
+  }
+  telemetry->flush();
+  if (verbose) {
+    telemetry->report(std::cout, Telemetry::report_window);
+    MemoryStats::report(std::cout);
+  }
+
+  if (profiler) {
+    profiler->flush();
+    if (verbose && Profiler::report_interval > 0) {
+      profiler->report(std::cout);
+    }
+  }
+
+  if (trace) {
+    trace->write(Trace::path);
+  }
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  if (verbose) {
+    std::cout << steps << " steps in " << seconds << " s, " << (seconds > 0.0 ? steps / seconds : 0.0) << " steps/s" << '\n';
+  }
+
+  return {steps, seconds};
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "context/VulkanContext.hpp"
+#include "descriptors/DescriptorHandler.hpp"
+#include "scene/Scene.hpp"
+#include "profiler/Profiler.hpp"
+#include "profiler/Telemetry.hpp"
+
+#include <array>
+#include <memory>
+#include <string>
+
+// Steps the simulation without GLFW, a window or a swapchain. Several steps are
+// recorded per submit and two submits stay in flight, so the queue never idles
+// waiting on the host.
+class HeadlessRunner {
+
+  public:
+    HeadlessRunner();
+    ~HeadlessRunner();
+
+    struct Result {
+      uint32_t steps;
+      double seconds;
+    };
+
+    Result run(uint32_t steps);
+
+    Scene& get_scene() { return scene; }
+    CommandPool& get_commandpool() { return context.get_commandpool(); }
+    // Null unless Profiler::enabled was set before construction
+    Profiler* get_profiler() { return profiler.get(); }
+    std::string device_name() const;
+
+    inline static uint32_t steps_per_submit = 16;
+    // Off keeps stdout clean for callers that print their own results
+    inline static bool verbose = true;
+
+  private:
+    void record_step(VkCommandBuffer commandbuffer);
+
+    VulkanContext context;
+    DescriptorHandler handler;
+    Scene scene;
+
+    static constexpr uint32_t IN_FLIGHT = 2;
+    std::array<VkCommandBuffer, IN_FLIGHT> commandbuffers;
+    std::array<VkFence, IN_FLIGHT> fences;
+
+    std::unique_ptr<Profiler> profiler;
+
+    // One sample per submit, the fence wait stands in for the present wait
+    std::unique_ptr<Telemetry> telemetry;
+    std::unique_ptr<Trace> trace;
+};
@@ -0,0 +1,212 @@
+#include "Options.hpp"
+#include "scene/Scene.hpp"
+#include "HeadlessRunner.hpp"
+#include "profiler/Profiler.hpp"
+#include "profiler/Telemetry.hpp"
+#include "profiler/Trace.hpp"
+#include "system/subsystem/Counters.hpp"
+#include "system/subsystem/Exporter.hpp"
+#include "record/FrameCodec.hpp"
+#include "record/Replayer.hpp"
+#include "system/subsystem/Checkpointer.hpp"
+#include "system/subsystem/MeshFill.hpp"
+#include "scene/SceneFile.hpp"
+#include "pipeline/PipelineCache.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+static uint32_t parse_uint(const std::string& flag, const std::string& value) {
+  size_t end = 0;
+  unsigned long result = 0;
+  try {
+    result = std::stoul(value, &end);
+  } catch (const std::exception&) {
+    end = 0;
+  }
+
+  if (end != value.size() || result > UINT32_MAX) {
+    throw std::runtime_error(flag + " expects an unsigned integer, got '" + value + "'");
+  }
+  return static_cast<uint32_t>(result);
+}
+
+static float parse_float(const std::string& flag, const std::string& value) {
+  size_t end = 0;
+  float result = 0.0f;
+  try {
+    result = std::stof(value, &end);
+  } catch (const std::exception&) {
+    end = 0;
+  }
+
+  if (end != value.size() || !(result >= 0.0f)) {
+    throw std::runtime_error(flag + " expects a non-negative number, got '" + value + "'");
+  }
+  return result;
+}
+
+Options Options::parse(int argc, char** argv) {
+  Options options;
+
+  for (int i = 1; i < argc; i++) {
+    std::string flag = argv[i];
+
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        throw std::runtime_error(flag + " needs a value");
+      }
+      return argv[++i];
+    };
+
+    if (flag == "--scene") {
+      options.scene_path = value();
+    } else if (flag == "--set") {
+      options.overrides.push_back(value());
+    } else if (flag == "--seed") {
+      options.seed = parse_uint(flag, value());
+    } else if (flag == "--grow-to") {
+      options.grow_to = parse_uint(flag, value());
+    } else if (flag == "--cpu") {
+      options.cpu_simulation = true;
+    } else if (flag == "--headless") {
+      options.headless = true;
+    } else if (flag == "--steps") {
+      options.steps = parse_uint(flag, value());
+    } else if (flag == "--profile") {
+      options.profile = true;
+    } else if (flag == "--telemetry") {
+      options.telemetry_path = value();
+    } else if (flag == "--trace") {
+      options.trace_path = value();
+    } else if (flag == "--pipeline-cache") {
+      options.pipeline_cache_path = value();
+    } else if (flag == "--counters") {
+      options.counter_interval = parse_uint(flag, value());
+    } else if (flag == "--export") {
+      options.export_dir = value();
+    } else if (flag == "--export-format") {
+      options.export_format = value();
+      Exporter::parse_format(options.export_format);
+    } else if (flag == "--export-interval") {
+      options.export_interval = std::max(parse_uint(flag, value()), 1u);
+    } else if (flag == "--export-bits") {
+      options.export_bits = parse_uint(flag, value());
+      if (options.export_bits < FrameCodec::MIN_POSITION_BITS || options.export_bits > FrameCodec::MAX_POSITION_BITS) {
+        throw std::runtime_error("--export-bits expects 16 to 21");
+      }
+    } else if (flag == "--export-slots") {
+      options.export_slots = std::max(parse_uint(flag, value()), 1u);
+    } else if (flag == "--checkpoint") {
+      options.checkpoint_path = value();
+    } else if (flag == "--checkpoint-interval") {
+      options.checkpoint_interval = parse_uint(flag, value());
+    } else if (flag == "--restore") {
+      options.restore_path = value();
+    } else if (flag == "--replay") {
+      options.replay_dir = value();
+    } else if (flag == "--replay-rate") {
+      options.replay_rate = static_cast<float>(std::max(parse_uint(flag, value()), 1u));
+    } else if (flag == "--fill") {
+      options.fill_paths.push_back(value());
+    } else if (flag == "--fill-spacing") {
+      options.fill_spacing = parse_float(flag, value());
+      if (*options.fill_spacing <= 0.0f) {
+        throw std::runtime_error("--fill-spacing expects a positive number");
+      }
+    } else if (flag == "--fill-jitter") {
+      options.fill_jitter = std::min(parse_float(flag, value()), 1.0f);
+    } else if (flag == "--batch") {
+      options.steps_per_submit = std::max(parse_uint(flag, value()), 1u);
+    } else {
+      throw std::runtime_error("Unknown option '" + flag + "'\n" + usage());
+    }
+  }
+
+  if (options.headless && !options.replay_dir.empty()) {
+    throw std::runtime_error("--replay needs a window, it cannot run with --headless");
+  }
+
+  return options;
+}
+
+std::string Options::usage() {
+  return
+    "Usage: app [options]\n"
+    "  --scene <file>  Particle count, domain, fluid volumes and solver constants from a TOML file\n"
+    "  --set <key=value>  Override one scene key, such as solver.smoothing_radius=0.15, repeatable\n"
+    "  --seed <n>   Seed the particle layout, repeated runs match bit for bit\n"
+    "  --grow-to <n>  Let emitters grow the particle buffers up to n particles\n"
+    "  --cpu        Step the simulation on the CPU backend\n"
+    "  --headless   Run without a window on any compute capable device\n"
+    "  --steps <n>  Steps to run headless, 1000 by default\n"
+    "  --batch <n>  Headless steps recorded per submit, 16 by default\n"
+    "  --profile    Time every pass on the GPU and print rolling statistics\n"
+    "  --telemetry <file>  Per frame timings as CSV on exit, telemetry.csv by default, \"\" to skip\n"
+    "  --trace <file>  Host and GPU timeline as Chrome trace JSON for Perfetto\n"
+    "  --pipeline-cache <file>  Compiled pipelines kept between runs, pipeline_cache.bin by default, \"\" to skip\n"
+    "  --counters <n>  Count neighbour pairs and hash collisions on every n-th step\n"
+    "  --export <dir>  Write particle frames from a background thread\n"
+    "  --export-format <raw|ply|vtk|fsq>  Frame file format, raw by default\n"
+    "  --export-interval <n>  Steps between exported frames, 1 by default\n"
+    "  --export-bits <n>  Bits per position axis in fsq frames, 16 to 21, 16 by default\n"
+    "  --export-slots <n>  Frames buffered between the GPU and the writer, 8 by default\n"
+    "  --checkpoint <file>  Save the simulation state here at exit\n"
+    "  --checkpoint-interval <n>  Also save it every n steps in the background\n"
+    "  --restore <file>  Start from a saved checkpoint instead of a fresh layout\n"
+    "  --replay <dir>  Play back frames written by --export instead of simulating\n"
+    "  --replay-rate <n>  Recorded frames shown per second, 60 by default\n"
+    "  --fill <obj>  Start with the inside of this mesh filled, repeatable\n"
+    "  --fill-spacing <d>  Distance between filled particles, 0.16 by default\n"
+    "  --fill-jitter <f>  Random offset as a fraction of the spacing, 0 to 1, 0.5 by default\n";
+}
+
+void Options::apply() const {
+  SceneFile scene;
+  if (!scene_path.empty()) {
+    scene = SceneFile::load(scene_path);
+  }
+  for (const auto& assignment : overrides) {
+    scene.set(assignment);
+  }
+  scene.apply();
+
+  if (seed) {
+    Scene::seed = seed;
+  }
+  if (grow_to) {
+    Scene::grow_limit = *grow_to;
+  }
+  Scene::cpu_simulation = cpu_simulation;
+  HeadlessRunner::steps_per_submit = steps_per_submit;
+  // The trace takes its GPU scopes from the profiler, which stays quiet unless asked
+  Profiler::enabled = profile || !trace_path.empty();
+  if (!profile) {
+    Profiler::report_interval = 0;
+  }
+  Trace::path = trace_path;
+  PipelineCache::path = pipeline_cache_path;
+  Telemetry::csv_path = telemetry_path;
+  Counters::interval = counter_interval;
+  Exporter::directory = export_dir;
+  Exporter::format = Exporter::parse_format(export_format);
+  Exporter::interval = export_interval;
+  Exporter::slots = export_slots;
+  FrameCodec::position_bits = export_bits;
+  Checkpointer::path = checkpoint_path;
+  Checkpointer::interval = checkpoint_interval;
+  Scene::restore = restore_path;
+  Replayer::directory = replay_dir;
+  Replayer::frame_rate = replay_rate;
+  for (const auto& path : fill_paths) {
+    FillMesh mesh{};
+    mesh.path = path;
+    Scene::fill_meshes.push_back(mesh);
+  }
+  if (fill_spacing) {
+    MeshFill::spacing = *fill_spacing;
+  }
+  if (fill_jitter) {
+    MeshFill::jitter = *fill_jitter;
+  }
+}
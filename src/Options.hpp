@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Command line flags, applied to the Scene settings before the engine starts
+struct Options {
+  // Scene description read first, the flags below and then --set override it
+  std::string scene_path;
+  std::vector<std::string> overrides;
+
+  // Same seed, same device and same scene give bitwise identical particle buffers
+  std::optional<uint32_t> seed;
+  bool cpu_simulation = false;
+  // Capacity emitters may grow the particle buffers to, unset keeps the scene's
+  std::optional<uint32_t> grow_to;
+
+  // Compute only run of a fixed number of steps, no window
+  bool headless = false;
+  uint32_t steps = 1000;
+  uint32_t steps_per_submit = 16;
+
+  // GPU pass timings printed every report_interval frames
+  bool profile = false;
+
+  // Per frame timings written here on exit, empty to skip
+  std::string telemetry_path = "telemetry.csv";
+
+  // Chrome trace event JSON of host and GPU scopes, empty to skip
+  std::string trace_path;
+
+  // Pipeline cache kept between runs, empty to build every pipeline cold
+  std::string pipeline_cache_path = "pipeline_cache.bin";
+
+  // Steps between GPU neighbour and hash counter samples, zero for none
+  uint32_t counter_interval = 0;
+
+  // Particle frames written here by a background thread, empty to skip
+  std::string export_dir;
+  std::string export_format = "raw";
+  uint32_t export_interval = 1;
+  uint32_t export_bits = 16;
+  uint32_t export_slots = 8;
+
+  // State written here at exit, and every checkpoint_interval steps in the
+  // background when that is set
+  std::string checkpoint_path;
+  uint32_t checkpoint_interval = 0;
+  // Checkpoint to start from instead of a fresh layout
+  std::string restore_path;
+
+  // Recorded frames played back instead of simulating, needs a window
+  std::string replay_dir;
+  float replay_rate = 60.0f;
+
+  // Meshes filled with the starting particles in place of the default block
+  std::vector<std::string> fill_paths;
+  std::optional<float> fill_spacing;
+  std::optional<float> fill_jitter;
+
+  static Options parse(int argc, char** argv);
+  static std::string usage();
+
+  // Throws when the scene file or an override is invalid
+  void apply() const;
+};
@@ -1,7 +1,11 @@
 
 #include "Renderer.hpp"
+#include "scene/entities/Sphere.hpp"
+#include "scene/entities/Box.hpp"
+#include "command/UploadManager.hpp"
 
 #include <stdexcept>
+#include <chrono>
 #include <cmath>
 #include <iostream>
 #include <vulkan/vulkan_core.h>
@@ -31,8 +35,46 @@ void Renderer::build_resources(VulkanContext& context, Scene& scene) {
   for (auto& entity : scene.entities) {
     meshes.emplace_back(context.device, context.physical_device, *entity, context.get_commandpool(), Scene::instances); 
   }
+
+  // Particles are drawn with the first entity mesh
+  if (!meshes.empty()) {
+    scene.fluid_system->init_draw_arguments(context.get_commandpool(), meshes.front().get_index_count());
+  }
  
   graphics_pipeline->create(renderpass->renderpass, {scene.fluid_system->particle_layout_graphics, scene.camera->layout});
+
+  uint32_t body_count = scene.fluid_system->body_count();
+  if (body_count > 0) {
+    Sphere sphere(1.0f);
+    Box box;
+
+    // Same order as RigidShape
+    body_meshes.reserve(2);
+    body_meshes.emplace_back(context.device, context.physical_device, sphere, context.get_commandpool(), body_count);
+    body_meshes.emplace_back(context.device, context.physical_device, box, context.get_commandpool(), body_count);
+
+    body_pipeline = std::make_unique<GraphicsPipeline>(device, "shaders/body/body.vert.spv", "shaders/vertex.frag.spv");
+    body_pipeline->create(renderpass->renderpass, {scene.fluid_system->body_layout_graphics(), scene.camera->layout});
+  }
+
+  if (Profiler::enabled) {
+    profiler = std::make_unique<Profiler>(context.device, context.physical_device, context.get_instance(), context.queue_index.index.value(), Swapchain::MAX_FRAMES_IN_FLIGHT, context.debug_utils_enabled());
+    scene.fluid_system->set_profiler(profiler.get());
+  }
+}
+
+void Renderer::set_trace(Trace* trace) {
+  this->trace = trace;
+  swapchain->trace = trace;
+  if (profiler) {
+    profiler->set_trace(trace);
+  }
+}
+
+void Renderer::flush_profiler() {
+  if (profiler) {
+    profiler->flush();
+  }
 }
 
 void Renderer::recreate_frame(VulkanContext& context, Window& window) {
@@ -45,11 +87,16 @@ void Renderer::recreate_frame(VulkanContext& context, Window& window) {
   renderpass->init_resources(*swapchain, context.get_commandpool());
 }
 
-void Renderer::draw(VulkanContext& context, Window& window, Scene& scene, uint32_t current_frame) {
+void Renderer::draw(VulkanContext& context, Window& window, Scene& scene, DescriptorBuilder& builder, uint32_t current_frame) {
 
   uint32_t image_index;
+  auto wait_start = std::chrono::steady_clock::now();
   VkResult result = swapchain->acquire_image(&image_index, current_frame);
 
+  if (telemetry) {
+    telemetry->add_present_wait(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - wait_start).count());
+  }
+
   if (result == VK_ERROR_OUT_OF_DATE_KHR) {
     recreate_frame(context, window);
     return;
@@ -57,7 +104,14 @@ void Renderer::draw(VulkanContext& context, Window& window, Scene& scene, uint32
     throw std::runtime_error("failed to acquire swap chain image!");
   }
 
+  {
+    TraceScope scope(trace, "grow");
+    scene.grow(context.get_commandpool(), builder);
+  }
+
+  uint64_t record_start = trace ? Trace::now() : 0;
 
+  scene.begin_frame(current_frame);
   vkResetCommandBuffer(commandbuffers[current_frame], 0);
 
   VkCommandBufferBeginInfo begin_info{};
@@ -67,7 +121,27 @@ void Renderer::draw(VulkanContext& context, Window& window, Scene& scene, uint32
     throw std::runtime_error("failed to begin recording command buffer!");
   }
 
-  scene.fluid_system->run(context.get_commandpool(), commandbuffers[current_frame]);
+  if (telemetry) {
+    telemetry->begin_gpu(commandbuffers[current_frame], current_frame);
+  }
+
+  if (profiler) {
+    profiler->begin_frame(commandbuffers[current_frame], current_frame);
+  }
+
+  {
+    // Includes the whole step when the CPU backend runs
+    TraceScope scope(trace, "scene step");
+    scene.step(context.get_commandpool(), commandbuffers[current_frame]);
+  }
+
+  if (telemetry) {
+    telemetry->add_steps(1);
+  }
+
+  if (profiler) {
+    profiler->begin(commandbuffers[current_frame], "draw");
+  }
 
   renderpass->begin_renderpass(*swapchain, commandbuffers[current_frame], image_index);
   graphics_pipeline->bind_pipeline(commandbuffers[current_frame]);
@@ -77,16 +151,43 @@ void Renderer::draw(VulkanContext& context, Window& window, Scene& scene, uint32
 
   for (auto& mesh : meshes) {
     mesh.bind(commandbuffers[current_frame]);
-    mesh.draw(commandbuffers[current_frame]);
+    mesh.draw_indirect(commandbuffers[current_frame], scene.fluid_system->draw_arguments());
+  }
+
+  if (body_pipeline) {
+    body_pipeline->bind_pipeline(commandbuffers[current_frame]);
+    scene.fluid_system->bind_bodies(commandbuffers[current_frame], *body_pipeline, VK_PIPELINE_BIND_POINT_GRAPHICS);
+    scene.camera->bind_camera(commandbuffers[current_frame], *body_pipeline, VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+    for (size_t i = 0; i < body_meshes.size(); i++) {
+      float shape = static_cast<float>(i);
+      body_pipeline->bind_push_constants(commandbuffers[current_frame], VK_SHADER_STAGE_VERTEX_BIT, sizeof(float), &shape);
+      body_meshes[i].bind(commandbuffers[current_frame]);
+      body_meshes[i].draw(commandbuffers[current_frame]);
+    }
   }
 
   renderpass->end_renderpass(commandbuffers[current_frame]);
 
+  if (profiler) {
+    profiler->end(commandbuffers[current_frame]);
+  }
+
+  if (telemetry) {
+    telemetry->end_gpu(commandbuffers[current_frame]);
+  }
+
    
   if (vkEndCommandBuffer(commandbuffers[current_frame]) != VK_SUCCESS) {
     throw std::runtime_error("Unable to end command buffer");
   }
 
+  if (trace) {
+    trace->cpu_event("record", record_start, Trace::now());
+  }
+
+  // Uploads made while recording land before the frame runs
+  context.get_commandpool().uploads().flush();
   result = swapchain->submit_command(commandbuffers[current_frame], current_frame, &image_index);
   // scene.fluid_system->print_data(context.get_commandpool(), context.physical_device);
   // scene.fluid_system->print_density(context.get_commandpool(), context.physical_device);
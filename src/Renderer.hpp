@@ -6,6 +6,8 @@
 #include "renderpass/Renderpass.hpp"
 #include "pipeline/GraphicsPipeline.hpp"
 #include "descriptors/DescriptorHandler.hpp"
+#include "profiler/Profiler.hpp"
+#include "profiler/Telemetry.hpp"
 
 #include "scene/pipelines/BoundaryPipeline.hpp"
 
@@ -19,7 +21,18 @@ class Renderer {
     void init(VulkanContext& context, Window& window);
     void build_resources(VulkanContext& context, Scene& scene);
   
-    void draw(VulkanContext& context, Window& window, Scene& scene, uint32_t current_frame);
+    // Grows the scene once this frame's fence has signalled, so the count
+    // readback it checks covers the frame last submitted in this slot
+    void draw(VulkanContext& context, Window& window, Scene& scene, DescriptorBuilder& builder, uint32_t current_frame);
+
+    // Records GPU frame time, present wait and steps into the engine's telemetry
+    void set_telemetry(Telemetry* telemetry) { this->telemetry = telemetry; }
+
+    // Host scopes of the frame, and the profiler's GPU scopes when it exists
+    void set_trace(Trace* trace);
+
+    // Reads the last frames' timestamps, only once the device is idle
+    void flush_profiler();
     
   private:
     void recreate_frame(VulkanContext& context, Window& window); 
@@ -35,6 +48,14 @@ class Renderer {
 
     std::vector<Mesh> meshes;
 
+    // Unit sphere and box, instanced once per rigid body
+    std::unique_ptr<GraphicsPipeline> body_pipeline;
+    std::vector<Mesh> body_meshes;
+
+    std::unique_ptr<Profiler> profiler;
+    Telemetry* telemetry = nullptr;
+    Trace* trace = nullptr;
+
 
     VkDevice device = VK_NULL_HANDLE;
     VkPhysicalDevice physical_device = VK_NULL_HANDLE;
@@ -25,16 +25,15 @@ Buffer::Buffer(
   VkMemoryRequirements mem_requirements;
   vkGetBufferMemoryRequirements(device, buffer, &mem_requirements);
 
-  VkMemoryAllocateInfo alloc_info{}; 
-  alloc_info.sType= VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  alloc_info.allocationSize = mem_requirements.size;
-  alloc_info.memoryTypeIndex = find_memory_type(mem_requirements.memoryTypeBits, properties);
-
-  if (vkAllocateMemory(device, &alloc_info, nullptr, &memory) != VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate buffer memory!");
+  MemoryCategory category = (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) ? MemoryCategory::host_buffer : MemoryCategory::device_buffer;
+  try {
+    allocation = MemoryAllocator::get(device, physical_device).allocate(mem_requirements, properties, category);
+  } catch (...) {
+    vkDestroyBuffer(device, buffer, nullptr);
+    throw;
   }
-  
-  vkBindBufferMemory(device, buffer, memory, 0);
+
+  vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
 
   descriptor_buffer_info.buffer = buffer;
   descriptor_buffer_info.offset = 0;
@@ -42,26 +41,13 @@ Buffer::Buffer(
 }
 
 Buffer::~Buffer() {
-  if (memory != VK_NULL_HANDLE) {
-    vkFreeMemory(device, memory, nullptr);
-  }
-
   if (buffer != VK_NULL_HANDLE) {
     vkDestroyBuffer(device, buffer, nullptr);
   }
-}
 
-uint32_t Buffer::find_memory_type(uint32_t filter, VkMemoryPropertyFlags properties) {
-  VkPhysicalDeviceMemoryProperties mem_properties;
-  vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_properties);
-
-  for (uint32_t i = 0; i < mem_properties.memoryTypeCount; ++i) {
-    if ((filter & (1 << i)) && (mem_properties.memoryTypes[i].propertyFlags & properties) == properties) {
-      return i;
-    }
+  if (allocation.memory != VK_NULL_HANDLE) {
+    MemoryAllocator::free(device, allocation);
   }
-
-  throw std::runtime_error("failed to find suitable memory type!");
 }
 
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../command/CommandPool.hpp"
+#include "MemoryAllocator.hpp"
 
 class Buffer {
   public:
@@ -16,10 +17,9 @@ class Buffer {
     VkBuffer buffer = VK_NULL_HANDLE;
 
   protected:
-    uint32_t find_memory_type(uint32_t filter, VkMemoryPropertyFlags properties);
-
     VkDevice device;
     VkPhysicalDevice physical_device;
-    VkDeviceMemory memory = VK_NULL_HANDLE; 
+    // A range of one of the allocator's blocks, or dedicated memory for large buffers
+    MemoryAllocation allocation;
     VkDescriptorBufferInfo descriptor_buffer_info;
 };
@@ -2,6 +2,7 @@
 #include "HostBuffer.hpp"
 
 #include <cstring>
+#include <stdexcept>
 
 HostBuffer::HostBuffer(
   VkDevice device, 
@@ -11,17 +12,16 @@ HostBuffer::HostBuffer(
 ) : Buffer(device, physical_device, size, usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) {}
 
 void HostBuffer::fillData(void* values, uint32_t dataSize) {
-  void* data;
-  vkMapMemory(device, memory, 0, dataSize, 0, &data);
-  memcpy(data, values, (size_t) dataSize);
-  vkUnmapMemory(device, memory);
+  memcpy(map(), values, (size_t) dataSize);
 }
 
 void HostBuffer::getData(void* values) {
-  void* data;
-  vkMapMemory(device, memory, 0, size, 0, &data);
-
-  memcpy(values, data, (size_t) size);
-  vkUnmapMemory(device, memory);
+  memcpy(values, map(), (size_t) size);
 }
 
+void* HostBuffer::map() {
+  if (!allocation.mapped) {
+    throw std::runtime_error("Unable to map host buffer");
+  }
+  return allocation.mapped;
+}
@@ -10,4 +10,8 @@ class HostBuffer : public Buffer {
     void fillData(void* values, uint32_t dataSize);
     void getData(void* values);
 
+    // Host memory is mapped by the allocator for as long as it is allocated,
+    // this is the buffer's part of it
+    void* map();
+
 };
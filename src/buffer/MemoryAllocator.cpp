@@ -0,0 +1,237 @@
+#include "MemoryAllocator.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+
+static std::mutex registry_mutex;
+static std::map<VkDevice, std::unique_ptr<MemoryAllocator>> registry;
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+  return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+}
+
+MemoryAllocator::MemoryAllocator(VkDevice device, VkPhysicalDevice physical_device) : device(device) {
+  vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
+}
+
+MemoryAllocator::~MemoryAllocator() {
+  for (auto& block : blocks) {
+    if (block) {
+      free_memory(block->memory, block->size, block->mapped != nullptr);
+    }
+  }
+}
+
+MemoryAllocator& MemoryAllocator::get(VkDevice device, VkPhysicalDevice physical_device) {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  auto& allocator = registry[device];
+  if (!allocator) {
+    allocator.reset(new MemoryAllocator(device, physical_device));
+  }
+  return *allocator;
+}
+
+void MemoryAllocator::release(VkDevice device) {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  registry.erase(device);
+}
+
+void MemoryAllocator::free(VkDevice device, MemoryAllocation& allocation) {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  auto found = registry.find(device);
+  if (found != registry.end()) {
+    found->second->deallocate(allocation);
+  }
+  allocation = MemoryAllocation{};
+}
+
+MemoryAllocation MemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, MemoryCategory category) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  MemoryAllocation allocation;
+  allocation.size = requirements.size;
+  allocation.category = category;
+
+  uint32_t memory_type = find_memory_type(requirements.memoryTypeBits, properties);
+  bool image = category == MemoryCategory::image;
+
+  // Small heaps, like a 256 MiB host visible window into VRAM, get smaller blocks
+  VkDeviceSize heap_size = memory_properties.memoryHeaps[memory_properties.memoryTypes[memory_type].heapIndex].size;
+  VkDeviceSize chosen_size = (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) ? host_block_size : block_size;
+  chosen_size = std::min(chosen_size, std::max<VkDeviceSize>(heap_size / 8, VkDeviceSize(1) << 20));
+
+  if (requirements.size < chosen_size / 2) {
+    for (size_t i = 0; i < blocks.size(); i++) {
+      Block* block = blocks[i].get();
+      if (!block || block->memory_type != memory_type || block->image != image) continue;
+
+      if (place(*block, requirements.size, requirements.alignment, allocation.offset)) {
+        block->live++;
+        allocation.memory = block->memory;
+        allocation.block = static_cast<uint32_t>(i);
+        allocation.mapped = block->mapped ? block->mapped + allocation.offset : nullptr;
+        MemoryStats::used(category, allocation.size);
+        return allocation;
+      }
+    }
+
+    auto block = std::make_unique<Block>();
+    void* mapped = nullptr;
+    block->memory = allocate_memory(chosen_size, memory_type, &mapped);
+    // Out of memory for a whole block still leaves room for a dedicated one
+    if (block->memory != VK_NULL_HANDLE) {
+      block->size = chosen_size;
+      block->memory_type = memory_type;
+      block->image = image;
+      block->mapped = static_cast<char*>(mapped);
+      place(*block, requirements.size, requirements.alignment, allocation.offset);
+      block->live++;
+
+      auto slot = std::find(blocks.begin(), blocks.end(), nullptr);
+      if (slot == blocks.end()) {
+        slot = blocks.insert(blocks.end(), nullptr);
+      }
+      *slot = std::move(block);
+
+      allocation.memory = (*slot)->memory;
+      allocation.block = static_cast<uint32_t>(slot - blocks.begin());
+      allocation.mapped = (*slot)->mapped ? (*slot)->mapped + allocation.offset : nullptr;
+      MemoryStats::used(category, allocation.size);
+      return allocation;
+    }
+  }
+
+  allocation.memory = allocate_memory(requirements.size, memory_type, &allocation.mapped);
+  if (allocation.memory == VK_NULL_HANDLE) {
+    throw std::runtime_error("failed to allocate " + std::to_string(requirements.size) + " bytes of device memory!");
+  }
+  allocation.block = MemoryAllocation::DEDICATED;
+  MemoryStats::used(category, allocation.size);
+  return allocation;
+}
+
+void MemoryAllocator::deallocate(MemoryAllocation& allocation) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  if (allocation.memory == VK_NULL_HANDLE) {
+    return;
+  }
+  MemoryStats::released(allocation.category, allocation.size);
+
+  if (allocation.block == MemoryAllocation::DEDICATED) {
+    free_memory(allocation.memory, allocation.size, allocation.mapped != nullptr);
+    return;
+  }
+
+  Block& block = *blocks[allocation.block];
+  give_back(block, allocation.offset, allocation.size);
+  block.live--;
+
+  // An empty block goes back to the driver unless it is the last one of its kind
+  if (block.live == 0) {
+    auto kept = std::count_if(blocks.begin(), blocks.end(), [&](const std::unique_ptr<Block>& other) {
+      return other && other->memory_type == block.memory_type && other->image == block.image;
+    });
+    if (kept > 1) {
+      free_memory(block.memory, block.size, block.mapped != nullptr);
+      blocks[allocation.block].reset();
+    }
+  }
+}
+
+uint32_t MemoryAllocator::find_memory_type(uint32_t filter, VkMemoryPropertyFlags properties) const {
+  for (uint32_t i = 0; i < memory_properties.memoryTypeCount; ++i) {
+    if ((filter & (1 << i)) && (memory_properties.memoryTypes[i].propertyFlags & properties) == properties) {
+      return i;
+    }
+  }
+
+  throw std::runtime_error("failed to find suitable memory type!");
+}
+
+VkDeviceMemory MemoryAllocator::allocate_memory(VkDeviceSize size, uint32_t memory_type, void** mapped) {
+  VkMemoryAllocateInfo alloc_info{};
+  alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  alloc_info.allocationSize = size;
+  alloc_info.memoryTypeIndex = memory_type;
+
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  if (vkAllocateMemory(device, &alloc_info, nullptr, &memory) != VK_SUCCESS) {
+    return VK_NULL_HANDLE;
+  }
+  MemoryStats::allocated(size);
+
+  // Mapped once for the whole allocation, vkMapMemory can't map one memory twice
+  *mapped = nullptr;
+  if (memory_properties.memoryTypes[memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+    if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped) != VK_SUCCESS) {
+      vkFreeMemory(device, memory, nullptr);
+      MemoryStats::freed(size);
+      throw std::runtime_error("Unable to map host visible memory");
+    }
+  }
+  return memory;
+}
+
+void MemoryAllocator::free_memory(VkDeviceMemory memory, VkDeviceSize size, bool mapped) {
+  if (mapped) {
+    vkUnmapMemory(device, memory);
+  }
+  vkFreeMemory(device, memory, nullptr);
+  MemoryStats::freed(size);
+}
+
+bool MemoryAllocator::place(Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset) {
+  // First fit among the holes
+  for (auto range = block.free_ranges.begin(); range != block.free_ranges.end(); ++range) {
+    VkDeviceSize start = range->first;
+    VkDeviceSize end = range->first + range->second;
+    VkDeviceSize aligned = align_up(start, alignment);
+    if (aligned + size > end) continue;
+
+    block.free_ranges.erase(range);
+    if (aligned > start) block.free_ranges[start] = aligned - start;
+    if (aligned + size < end) block.free_ranges[aligned + size] = end - aligned - size;
+    offset = aligned;
+    return true;
+  }
+
+  // Otherwise bump the top, the alignment padding becomes a hole
+  VkDeviceSize aligned = align_up(block.top, alignment);
+  if (aligned + size > block.size) {
+    return false;
+  }
+  if (aligned > block.top) {
+    give_back(block, block.top, aligned - block.top);
+  }
+  block.top = aligned + size;
+  offset = aligned;
+  return true;
+}
+
+void MemoryAllocator::give_back(Block& block, VkDeviceSize offset, VkDeviceSize size) {
+  VkDeviceSize start = offset;
+  VkDeviceSize end = offset + size;
+
+  auto next = block.free_ranges.lower_bound(start);
+  if (next != block.free_ranges.end() && next->first == end) {
+    end += next->second;
+    next = block.free_ranges.erase(next);
+  }
+  if (next != block.free_ranges.begin()) {
+    auto previous = std::prev(next);
+    if (previous->first + previous->second == start) {
+      start = previous->first;
+      block.free_ranges.erase(previous);
+    }
+  }
+
+  // A hole that reaches the top lowers it instead, so the block stays linear
+  if (end == block.top) {
+    block.top = start;
+  } else {
+    block.free_ranges[start] = end - start;
+  }
+}
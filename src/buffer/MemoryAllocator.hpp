@@ -0,0 +1,83 @@
+#pragma once
+
+#include "MemoryStats.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// A range of device memory, inside one of the allocator's blocks or in a
+// dedicated allocation of its own
+struct MemoryAllocation {
+  static constexpr uint32_t DEDICATED = UINT32_MAX;
+
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  // Host visible memory stays mapped while it is allocated, this points at offset
+  void* mapped = nullptr;
+  MemoryCategory category = MemoryCategory::device_buffer;
+  uint32_t block = DEDICATED;
+};
+
+class MemoryAllocator {
+
+  public:
+    // Hands out buffers and images from a few large vkAllocateMemory blocks
+    // per memory type instead of one allocation each, which stays far below
+    // maxMemoryAllocationCount and makes creating buffers cheap. Each block
+    // grows linearly and keeps a free list of the holes below its top, merged
+    // with their neighbours. Allocations of half a block or more get
+    // dedicated memory. There is one allocator per device, created on first
+    // use and released with the device.
+    ~MemoryAllocator();
+
+    static MemoryAllocator& get(VkDevice device, VkPhysicalDevice physical_device);
+    // Frees every block, before the device is destroyed
+    static void release(VkDevice device);
+    // Returns the range to its block, nothing to do once the device is released
+    static void free(VkDevice device, MemoryAllocation& allocation);
+
+    MemoryAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, MemoryCategory category);
+
+    // Bytes per block of device local and of host visible memory
+    inline static VkDeviceSize block_size = VkDeviceSize(256) << 20;
+    inline static VkDeviceSize host_block_size = VkDeviceSize(64) << 20;
+
+  private:
+    struct Block {
+      VkDeviceMemory memory = VK_NULL_HANDLE;
+      VkDeviceSize size = 0;
+      uint32_t memory_type = 0;
+      // Images get their own blocks, so buffers and optimal tiling images
+      // never share a bufferImageGranularity page
+      bool image = false;
+      char* mapped = nullptr;
+      // Nothing past top was handed out yet
+      VkDeviceSize top = 0;
+      // Holes below top, offset to size
+      std::map<VkDeviceSize, VkDeviceSize> free_ranges;
+      uint32_t live = 0;
+    };
+
+    MemoryAllocator(VkDevice device, VkPhysicalDevice physical_device);
+
+    void deallocate(MemoryAllocation& allocation);
+    uint32_t find_memory_type(uint32_t filter, VkMemoryPropertyFlags properties) const;
+    VkDeviceMemory allocate_memory(VkDeviceSize size, uint32_t memory_type, void** mapped);
+    void free_memory(VkDeviceMemory memory, VkDeviceSize size, bool mapped);
+
+    static bool place(Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+    static void give_back(Block& block, VkDeviceSize offset, VkDeviceSize size);
+
+    VkDevice device;
+    VkPhysicalDeviceMemoryProperties memory_properties;
+
+    std::mutex mutex;
+    // Freed blocks leave an empty slot, so the indices in allocations stay valid
+    std::vector<std::unique_ptr<Block>> blocks;
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <algorithm>
+#include <array>
+#include <iomanip>
+#include <ostream>
+
+// What the sub-allocations are for, each category keeps its own totals
+enum class MemoryCategory { device_buffer, host_buffer, image, count };
+
+struct MemoryCategoryStats {
+  VkDeviceSize in_use = 0;
+  VkDeviceSize peak = 0;
+  uint32_t allocations = 0;
+};
+
+// in_use and peak are the bytes held through vkAllocateMemory, blocks and
+// dedicated allocations, read by the benchmarks. The categories count the
+// bytes handed out of them.
+struct MemoryStats {
+  inline static VkDeviceSize in_use = 0;
+  inline static VkDeviceSize peak = 0;
+  // Live vkAllocateMemory calls, bounded by maxMemoryAllocationCount
+  inline static uint32_t device_allocations = 0;
+  inline static std::array<MemoryCategoryStats, static_cast<size_t>(MemoryCategory::count)> categories{};
+
+  static void allocated(VkDeviceSize size) {
+    in_use += size;
+    peak = std::max(peak, in_use);
+    device_allocations++;
+  }
+
+  static void freed(VkDeviceSize size) {
+    in_use -= std::min(size, in_use);
+    device_allocations -= std::min(device_allocations, 1u);
+  }
+
+  static void used(MemoryCategory category, VkDeviceSize size) {
+    MemoryCategoryStats& stats = categories[static_cast<size_t>(category)];
+    stats.in_use += size;
+    stats.peak = std::max(stats.peak, stats.in_use);
+    stats.allocations++;
+  }
+
+  static void released(MemoryCategory category, VkDeviceSize size) {
+    MemoryCategoryStats& stats = categories[static_cast<size_t>(category)];
+    stats.in_use -= std::min(size, stats.in_use);
+    stats.allocations -= std::min(stats.allocations, 1u);
+  }
+
+  static void reset_peak() {
+    peak = in_use;
+    for (auto& stats : categories) stats.peak = stats.in_use;
+  }
+
+  static void report(std::ostream& out) {
+    static const char* NAMES[] = {"device buffers", "host buffers", "images"};
+    constexpr double MIB = 1024.0 * 1024.0;
+
+    out << std::fixed << std::setprecision(1);
+    out << "Device memory: " << in_use / MIB << " MiB in " << device_allocations << " allocations, peak " << peak / MIB << " MiB" << '\n';
+    for (size_t i = 0; i < categories.size(); i++) {
+      out << "  " << std::left << std::setw(16) << NAMES[i] << std::right << categories[i].in_use / MIB << " MiB, " << categories[i].allocations << " live, peak " << categories[i].peak / MIB << " MiB" << '\n';
+    }
+    out << std::defaultfloat;
+  }
+};
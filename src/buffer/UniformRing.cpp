@@ -0,0 +1,36 @@
+#include "UniformRing.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+UniformRing::UniformRing(
+  VkDevice device,
+  VkPhysicalDevice physical_device,
+  VkDeviceSize size,
+  uint32_t slots
+) : size(size), slots(slots) {
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physical_device, &properties);
+  VkDeviceSize alignment = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 1);
+  stride = (size + alignment - 1) / alignment * alignment;
+
+  buffer = std::make_unique<HostBuffer>(device, physical_device, stride * slots, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+  mapped = static_cast<char*>(buffer->map());
+
+  info.buffer = buffer->buffer;
+  info.offset = 0;
+  info.range = size;
+}
+
+uint32_t UniformRing::write(uint32_t frame, const void* data) {
+  VkDeviceSize offset = stride * (frame % slots);
+  std::memcpy(mapped + offset, data, size);
+  return static_cast<uint32_t>(offset);
+}
+
+void UniformRing::write_all(const void* data) {
+  for (uint32_t slot = 0; slot < slots; slot++) {
+    std::memcpy(mapped + stride * slot, data, size);
+  }
+}
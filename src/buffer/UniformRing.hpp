@@ -0,0 +1,33 @@
+#pragma once
+
+#include "HostBuffer.hpp"
+
+#include <memory>
+
+class UniformRing {
+
+  public:
+    // One copy of a uniform block per frame in flight, each at an offset
+    // aligned to minUniformBufferOffsetAlignment in one mapped buffer. A frame
+    // writes its own copy once its fence has signalled and binds it with a
+    // dynamic offset, so the host never overwrites what an earlier frame is
+    // still reading.
+    UniformRing(VkDevice device, VkPhysicalDevice physical_device, VkDeviceSize size, uint32_t slots);
+
+    // Copies size bytes into the frame's slot, returns the dynamic offset to bind it with
+    uint32_t write(uint32_t frame, const void* data);
+    // Every slot at once, only while no frame is in flight
+    void write_all(const void* data);
+
+    // One slot wide, bound as VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC
+    const VkDescriptorBufferInfo* get_info() { return &info; };
+
+  private:
+    std::unique_ptr<HostBuffer> buffer;
+    char* mapped;
+
+    VkDeviceSize size;
+    VkDeviceSize stride;
+    uint32_t slots;
+    VkDescriptorBufferInfo info{};
+};
@@ -1,8 +1,14 @@
 
 #include "CommandPool.hpp"
+#include "UploadManager.hpp"
 #include <stdexcept>
 
-CommandPool::CommandPool(VkDevice device, VkQueue queue, uint32_t queue_index) : device(device), queue(queue) {
+CommandPool::CommandPool(
+  VkDevice device,
+  VkPhysicalDevice physical_device,
+  VkQueue queue, uint32_t queue_index,
+  VkQueue transfer_queue, uint32_t transfer_index
+) : device(device), queue(queue) {
   VkCommandPoolCreateInfo pool_info{};
   pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
   pool_info.queueFamilyIndex = queue_index;
@@ -11,7 +17,20 @@ CommandPool::CommandPool(VkDevice device, VkQueue queue, uint32_t queue_index) :
   if (vkCreateCommandPool(device, &pool_info, nullptr, &command_pool) != VK_SUCCESS) {
     throw std::runtime_error("Unable to create command pool");
   }
- 
+
+  VkFenceCreateInfo fence_info{};
+  fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  if (vkCreateFence(device, &fence_info, nullptr, &single_fence) != VK_SUCCESS) {
+    throw std::runtime_error("Unable to create single command fence");
+  }
+
+  upload_manager = std::make_unique<UploadManager>(device, physical_device, queue, queue_index, transfer_queue, transfer_index);
+}
+
+CommandPool::~CommandPool() {
+  upload_manager.reset();
+  vkDestroyFence(device, single_fence, nullptr);
+  vkDestroyCommandPool(device, command_pool, nullptr);
 }
 
 void CommandPool::create_command_buffer(VkCommandBuffer* command_buffer, uint32_t count, VkCommandBufferLevel level) {
@@ -42,13 +61,17 @@ VkCommandBuffer CommandPool::start_single_command() {
 void CommandPool::end_single_command(VkCommandBuffer command) {
   vkEndCommandBuffer(command);
 
+  // The command may read what was uploaded before it
+  upload_manager->flush();
+
   VkSubmitInfo submit_info{};
   submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
   submit_info.commandBufferCount = 1;
   submit_info.pCommandBuffers = &command;
 
-  vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE);
-  vkQueueWaitIdle(queue);
+  vkResetFences(device, 1, &single_fence);
+  vkQueueSubmit(queue, 1, &submit_info, single_fence);
+  vkWaitForFences(device, 1, &single_fence, VK_TRUE, UINT64_MAX);
 
   vkFreeCommandBuffers(device, command_pool, 1, &command);
 }
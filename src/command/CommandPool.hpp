@@ -2,21 +2,39 @@
 
 #include <vulkan/vulkan_core.h>
 
+#include <memory>
+
+class UploadManager;
+
 class CommandPool {
 
   public:
-    CommandPool(VkDevice device, VkQueue queue, uint32_t queue_index);
+    CommandPool(
+      VkDevice device,
+      VkPhysicalDevice physical_device,
+      VkQueue queue, uint32_t queue_index,
+      VkQueue transfer_queue, uint32_t transfer_index
+    );
+    ~CommandPool();
 
     void create_command_buffer(VkCommandBuffer* command_buffer, uint32_t count, VkCommandBufferLevel level);
 
+    // Runs on the main queue after the uploads recorded so far, the host
+    // waits for it alone instead of the whole queue
     VkCommandBuffer start_single_command();
     void end_single_command(VkCommandBuffer command_buffer);
 
     void free_command_buffer(VkCommandBuffer* command_buffer);
 
+    // Buffer uploads go through here instead of a single command each
+    UploadManager& uploads() { return *upload_manager; }
+
   private:
     VkDevice device = VK_NULL_HANDLE;
     VkQueue queue = VK_NULL_HANDLE;
 
     VkCommandPool command_pool = VK_NULL_HANDLE;
+    VkFence single_fence = VK_NULL_HANDLE;
+
+    std::unique_ptr<UploadManager> upload_manager;
 };
@@ -0,0 +1,326 @@
+#include "UploadManager.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+UploadManager::UploadManager(
+  VkDevice device,
+  VkPhysicalDevice physical_device,
+  VkQueue queue,
+  uint32_t queue_family,
+  VkQueue transfer_queue,
+  uint32_t transfer_family
+) : device(device), physical_device(physical_device), queue(queue), queue_family(queue_family), transfer_queue(transfer_queue), transfer_family(transfer_family) {
+
+  VkCommandPoolCreateInfo pool_info{};
+  pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  pool_info.queueFamilyIndex = queue_family;
+
+  if (vkCreateCommandPool(device, &pool_info, nullptr, &pool) != VK_SUCCESS) {
+    throw std::runtime_error("Unable to create upload command pool");
+  }
+
+  if (dedicated_transfer()) {
+    pool_info.queueFamilyIndex = transfer_family;
+    if (vkCreateCommandPool(device, &pool_info, nullptr, &transfer_pool) != VK_SUCCESS) {
+      throw std::runtime_error("Unable to create transfer command pool");
+    }
+  }
+
+  arena = std::make_unique<HostBuffer>(device, physical_device, arena_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+  arena_data = static_cast<char*>(arena->map());
+
+  for (auto& batch : batches) {
+    VkCommandBufferAllocateInfo alloc_info{};
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.commandBufferCount = 1;
+    alloc_info.commandPool = dedicated_transfer() ? transfer_pool : pool;
+
+    if (vkAllocateCommandBuffers(device, &alloc_info, &batch.copy) != VK_SUCCESS) {
+      throw std::runtime_error("Unable to allocate upload command buffer");
+    }
+
+    if (dedicated_transfer()) {
+      alloc_info.commandPool = pool;
+      std::array<VkCommandBuffer, 2> ownership;
+      alloc_info.commandBufferCount = 2;
+      if (vkAllocateCommandBuffers(device, &alloc_info, ownership.data()) != VK_SUCCESS) {
+        throw std::runtime_error("Unable to allocate upload command buffer");
+      }
+      batch.release = ownership[0];
+      batch.acquire = ownership[1];
+
+      VkSemaphoreCreateInfo semaphore_info{};
+      semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+      if (vkCreateSemaphore(device, &semaphore_info, nullptr, &batch.released) != VK_SUCCESS ||
+          vkCreateSemaphore(device, &semaphore_info, nullptr, &batch.copied) != VK_SUCCESS) {
+        throw std::runtime_error("Unable to create upload semaphores");
+      }
+    }
+
+    VkFenceCreateInfo fence_info{};
+    fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    if (vkCreateFence(device, &fence_info, nullptr, &batch.fence) != VK_SUCCESS) {
+      throw std::runtime_error("Unable to create upload fence");
+    }
+  }
+}
+
+UploadManager::~UploadManager() {
+  // Copies never flushed are dropped, the device is going away
+  wait();
+
+  for (auto& batch : batches) {
+    vkDestroyFence(device, batch.fence, nullptr);
+    if (batch.released != VK_NULL_HANDLE) vkDestroySemaphore(device, batch.released, nullptr);
+    if (batch.copied != VK_NULL_HANDLE) vkDestroySemaphore(device, batch.copied, nullptr);
+    batch.oversized.clear();
+  }
+
+  vkDestroyCommandPool(device, pool, nullptr);
+  if (transfer_pool != VK_NULL_HANDLE) {
+    vkDestroyCommandPool(device, transfer_pool, nullptr);
+  }
+}
+
+UploadManager::Batch& UploadManager::begin() {
+  Batch& batch = batches[current];
+  if (batch.recording) {
+    return batch;
+  }
+
+  // The arena half and command buffers are only free once the last use landed
+  if (batch.submitted) {
+    vkWaitForFences(device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+    batch.submitted = false;
+  }
+  batch.copies.clear();
+  batch.oversized.clear();
+  batch.used = 0;
+  batch.recording = true;
+  return batch;
+}
+
+void UploadManager::upload(VkBuffer dst, VkDeviceSize offset, const void* data, VkDeviceSize size) {
+  std::memcpy(stage({dst}, offset, size), data, size);
+}
+
+void* UploadManager::stage(std::initializer_list<VkBuffer> targets, VkDeviceSize offset, VkDeviceSize size) {
+  if (size == 0) {
+    return arena_data;
+  }
+
+  Batch* batch = &begin();
+  VkDeviceSize half = arena_size / 2;
+
+  VkBuffer source;
+  VkDeviceSize source_offset;
+  char* data;
+
+  if (size > half) {
+    batch->oversized.push_back(std::make_unique<HostBuffer>(device, physical_device, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT));
+    source = batch->oversized.back()->buffer;
+    source_offset = 0;
+    data = static_cast<char*>(batch->oversized.back()->map());
+  } else {
+    VkDeviceSize start = (batch->used + 15) / 16 * 16;
+    if (start + size > half) {
+      flush();
+      batch = &begin();
+      start = 0;
+    }
+    batch->used = start + size;
+
+    source = arena->buffer;
+    source_offset = current * half + start;
+    data = arena_data + source_offset;
+  }
+
+  for (VkBuffer target : targets) {
+    Copy copy{};
+    copy.source = source;
+    copy.target = target;
+    copy.region.srcOffset = source_offset;
+    copy.region.dstOffset = offset;
+    copy.region.size = size;
+    batch->copies.push_back(copy);
+  }
+
+  return data;
+}
+
+void UploadManager::flush() {
+  Batch& batch = batches[current];
+  if (!batch.recording) {
+    return;
+  }
+  batch.recording = false;
+
+  if (batch.copies.empty()) {
+    return;
+  }
+
+  std::vector<VkBuffer> targets;
+  for (const auto& copy : batch.copies) targets.push_back(copy.target);
+  std::sort(targets.begin(), targets.end());
+  targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+
+  vkResetFences(device, 1, &batch.fence);
+
+  if (dedicated_transfer()) {
+    // The main queue lets go of the targets once everything before it is done with them
+    begin_commands(batch.release);
+    ownership_barriers(
+      batch.release, targets, queue_family, transfer_family,
+      VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+      VK_ACCESS_MEMORY_WRITE_BIT, 0
+    );
+    vkEndCommandBuffer(batch.release);
+    submit(queue, batch.release, VK_NULL_HANDLE, 0, batch.released, VK_NULL_HANDLE);
+  }
+
+  begin_commands(batch.copy);
+  if (dedicated_transfer()) {
+    ownership_barriers(
+      batch.copy, targets, queue_family, transfer_family,
+      VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+      0, VK_ACCESS_TRANSFER_WRITE_BIT
+    );
+  } else {
+    // Earlier submissions may still read or write the targets
+    VkMemoryBarrier reuse_barrier{};
+    reuse_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    reuse_barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+    reuse_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(
+      batch.copy,
+      VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      0,
+      1, &reuse_barrier,
+      0, nullptr,
+      0, nullptr
+    );
+  }
+
+  for (const auto& copy : batch.copies) {
+    vkCmdCopyBuffer(batch.copy, copy.source, copy.target, 1, &copy.region);
+  }
+
+  if (dedicated_transfer()) {
+    ownership_barriers(
+      batch.copy, targets, transfer_family, queue_family,
+      VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+      VK_ACCESS_TRANSFER_WRITE_BIT, 0
+    );
+    vkEndCommandBuffer(batch.copy);
+    submit(transfer_queue, batch.copy, batch.released, VK_PIPELINE_STAGE_TRANSFER_BIT, batch.copied, VK_NULL_HANDLE);
+
+    begin_commands(batch.acquire);
+    ownership_barriers(
+      batch.acquire, targets, transfer_family, queue_family,
+      VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+      0, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT
+    );
+    vkEndCommandBuffer(batch.acquire);
+    submit(queue, batch.acquire, batch.copied, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_NULL_HANDLE, batch.fence);
+  } else {
+    // Covers everything submitted to the queue after this
+    VkMemoryBarrier copy_barrier{};
+    copy_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    copy_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    copy_barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+    vkCmdPipelineBarrier(
+      batch.copy,
+      VK_PIPELINE_STAGE_TRANSFER_BIT,
+      VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+      0,
+      1, &copy_barrier,
+      0, nullptr,
+      0, nullptr
+    );
+    vkEndCommandBuffer(batch.copy);
+    submit(queue, batch.copy, VK_NULL_HANDLE, 0, VK_NULL_HANDLE, batch.fence);
+  }
+
+  batch.submitted = true;
+  current = (current + 1) % batches.size();
+}
+
+void UploadManager::wait() {
+  for (auto& batch : batches) {
+    if (batch.submitted) {
+      vkWaitForFences(device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+      batch.submitted = false;
+      batch.oversized.clear();
+    }
+  }
+}
+
+void UploadManager::ownership_barriers(
+  VkCommandBuffer commandbuffer,
+  const std::vector<VkBuffer>& targets,
+  uint32_t src_family,
+  uint32_t dst_family,
+  VkPipelineStageFlags src_stage,
+  VkPipelineStageFlags dst_stage,
+  VkAccessFlags src_access,
+  VkAccessFlags dst_access
+) {
+  std::vector<VkBufferMemoryBarrier> barriers(targets.size());
+  for (size_t i = 0; i < targets.size(); i++) {
+    barriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barriers[i].srcAccessMask = src_access;
+    barriers[i].dstAccessMask = dst_access;
+    barriers[i].srcQueueFamilyIndex = src_family;
+    barriers[i].dstQueueFamilyIndex = dst_family;
+    barriers[i].buffer = targets[i];
+    barriers[i].offset = 0;
+    barriers[i].size = VK_WHOLE_SIZE;
+  }
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    src_stage,
+    dst_stage,
+    0,
+    0, nullptr,
+    static_cast<uint32_t>(barriers.size()), barriers.data(),
+    0, nullptr
+  );
+}
+
+void UploadManager::begin_commands(VkCommandBuffer commandbuffer) {
+  VkCommandBufferBeginInfo begin_info{};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  if (vkBeginCommandBuffer(commandbuffer, &begin_info) != VK_SUCCESS) {
+    throw std::runtime_error("Unable to begin upload command buffer");
+  }
+}
+
+void UploadManager::submit(VkQueue target, VkCommandBuffer commandbuffer, VkSemaphore wait, VkPipelineStageFlags wait_stage, VkSemaphore signal, VkFence fence) {
+  VkSubmitInfo submit_info{};
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &commandbuffer;
+  if (wait != VK_NULL_HANDLE) {
+    submit_info.waitSemaphoreCount = 1;
+    submit_info.pWaitSemaphores = &wait;
+    submit_info.pWaitDstStageMask = &wait_stage;
+  }
+  if (signal != VK_NULL_HANDLE) {
+    submit_info.signalSemaphoreCount = 1;
+    submit_info.pSignalSemaphores = &signal;
+  }
+
+  if (vkQueueSubmit(target, 1, &submit_info, fence) != VK_SUCCESS) {
+    throw std::runtime_error("Unable to submit uploads");
+  }
+}
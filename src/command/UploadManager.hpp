@@ -0,0 +1,101 @@
+#pragma once
+
+#include "../buffer/HostBuffer.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <array>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+class UploadManager {
+
+  public:
+    // Batches host to device copies. Data is staged in a mapped arena and the
+    // copies are recorded into one command buffer until flush submits them
+    // behind a fence, without waiting. Work submitted to the main queue after
+    // a flush sees the data. Two batches alternate, so one can record while
+    // the other is still copying. The arena half of a batch is reused once
+    // its fence signals. Uploads too large for it get staging of their own,
+    // freed along with the batch.
+    //
+    // With a dedicated transfer queue the copies run there. The main queue
+    // releases the targets first and acquires them again after the copies.
+    // A rewrite of a buffer that earlier frames still read waits for them on
+    // the device, not on the host.
+    UploadManager(
+      VkDevice device,
+      VkPhysicalDevice physical_device,
+      VkQueue queue, uint32_t queue_family,
+      VkQueue transfer_queue, uint32_t transfer_family
+    );
+    ~UploadManager();
+
+    // Copies size bytes of data into dst at offset
+    void upload(VkBuffer dst, VkDeviceSize offset, const void* data, VkDeviceSize size);
+    // Staging for size bytes that lands in every target at offset. Fill it
+    // before the next upload or flush.
+    void* stage(std::initializer_list<VkBuffer> targets, VkDeviceSize offset, VkDeviceSize size);
+
+    // Submits what was recorded so far
+    void flush();
+    // Blocks until every flushed batch has landed
+    void wait();
+
+    bool dedicated_transfer() const { return transfer_family != queue_family; }
+
+    // Bytes of mapped staging, split between the two batches
+    inline static VkDeviceSize arena_size = VkDeviceSize(64) << 20;
+
+  private:
+    struct Copy {
+      VkBuffer source;
+      VkBuffer target;
+      VkBufferCopy region;
+    };
+
+    // Copies are kept until flush, the transfer queue has to acquire the
+    // targets before the first one runs
+    struct Batch {
+      VkCommandBuffer release = VK_NULL_HANDLE;
+      VkCommandBuffer copy = VK_NULL_HANDLE;
+      VkCommandBuffer acquire = VK_NULL_HANDLE;
+      VkSemaphore released = VK_NULL_HANDLE;
+      VkSemaphore copied = VK_NULL_HANDLE;
+      VkFence fence = VK_NULL_HANDLE;
+
+      bool recording = false;
+      bool submitted = false;
+      VkDeviceSize used = 0;
+      std::vector<Copy> copies;
+      std::vector<std::unique_ptr<HostBuffer>> oversized;
+    };
+
+    Batch& begin();
+    // Queue family ownership barriers for every target, from one family to the other
+    void ownership_barriers(
+      VkCommandBuffer commandbuffer, const std::vector<VkBuffer>& targets,
+      uint32_t src_family, uint32_t dst_family,
+      VkPipelineStageFlags src_stage, VkPipelineStageFlags dst_stage,
+      VkAccessFlags src_access, VkAccessFlags dst_access
+    );
+    void begin_commands(VkCommandBuffer commandbuffer);
+    void submit(VkQueue target, VkCommandBuffer commandbuffer, VkSemaphore wait, VkPipelineStageFlags wait_stage, VkSemaphore signal, VkFence fence);
+
+    VkDevice device;
+    VkPhysicalDevice physical_device;
+    VkQueue queue;
+    uint32_t queue_family;
+    VkQueue transfer_queue;
+    uint32_t transfer_family;
+
+    VkCommandPool pool = VK_NULL_HANDLE;
+    VkCommandPool transfer_pool = VK_NULL_HANDLE;
+
+    std::unique_ptr<HostBuffer> arena;
+    char* arena_data = nullptr;
+
+    std::array<Batch, 2> batches;
+    uint32_t current = 0;
+};
@@ -1,5 +1,7 @@
 
 #include "VulkanContext.hpp"
+#include "../buffer/MemoryAllocator.hpp"
+#include "../pipeline/PipelineCache.hpp"
 
 #include <iostream>
 #include <cstring>
@@ -17,7 +19,15 @@ void VulkanContext::reset() {
     DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
   }
 
-  vkDestroySurfaceKHR(instance, surface, nullptr);
+  if (surface != VK_NULL_HANDLE) {
+    vkDestroySurfaceKHR(instance, surface, nullptr);
+    surface = VK_NULL_HANDLE;
+  }
+  // Its staging arena lives in the allocator's blocks
+  commandpool.reset();
+  PipelineCache::close(device);
+  // Blocks still held, like the depth image's, go with the device
+  MemoryAllocator::release(device);
   vkDestroyDevice(device, nullptr);
   vkDestroyInstance(instance, nullptr);
 }
@@ -35,7 +45,7 @@ void VulkanContext::init(Window& window) {
 
     init_device();
 
-    commandpool = std::make_unique<CommandPool>(device, queue, queue_index.index.value()); 
+    commandpool = std::make_unique<CommandPool>(device, physical_device, queue, queue_index.index.value(), transfer_queue, transfer_family());
 
   } else {
     reset();
@@ -44,6 +54,32 @@ void VulkanContext::init(Window& window) {
   }
 }
 
+void VulkanContext::init_headless() {
+  if (!active) {
+    active = true;
+    headless = true;
+
+    // GPU-less servers rarely ship the SDK layers, run without them there
+    if (enabledValidationLayers && !check_validation_support()) {
+      std::cerr << "Validation layer unavailable, continuing without it" << '\n';
+      enabledValidationLayers = false;
+    }
+
+    init_vulkan();
+    init_debugger();
+    pick_physical_device();
+
+    init_device();
+
+    commandpool = std::make_unique<CommandPool>(device, physical_device, queue, queue_index.index.value(), transfer_queue, transfer_family());
+
+  } else {
+    reset();
+    active = false;
+    init_headless();
+  }
+}
+
 void VulkanContext::init_vulkan() {
   if (enabledValidationLayers && !check_validation_support()) {
     throw std::runtime_error("Validation layer requested, but unavailable");
@@ -165,13 +201,35 @@ void VulkanContext::pick_physical_device() {
 
   std::vector<VkPhysicalDevice> devices(device_count);
   vkEnumeratePhysicalDevices(instance, &device_count, devices.data());
+
+  int best_score = -1;
   for (auto& device : devices) {
-    if (is_device_suitable(device)) {
+    if (!is_device_suitable(device)) continue;
+
+    int score = score_device(device);
+    if (score > best_score) {
+      best_score = score;
       physical_device = device;
       queue_index = find_queue_family(device);
-      break;
     }
   }
+
+  if (physical_device == VK_NULL_HANDLE) {
+    throw std::runtime_error(headless ? "No device with a compute queue" : "No suitable GPU found");
+  }
+}
+
+int VulkanContext::score_device(VkPhysicalDevice device) const {
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(device, &properties);
+
+  switch (properties.deviceType) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return 4;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return 3;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return 2;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU: return 1;
+    default: return 0;
+  }
 }
 
 bool VulkanContext::is_device_suitable(VkPhysicalDevice device) {
@@ -183,8 +241,12 @@ bool VulkanContext::is_device_suitable(VkPhysicalDevice device) {
   QueueIndices indices = find_queue_family(device);
   bool extension_supported = check_extension_support(device);
 
+  if (headless) {
+    return indices.is_complete() && extension_supported;
+  }
+
+  // Non discrete GPUs are still accepted, score_device ranks them lower
   bool condition = 
-    properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU && 
     features.fillModeNonSolid &&
     features.samplerAnisotropy &&
     features.vertexPipelineStoresAndAtomics &&
@@ -204,6 +266,19 @@ QueueIndices VulkanContext::find_queue_family(VkPhysicalDevice device) {
   QueueIndices queue;
 
   for (const auto& family : queue_families) {
+
+    bool transfer_only = (family.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(family.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT));
+    if (transfer_only && !queue.transfer.has_value()) {
+      queue.transfer = index;
+    }
+
+    if (headless) {
+      if ((family.queueFlags & VK_QUEUE_COMPUTE_BIT) && !queue.is_complete()) {
+        queue.index = index;
+      }
+      index++;
+      continue;
+    }
     
     if ((family.queueFlags & VK_QUEUE_GRAPHICS_BIT) && (family.queueFlags & VK_QUEUE_COMPUTE_BIT)) {
       VkBool32 present = false;
@@ -224,7 +299,8 @@ bool VulkanContext::check_extension_support(VkPhysicalDevice device) const {
   std::vector<VkExtensionProperties> extension_properties(extension_count);
   vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, extension_properties.data());
 
-  std::set<std::string> requiredExtensions(device_extensions.begin(), device_extensions.end()); 
+  std::vector<const char*> required = get_device_extensions();
+  std::set<std::string> requiredExtensions(required.begin(), required.end()); 
   for (const auto& extension : extension_properties) {
     requiredExtensions.erase(extension.extensionName);
   }
@@ -232,6 +308,20 @@ bool VulkanContext::check_extension_support(VkPhysicalDevice device) const {
   return requiredExtensions.empty();
 }
 
+bool VulkanContext::has_extension(VkPhysicalDevice device, const char* name) const {
+  uint32_t extension_count;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, nullptr);
+  std::vector<VkExtensionProperties> extension_properties(extension_count);
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, extension_properties.data());
+
+  for (const auto& extension : extension_properties) {
+    if (std::strcmp(extension.extensionName, name) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
 void VulkanContext::init_device() {
   float priority = 1.0f;
 
@@ -241,22 +331,39 @@ void VulkanContext::init_device() {
   queue_info.queueCount = 1;
   queue_info.queueFamilyIndex = queue_index.index.value();
 
+  std::vector<VkDeviceQueueCreateInfo> queue_infos{queue_info};
+  if (queue_index.transfer.has_value()) {
+    queue_info.queueFamilyIndex = queue_index.transfer.value();
+    queue_infos.push_back(queue_info);
+  }
+
+  // The compute passes need no optional features, only drawing does
   VkPhysicalDeviceFeatures features{};
-  features.samplerAnisotropy = VK_TRUE;
-  features.vertexPipelineStoresAndAtomics = VK_TRUE;
+  if (!headless) {
+    features.samplerAnisotropy = VK_TRUE;
+    features.vertexPipelineStoresAndAtomics = VK_TRUE;
+  }
 
   VkDeviceCreateInfo device_info{};
   device_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-  device_info.queueCreateInfoCount = 1;
+  device_info.queueCreateInfoCount = static_cast<uint32_t>(queue_infos.size());
   device_info.pEnabledFeatures = &features;
-  device_info.pQueueCreateInfos = &queue_info;
+  device_info.pQueueCreateInfos = queue_infos.data();
+
 
 
+  std::vector<const char*> extensions = get_device_extensions();
+  calibrated_timestamps = has_extension(physical_device, VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+  if (calibrated_timestamps) {
+    extensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+  }
 
-  device_info.enabledExtensionCount = static_cast<uint32_t>(device_extensions.size());
-  device_info.ppEnabledExtensionNames = device_extensions.data();
-  device_info.enabledLayerCount = static_cast<uint32_t>(layers.size());
-  device_info.ppEnabledLayerNames = layers.data();
+  device_info.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+  device_info.ppEnabledExtensionNames = extensions.data();
+  if (enabledValidationLayers) {
+    device_info.enabledLayerCount = static_cast<uint32_t>(layers.size());
+    device_info.ppEnabledLayerNames = layers.data();
+  }
 
 
   if (vkCreateDevice(physical_device, &device_info, nullptr, &device) != VK_SUCCESS) {
@@ -264,18 +371,39 @@ void VulkanContext::init_device() {
   }
 
   vkGetDeviceQueue(device, queue_index.index.value(), 0, &queue);
+  transfer_queue = queue;
+  if (queue_index.transfer.has_value()) {
+    vkGetDeviceQueue(device, queue_index.transfer.value(), 0, &transfer_queue);
+  }
+
+  PipelineCache::open(device, physical_device);
 }
 
 
 std::vector<const char*> VulkanContext::get_required_extensions() const {
-  uint32_t extension_count;
-  const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&extension_count); 
-  std::vector<const char*> extensions(glfwExtensions, glfwExtensions + extension_count);
-  extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+  std::vector<const char*> extensions;
+
+  // Headless never touches GLFW, so it can run where no display exists
+  if (!headless) {
+    uint32_t extension_count;
+    const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&extension_count); 
+    extensions.assign(glfwExtensions, glfwExtensions + extension_count);
+  }
+
+  if (enabledValidationLayers) {
+    extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+  }
 
   return extensions;
 }
 
+std::vector<const char*> VulkanContext::get_device_extensions() const {
+  if (headless) {
+    return {};
+  }
+  return device_extensions;
+}
+
 VkPhysicalDeviceLimits VulkanContext::find_device_limit() {
   VkPhysicalDeviceProperties properties;
   vkGetPhysicalDeviceProperties(physical_device, &properties);
@@ -10,6 +10,8 @@
 
 struct QueueIndices {
   std::optional<uint32_t> index;
+  // A family that only copies, uploads run there when the device has one
+  std::optional<uint32_t> transfer;
 
   bool is_complete() {
     return index.has_value();
@@ -22,7 +24,15 @@ class VulkanContext {
     ~VulkanContext();
 
     void init(Window& window);
+    // Compute only, no surface extensions or swapchain. Takes any device with a
+    // compute queue, lavapipe included, and prefers real GPUs by score.
+    void init_headless();
     CommandPool& get_commandpool() { return *commandpool; }
+    VkInstance get_instance() const { return instance; }
+    // VK_EXT_debug_utils is only enabled along with the validation layers
+    bool debug_utils_enabled() const { return enabledValidationLayers; }
+    // Optional, lets the trace put GPU timestamps on the host clock
+    bool calibrated_timestamps_enabled() const { return calibrated_timestamps; }
     VkPhysicalDeviceLimits find_device_limit();
 
     VkDevice device = VK_NULL_HANDLE;
@@ -31,9 +41,13 @@ class VulkanContext {
 
     QueueIndices queue_index;
     VkQueue queue = VK_NULL_HANDLE;
+    // The main queue again without a dedicated transfer family
+    VkQueue transfer_queue = VK_NULL_HANDLE;
+    uint32_t transfer_family() const { return queue_index.transfer.value_or(queue_index.index.value()); }
 
 
     bool active = false;
+    bool headless = false;
 
   private:
     void init_vulkan();
@@ -43,6 +57,7 @@ class VulkanContext {
 
     void pick_physical_device();
     bool is_device_suitable(VkPhysicalDevice device);
+    int score_device(VkPhysicalDevice device) const;
 
     QueueIndices find_queue_family(VkPhysicalDevice device);
 
@@ -52,8 +67,10 @@ class VulkanContext {
 
     bool check_validation_support() const;
     bool check_extension_support(VkPhysicalDevice device) const;
+    bool has_extension(VkPhysicalDevice device, const char* name) const;
     
     std::vector<const char*> get_required_extensions() const;
+    std::vector<const char*> get_device_extensions() const;
 
     VkResult CreateDebugUtilsMessengerEXT(
       VkInstance instance, 
@@ -79,6 +96,7 @@ class VulkanContext {
 
     bool enabledValidationLayers = true;
     VkDebugUtilsMessengerEXT debugMessenger = VK_NULL_HANDLE;
+    bool calibrated_timestamps = false;
     const std::vector<const char*> layers { "VK_LAYER_KHRONOS_validation" };
     const std::vector<const char*> device_extensions { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 
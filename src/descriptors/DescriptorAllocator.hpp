@@ -11,7 +11,10 @@ class DescriptorAllocator {
     struct PoolSizes {
       std::vector<std::pair<VkDescriptorType, float>> sizes = {
         {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f},
-        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f}
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0.5f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 0.5f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0.5f}
       };
     };
   
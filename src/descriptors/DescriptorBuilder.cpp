@@ -34,6 +34,29 @@ DescriptorBuilder& DescriptorBuilder::DescriptorBuilder::bind_buffer(uint32_t bi
 		return *this;
 }
 
+DescriptorBuilder& DescriptorBuilder::bind_image(uint32_t binding, VkShaderStageFlags stageFlags,VkDescriptorType type, const VkDescriptorImageInfo* image_info) {
+		VkDescriptorSetLayoutBinding new_binding{};
+		new_binding.descriptorCount = 1;
+		new_binding.descriptorType = type;
+		new_binding.pImmutableSamplers = nullptr;
+		new_binding.stageFlags = stageFlags;
+		new_binding.binding = binding;
+
+		bindings.push_back(new_binding);
+
+		VkWriteDescriptorSet new_write{};
+		new_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		new_write.pNext = nullptr;
+
+		new_write.descriptorCount = 1;
+		new_write.descriptorType = type;
+		new_write.pImageInfo = image_info;
+		new_write.dstBinding = binding;
+
+		writes.push_back(new_write);
+		return *this;
+}
+
 bool DescriptorBuilder::build(VkDescriptorSet& set, VkDescriptorSetLayout& layout){
 	VkDescriptorSetLayoutCreateInfo layout_info{};
 	layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -54,6 +77,14 @@ bool DescriptorBuilder::build(VkDescriptorSet& set, VkDescriptorSetLayout& layou
 	return true;
 }
 
+void DescriptorBuilder::update(VkDescriptorSet set) {
+	for (VkWriteDescriptorSet& w : writes) {
+		w.dstSet = set;
+	}
+
+	vkUpdateDescriptorSets(alloc->device, writes.size(), writes.data(), 0, nullptr);
+}
+
 void DescriptorBuilder::clear() {
   bindings.clear();
   writes.clear();
@@ -11,9 +11,13 @@ class DescriptorBuilder {
     static DescriptorBuilder begin(DescriptorLayoutCache* cache, DescriptorAllocator* allocator );
 
     DescriptorBuilder& bind_buffer(uint32_t binding, VkShaderStageFlags stageFlags,VkDescriptorType type, const VkDescriptorBufferInfo* buffer_info);
+    DescriptorBuilder& bind_image(uint32_t binding, VkShaderStageFlags stageFlags,VkDescriptorType type, const VkDescriptorImageInfo* image_info);
 
     bool build(VkDescriptorSet& set, VkDescriptorSetLayout& layout);
     bool build(VkDescriptorSet& set); 
+    // Points the bound bindings of an existing set at new resources, the set
+    // must not be in use by the device
+    void update(VkDescriptorSet set);
 
     void clear();
 
@@ -35,16 +35,9 @@ Image::Image(
   VkMemoryRequirements mem_requirements; 
   vkGetImageMemoryRequirements(device, image, &mem_requirements);
 
-  VkMemoryAllocateInfo allocInfo{};
-  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  allocInfo.allocationSize = mem_requirements.size;
-  allocInfo.memoryTypeIndex = find_memory_type(mem_requirements.memoryTypeBits, property);
+  allocation = MemoryAllocator::get(device, physical_device).allocate(mem_requirements, property, MemoryCategory::image);
 
-  if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
-    throw std::runtime_error("Unable to allocate device memory");
-  }
-
-  vkBindImageMemory(device, image, memory, 0);
+  vkBindImageMemory(device, image, allocation.memory, allocation.offset);
 
   VkImageViewCreateInfo image_view_info{};
   image_view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -62,19 +55,6 @@ Image::Image(
   }
 }
 
-uint32_t Image::find_memory_type(uint32_t filter, VkMemoryPropertyFlags properties) {
-  VkPhysicalDeviceMemoryProperties mem_properties;
-  vkGetPhysicalDeviceMemoryProperties(physical_device, &mem_properties);
-
-  for (uint32_t i = 0; i < mem_properties.memoryTypeCount; ++i) {
-    if ((filter & (1 << i)) && (mem_properties.memoryTypes[i].propertyFlags & properties) == properties) {
-      return i;
-    }
-  }
-
-  throw std::runtime_error("failed to find suitable memory type!");
-}
-
 void Image::transition_image_layout(CommandPool& command_pool, VkImageLayout old_layout, VkImageLayout new_layout) {
   VkCommandBuffer command = command_pool.start_single_command();
 
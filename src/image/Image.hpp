@@ -21,14 +21,11 @@ class Image {
 
       VkImageView view;
   private:
-    uint32_t find_memory_type(uint32_t filter, VkMemoryPropertyFlags properties);
-
-
     VkDevice device;
     VkPhysicalDevice physical_device;
 
     VkImage image;
-    VkDeviceMemory memory;
+    MemoryAllocation allocation;
     uint32_t width;
     uint32_t height;
     VkFormat format;
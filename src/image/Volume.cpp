@@ -0,0 +1,85 @@
+
+#include "Volume.hpp"
+
+#include <stdexcept>
+
+Volume::Volume(
+  VkDevice device,
+  VkPhysicalDevice physical_device,
+  uint32_t width,
+  uint32_t height,
+  uint32_t depth,
+  VkFormat format,
+  VkImageUsageFlags usage
+) : width(width), height(height), depth(depth), device(device), physical_device(physical_device), format(format) {
+
+  VkImageCreateInfo image_info{};
+  image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  image_info.imageType = VK_IMAGE_TYPE_3D;
+  image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  image_info.format = format;
+  image_info.extent.width = width;
+  image_info.extent.height = height;
+  image_info.extent.depth = depth;
+  image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  image_info.mipLevels = 1;
+  image_info.arrayLayers = 1;
+  image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+  image_info.usage = usage;
+  image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+
+  if (vkCreateImage(device, &image_info, nullptr, &image) != VK_SUCCESS) {
+    throw std::runtime_error("Unable to create volume image");
+  }
+
+  VkMemoryRequirements mem_requirements;
+  vkGetImageMemoryRequirements(device, image, &mem_requirements);
+
+  allocation = MemoryAllocator::get(device, physical_device).allocate(mem_requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryCategory::image);
+
+  vkBindImageMemory(device, image, allocation.memory, allocation.offset);
+
+  VkImageViewCreateInfo view_info{};
+  view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  view_info.viewType = VK_IMAGE_VIEW_TYPE_3D;
+  view_info.image = image;
+  view_info.format = format;
+  view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  view_info.subresourceRange.baseMipLevel = 0;
+  view_info.subresourceRange.levelCount = 1;
+  view_info.subresourceRange.baseArrayLayer = 0;
+  view_info.subresourceRange.layerCount = 1;
+
+  if (vkCreateImageView(device, &view_info, nullptr, &view) != VK_SUCCESS) {
+    throw std::runtime_error("Unable to create volume view");
+  }
+
+  VkSamplerCreateInfo sampler_info{};
+  sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  sampler_info.magFilter = VK_FILTER_LINEAR;
+  sampler_info.minFilter = VK_FILTER_LINEAR;
+  sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  sampler_info.maxLod = 0.0f;
+
+  if (vkCreateSampler(device, &sampler_info, nullptr, &sampler) != VK_SUCCESS) {
+    throw std::runtime_error("Unable to create volume sampler");
+  }
+
+  sampled_info.sampler = sampler;
+  sampled_info.imageView = view;
+  sampled_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  storage_info.sampler = VK_NULL_HANDLE;
+  storage_info.imageView = view;
+  storage_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+}
+
+Volume::~Volume() {
+  vkDestroySampler(device, sampler, nullptr);
+  vkDestroyImageView(device, view, nullptr);
+  vkDestroyImage(device, image, nullptr);
+  MemoryAllocator::free(device, allocation);
+}
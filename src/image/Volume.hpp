@@ -0,0 +1,45 @@
+#pragma once
+
+#include "../buffer/Buffer.hpp"
+
+// 3D image sampled with trilinear filtering, written through imageStore
+class Volume {
+
+  public:
+    Volume(
+      VkDevice device,
+      VkPhysicalDevice physical_device,
+      uint32_t width, uint32_t height, uint32_t depth,
+      VkFormat format,
+      VkImageUsageFlags usage
+    );
+    ~Volume();
+
+    void transition_layout(
+      VkCommandBuffer commandbuffer,
+      VkImageLayout old_layout, VkImageLayout new_layout,
+      VkAccessFlags src_access, VkAccessFlags dst_access,
+      VkPipelineStageFlags src_stage, VkPipelineStageFlags dst_stage
+    );
+
+    const VkDescriptorImageInfo* get_sampled_info() { return &sampled_info; };
+    const VkDescriptorImageInfo* get_storage_info() { return &storage_info; };
+
+    VkImage image = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;
+    VkSampler sampler = VK_NULL_HANDLE;
+
+    uint32_t width;
+    uint32_t height;
+    uint32_t depth;
+
+  private:
+    VkDevice device;
+    VkPhysicalDevice physical_device;
+
+    MemoryAllocation allocation;
+    VkFormat format;
+
+    VkDescriptorImageInfo sampled_info{};
+    VkDescriptorImageInfo storage_info{};
+};
@@ -1,7 +1,27 @@
 
 #include "Engine.hpp"
+#include "HeadlessRunner.hpp"
+#include "Options.hpp"
 
-int main() {
+#include <iostream>
+#include <stdexcept>
+
+int main(int argc, char** argv) {
+
+  Options options;
+  try {
+    options = Options::parse(argc, argv);
+    options.apply();
+  } catch (const std::runtime_error& error) {
+    std::cerr << error.what() << '\n';
+    return 1;
+  }
+
+  if (options.headless) {
+    HeadlessRunner runner;
+    runner.run(options.steps);
+    return 0;
+  }
 
   Engine engine;
   engine.run();
@@ -1,6 +1,8 @@
 
 #include "ComputePipeline.hpp"
 #include "Shader.hpp"
+#include "PipelineCache.hpp"
+#include "PipelineCompiler.hpp"
 
 #include <stdexcept>
 #include <iostream>
@@ -8,6 +10,8 @@
 ComputePipeline::ComputePipeline(VkDevice device, std::string compute) : Pipeline(device), compute_shader_path(compute) {}
 
 ComputePipeline::~ComputePipeline() {
+  PipelineCompiler::forget(this);
+
   if (pipeline != VK_NULL_HANDLE) {
     vkDestroyPipeline(device, pipeline, nullptr);
   }
@@ -18,7 +22,7 @@ ComputePipeline::~ComputePipeline() {
 }
 
 
-void ComputePipeline::create(std::vector<VkDescriptorSetLayout>&& descriptor_set_layouts, std::vector<VkPushConstantRange>&& push_constants) {
+void ComputePipeline::create(std::vector<VkDescriptorSetLayout>&& descriptor_set_layouts, std::vector<VkPushConstantRange>&& push_constants, const VkSpecializationInfo* specialization) {
   VkPipelineLayoutCreateInfo layout_info{};
   layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
   layout_info.setLayoutCount = static_cast<uint32_t>(descriptor_set_layouts.size());
@@ -30,21 +34,44 @@ void ComputePipeline::create(std::vector<VkDescriptorSetLayout>&& descriptor_set
     throw std::runtime_error("Unable to create pipline layout");
   }
 
-  Shader shader(device, compute_shader_path, VK_SHADER_STAGE_COMPUTE_BIT);
+  // The build runs later, after the caller's constants may be gone
+  bool specialized = specialization != nullptr;
+  std::vector<VkSpecializationMapEntry> entries;
+  std::vector<char> data;
+  if (specialized) {
+    entries.assign(specialization->pMapEntries, specialization->pMapEntries + specialization->mapEntryCount);
+    const char* values = static_cast<const char*>(specialization->pData);
+    data.assign(values, values + specialization->dataSize);
+  }
 
-  VkComputePipelineCreateInfo pipeline_info{};
-  pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-  pipeline_info.stage = shader.getShaderInfo();
-  pipeline_info.layout = layout;
-  pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
-  pipeline_info.basePipelineIndex = 0;
+  PipelineCompiler::queue(this, [this, specialized, entries, data]() {
+    Shader shader(device, compute_shader_path, VK_SHADER_STAGE_COMPUTE_BIT);
 
-  if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &pipeline) != VK_SUCCESS) {
-    throw std::runtime_error("Unable to create pipeline");
-  }
+    VkSpecializationInfo specialization_info{};
+    specialization_info.mapEntryCount = static_cast<uint32_t>(entries.size());
+    specialization_info.pMapEntries = entries.data();
+    specialization_info.dataSize = data.size();
+    specialization_info.pData = data.data();
+
+    VkComputePipelineCreateInfo pipeline_info{};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_info.stage = shader.getShaderInfo();
+    pipeline_info.stage.pSpecializationInfo = specialized ? &specialization_info : nullptr;
+    pipeline_info.layout = layout;
+    pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+    pipeline_info.basePipelineIndex = 0;
+
+    if (vkCreateComputePipelines(device, PipelineCache::get(device), 1, &pipeline_info, nullptr, &pipeline) != VK_SUCCESS) {
+      throw std::runtime_error("Unable to create pipeline " + compute_shader_path);
+    }
+  });
 }
 
 void ComputePipeline::bind_pipeline(VkCommandBuffer commandbuffer) {
+  // Bound before the scene finished, build it along with everything queued
+  if (pipeline == VK_NULL_HANDLE) {
+    PipelineCompiler::compile();
+  }
   vkCmdBindPipeline(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
 }
 
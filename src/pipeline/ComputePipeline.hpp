@@ -11,7 +11,8 @@ class ComputePipeline : public Pipeline {
     ComputePipeline(VkDevice device, std::string compute);
     ~ComputePipeline();
 
-    void create(std::vector<VkDescriptorSetLayout>&& descriptor_set_layout = {}, std::vector<VkPushConstantRange>&& push_constants = {});
+    // specialization picks a variant of the shader, its constants fold away at pipeline creation
+    void create(std::vector<VkDescriptorSetLayout>&& descriptor_set_layout = {}, std::vector<VkPushConstantRange>&& push_constants = {}, const VkSpecializationInfo* specialization = nullptr);
     void bind_pipeline(VkCommandBuffer command_buffer) override;
 
   private:
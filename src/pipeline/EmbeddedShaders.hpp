@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// SPIR-V compiled into the binary. The table is generated at build time by
+// cmake/EmbedShaders.cmake from every shader under shaders/, keyed by the
+// path the pipelines ask for, and ends with a null path.
+struct EmbeddedShader {
+  const char* path;
+  const uint32_t* code;
+  size_t size;
+};
+
+extern const EmbeddedShader EMBEDDED_SHADERS[];
@@ -3,6 +3,7 @@
 
 #include "../resource/Vertex.hpp"
 #include "Shader.hpp"
+#include "PipelineCache.hpp"
 
 #include <stdexcept>
 #include <vulkan/vulkan_core.h>
@@ -134,7 +135,7 @@ void GraphicsPipeline::create(VkRenderPass renderpass, std::vector<VkDescriptorS
   pipelineInfo.renderPass = renderpass;
   pipelineInfo.subpass = 0;
 
-  if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+  if (vkCreateGraphicsPipelines(device, PipelineCache::get(device), 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
     throw std::runtime_error("Unable to create graphpics pipeline");
   }
 }
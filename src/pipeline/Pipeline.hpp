@@ -16,6 +16,10 @@ class Pipeline {
     void bind_descriptor_sets(VkCommandBuffer commandbuffer, VkPipelineBindPoint bindpoint, uint32_t set_binding, uint32_t descriptor_count, const VkDescriptorSet* descriptor_sets) {
       vkCmdBindDescriptorSets(commandbuffer, bindpoint, layout, set_binding, descriptor_count, descriptor_sets, 0, nullptr);
     }
+    // One offset per dynamic descriptor in the sets, in set and binding order
+    void bind_descriptor_sets(VkCommandBuffer commandbuffer, VkPipelineBindPoint bindpoint, uint32_t set_binding, uint32_t descriptor_count, const VkDescriptorSet* descriptor_sets, uint32_t offset_count, const uint32_t* offsets) {
+      vkCmdBindDescriptorSets(commandbuffer, bindpoint, layout, set_binding, descriptor_count, descriptor_sets, offset_count, offsets);
+    }
 
   protected:
     VkDevice device;
@@ -0,0 +1,170 @@
+#include "PipelineCache.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+// Written ahead of the driver's data. The driver checks its own header too,
+// but not the driver version, and a stale cache only costs a cold start.
+struct PipelineCacheHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t vendor_id;
+  uint32_t device_id;
+  uint32_t driver_version;
+  uint8_t uuid[VK_UUID_SIZE];
+  uint64_t data_size;
+  uint64_t checksum;
+};
+
+struct CacheEntry {
+  VkPipelineCache cache = VK_NULL_HANDLE;
+  PipelineCacheHeader header{};
+  // Checksum of what was loaded, an unchanged cache is not written again
+  uint64_t loaded_checksum = 0;
+};
+
+static constexpr uint32_t CACHE_VERSION = 1;
+
+static std::mutex registry_mutex;
+static std::map<VkDevice, CacheEntry> registry;
+
+// FNV-1a, enough to catch a truncated or overwritten file
+static uint64_t checksum(const std::vector<char>& data) {
+  uint64_t hash = 14695981039346656037ull;
+  for (char byte : data) {
+    hash = (hash ^ static_cast<uint8_t>(byte)) * 1099511628211ull;
+  }
+  return hash;
+}
+
+static bool matches(const PipelineCacheHeader& loaded, const PipelineCacheHeader& expected) {
+  return std::memcmp(loaded.magic, expected.magic, 4) == 0 &&
+    loaded.version == expected.version &&
+    loaded.vendor_id == expected.vendor_id &&
+    loaded.device_id == expected.device_id &&
+    loaded.driver_version == expected.driver_version &&
+    std::memcmp(loaded.uuid, expected.uuid, VK_UUID_SIZE) == 0;
+}
+
+// Empty unless the file belongs to this device and driver and is intact
+static std::vector<char> load(const std::string& path, const PipelineCacheHeader& expected) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) {
+    return {};
+  }
+
+  PipelineCacheHeader loaded{};
+  if (!file.read(reinterpret_cast<char*>(&loaded), sizeof(loaded)) || !matches(loaded, expected)) {
+    return {};
+  }
+
+  std::vector<char> data(loaded.data_size);
+  if (!file.read(data.data(), data.size()) || checksum(data) != loaded.checksum) {
+    return {};
+  }
+  return data;
+}
+
+void PipelineCache::open(VkDevice device, VkPhysicalDevice physical_device) {
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+  CacheEntry entry;
+  std::memcpy(entry.header.magic, "FSPC", 4);
+  entry.header.version = CACHE_VERSION;
+  entry.header.vendor_id = properties.vendorID;
+  entry.header.device_id = properties.deviceID;
+  entry.header.driver_version = properties.driverVersion;
+  std::memcpy(entry.header.uuid, properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+  std::vector<char> data;
+  if (!path.empty()) {
+    data = load(path, entry.header);
+  }
+
+  VkPipelineCacheCreateInfo cache_info{};
+  cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cache_info.initialDataSize = data.size();
+  cache_info.pInitialData = data.empty() ? nullptr : data.data();
+
+  if (vkCreatePipelineCache(device, &cache_info, nullptr, &entry.cache) != VK_SUCCESS) {
+    // Drivers may still refuse data that passed the header, start empty
+    cache_info.initialDataSize = 0;
+    cache_info.pInitialData = nullptr;
+    data.clear();
+    if (vkCreatePipelineCache(device, &cache_info, nullptr, &entry.cache) != VK_SUCCESS) {
+      throw std::runtime_error("Unable to create pipeline cache");
+    }
+  }
+  entry.loaded_checksum = data.empty() ? 0 : checksum(data);
+
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  registry[device] = entry;
+}
+
+void PipelineCache::close(VkDevice device) {
+  CacheEntry entry;
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    auto found = registry.find(device);
+    if (found == registry.end()) {
+      return;
+    }
+    entry = found->second;
+    registry.erase(found);
+  }
+
+  size_t size = 0;
+  std::vector<char> data;
+  if (!path.empty() && vkGetPipelineCacheData(device, entry.cache, &size, nullptr) == VK_SUCCESS && size > 0) {
+    data.resize(size);
+    if (vkGetPipelineCacheData(device, entry.cache, &size, data.data()) != VK_SUCCESS) {
+      data.clear();
+    }
+    data.resize(size);
+  }
+  vkDestroyPipelineCache(device, entry.cache, nullptr);
+
+  if (data.empty()) {
+    return;
+  }
+  entry.header.data_size = data.size();
+  entry.header.checksum = checksum(data);
+  if (entry.header.checksum == entry.loaded_checksum) {
+    return;
+  }
+
+  // Many short runs may share one path, each writes its own temporary and
+  // renames it over the cache, so a reader never sees half a file
+  std::string temporary = path + "." + std::to_string(std::random_device{}()) + ".tmp";
+  {
+    std::ofstream file(temporary, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&entry.header), sizeof(entry.header));
+    file.write(data.data(), data.size());
+    if (!file) {
+      // Only startup time is lost, the run itself went fine
+      std::error_code ignored;
+      file.close();
+      std::filesystem::remove(temporary, ignored);
+      return;
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(temporary, path, error);
+  if (error) {
+    std::filesystem::remove(temporary, error);
+  }
+}
+
+VkPipelineCache PipelineCache::get(VkDevice device) {
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  auto found = registry.find(device);
+  return found == registry.end() ? VK_NULL_HANDLE : found->second.cache;
+}
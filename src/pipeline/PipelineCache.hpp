@@ -0,0 +1,22 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <string>
+
+class PipelineCache {
+
+  public:
+    // One VkPipelineCache per device, shared by every pipeline created on it.
+    // open fills it from path when the file was written by the same device
+    // and driver version, and close saves it back. Pipelines created before
+    // open, or after close, go without a cache.
+    static void open(VkDevice device, VkPhysicalDevice physical_device);
+    // Saves and destroys the device's cache, before the device goes
+    static void close(VkDevice device);
+    // Safe to call from the threads that build pipelines
+    static VkPipelineCache get(VkDevice device);
+
+    // Where the cache is kept between runs, empty to start cold every time
+    inline static std::string path = "pipeline_cache.bin";
+};
@@ -0,0 +1,67 @@
+#include "PipelineCompiler.hpp"
+#include "../system/cpu/ThreadPool.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct QueuedBuild {
+  const Pipeline* owner;
+  std::function<void()> build;
+};
+
+static std::mutex queue_mutex;
+static std::vector<QueuedBuild> queued;
+
+void PipelineCompiler::queue(const Pipeline* owner, std::function<void()> build) {
+  std::lock_guard<std::mutex> lock(queue_mutex);
+  queued.push_back({owner, std::move(build)});
+}
+
+void PipelineCompiler::forget(const Pipeline* owner) {
+  std::lock_guard<std::mutex> lock(queue_mutex);
+  queued.erase(std::remove_if(queued.begin(), queued.end(), [&](const QueuedBuild& build) {
+    return build.owner == owner;
+  }), queued.end());
+}
+
+void PipelineCompiler::compile() {
+  std::vector<QueuedBuild> builds;
+  {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    builds.swap(queued);
+  }
+  if (builds.empty()) {
+    return;
+  }
+
+  // An exception must not leave a worker, it is thrown again from here
+  std::vector<std::string> errors(builds.size());
+  auto run = [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      try {
+        builds[i].build();
+      } catch (const std::exception& error) {
+        errors[i] = error.what();
+      }
+    }
+  };
+
+  size_t thread_count = threads == 0 ? std::max<size_t>(std::thread::hardware_concurrency(), 1) : threads;
+  thread_count = std::min(thread_count, builds.size());
+  if (thread_count <= 1) {
+    run(0, builds.size());
+  } else {
+    ThreadPool pool(thread_count);
+    pool.parallel_for(0, builds.size(), 1, run);
+  }
+
+  for (const auto& error : errors) {
+    if (!error.empty()) {
+      throw std::runtime_error(error);
+    }
+  }
+}
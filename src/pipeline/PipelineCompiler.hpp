@@ -0,0 +1,23 @@
+#pragma once
+
+#include "Pipeline.hpp"
+
+#include <functional>
+
+class PipelineCompiler {
+
+  public:
+    // Compute pipelines are not built in create(), which only queues the
+    // build here. compile() runs everything queued at once on a thread pool,
+    // sharing the pipeline cache. It is called once the scene is set up, and
+    // by any pipeline bound before that.
+    static void queue(const Pipeline* owner, std::function<void()> build);
+    // Drops the owner's build if it has not run yet
+    static void forget(const Pipeline* owner);
+    // Throws the first build error once every build has finished
+    static void compile();
+
+    // Threads building at once, zero for one per hardware thread, one to
+    // build on the calling thread alone
+    inline static size_t threads = 0;
+};
@@ -1,16 +1,33 @@
 
 #include "Shader.hpp"
+#include "EmbeddedShaders.hpp"
+#include <cstring>
 #include <fstream>
 #include <stdexcept>
 
+static const EmbeddedShader* find_embedded(const std::string& filename) {
+  for (const EmbeddedShader* shader = EMBEDDED_SHADERS; shader->path != nullptr; shader++) {
+    if (std::strcmp(shader->path, filename.c_str()) == 0) {
+      return shader;
+    }
+  }
+  return nullptr;
+}
 
 Shader::Shader(VkDevice device, const std::string& filename, VkShaderStageFlagBits stage) : device(device), stage(stage) {
-  std::vector<char> file = readFile(filename);
-
   VkShaderModuleCreateInfo shader_info{};
   shader_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;   
-  shader_info.codeSize = file.size();
-  shader_info.pCode = reinterpret_cast<const uint32_t*>(file.data());
+
+  // The build embeds every shader, the file is only read for ones it does not know
+  std::vector<char> file;
+  if (const EmbeddedShader* embedded = find_embedded(filename)) {
+    shader_info.codeSize = embedded->size;
+    shader_info.pCode = embedded->code;
+  } else {
+    file = readFile(filename);
+    shader_info.codeSize = file.size();
+    shader_info.pCode = reinterpret_cast<const uint32_t*>(file.data());
+  }
 
   if (vkCreateShaderModule(device, &shader_info, nullptr, &module) != VK_SUCCESS) {
     throw std::runtime_error("Unable to create shader module");
@@ -25,7 +42,7 @@ std::vector<char> Shader::readFile(const std::string& filename) {
   std::ifstream file(filename, std::ios::ate | std::ios::binary);
 
   if (!file.is_open()) {
-    throw std::runtime_error("Unable to open file");
+    throw std::runtime_error("Unable to open file " + filename);
   }
 
   size_t filesize = (size_t) file.tellg();
@@ -0,0 +1,240 @@
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+Profiler::Profiler(
+  VkDevice device,
+  VkPhysicalDevice physical_device,
+  VkInstance instance,
+  uint32_t queue_family,
+  uint32_t frame_count,
+  bool labels
+) : device(device), frames(frame_count) {
+
+  uint32_t family_count;
+  vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, nullptr);
+  std::vector<VkQueueFamilyProperties> families(family_count);
+  vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, families.data());
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+  // Labels still help a capture tool when the queue has no timestamps
+  uint32_t valid_bits = queue_family < family_count ? families[queue_family].timestampValidBits : 0;
+  if (valid_bits > 0 && properties.limits.timestampPeriod > 0.0f) {
+    period = properties.limits.timestampPeriod;
+    valid_mask = valid_bits >= 64 ? ~0ull : ((1ull << valid_bits) - 1);
+
+    VkQueryPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    pool_info.queryCount = MAX_QUERIES * frame_count;
+
+    if (vkCreateQueryPool(device, &pool_info, nullptr, &pool) != VK_SUCCESS) {
+      throw std::runtime_error("Unable to create timestamp query pool");
+    }
+  } else {
+    std::cerr << "Queue has no timestamp support, profiling labels only" << '\n';
+  }
+
+  if (labels) {
+    begin_label = (PFN_vkCmdBeginDebugUtilsLabelEXT) vkGetInstanceProcAddr(instance, "vkCmdBeginDebugUtilsLabelEXT");
+    end_label = (PFN_vkCmdEndDebugUtilsLabelEXT) vkGetInstanceProcAddr(instance, "vkCmdEndDebugUtilsLabelEXT");
+  }
+}
+
+Profiler::~Profiler() {
+  if (pool != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(device, pool, nullptr);
+  }
+}
+
+void Profiler::begin_frame(VkCommandBuffer commandbuffer, uint32_t frame) {
+  current = frame % frames.size();
+
+  if (frames[current].recorded) {
+    resolve(current);
+  }
+
+  Frame& slot = frames[current];
+  slot.scopes.clear();
+  slot.open.clear();
+  slot.next_query = 0;
+  slot.recorded = false;
+
+  if (pool != VK_NULL_HANDLE) {
+    vkCmdResetQueryPool(commandbuffer, pool, current * MAX_QUERIES, MAX_QUERIES);
+  }
+}
+
+void Profiler::begin(VkCommandBuffer commandbuffer, const char* name) {
+  if (begin_label) {
+    VkDebugUtilsLabelEXT label{};
+    label.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+    label.pLabelName = name;
+    begin_label(commandbuffer, &label);
+  }
+
+  Frame& slot = frames[current];
+  Scope scope = {name, UINT32_MAX, UINT32_MAX, static_cast<uint32_t>(slot.open.size())};
+
+  // A full range drops the scope rather than overwrite another frame
+  if (pool != VK_NULL_HANDLE && slot.next_query + 2 <= MAX_QUERIES) {
+    scope.first_query = slot.next_query;
+    scope.second_query = slot.next_query + 1;
+    slot.next_query += 2;
+    vkCmdWriteTimestamp(commandbuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, pool, current * MAX_QUERIES + scope.first_query);
+  }
+
+  slot.open.push_back(slot.scopes.size());
+  slot.scopes.push_back(scope);
+}
+
+void Profiler::end(VkCommandBuffer commandbuffer) {
+  Frame& slot = frames[current];
+  if (slot.open.empty()) {
+    throw std::runtime_error("Profiler scope ended without a begin");
+  }
+
+  Scope& scope = slot.scopes[slot.open.back()];
+  slot.open.pop_back();
+
+  if (scope.second_query != UINT32_MAX) {
+    vkCmdWriteTimestamp(commandbuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, pool, current * MAX_QUERIES + scope.second_query);
+    slot.recorded = true;
+  }
+
+  if (end_label) {
+    end_label(commandbuffer);
+  }
+}
+
+void Profiler::flush() {
+  for (uint32_t frame = 0; frame < frames.size(); frame++) {
+    if (frames[frame].recorded) {
+      resolve(frame);
+      frames[frame].recorded = false;
+    }
+  }
+}
+
+Profiler::Stats& Profiler::find_stats(const char* name, uint32_t depth) {
+  for (auto& entry : stats) {
+    if (entry.name == name) {
+      return entry;
+    }
+  }
+
+  Stats entry;
+  entry.name = name;
+  entry.depth = depth;
+  stats.push_back(entry);
+  return stats.back();
+}
+
+void Profiler::resolve(uint32_t frame) {
+  Frame& slot = frames[frame];
+
+  std::vector<uint64_t> values(slot.next_query);
+  VkResult result = vkGetQueryPoolResults(
+    device,
+    pool,
+    frame * MAX_QUERIES,
+    slot.next_query,
+    sizeof(uint64_t) * values.size(),
+    values.data(),
+    sizeof(uint64_t),
+    VK_QUERY_RESULT_64_BIT
+  );
+
+  // The slot's fence was waited, so this only happens on a lost frame
+  if (result != VK_SUCCESS) {
+    return;
+  }
+
+  // Sum repeated names, the sort records the same stages once per pass
+  std::vector<std::pair<const char*, double>> totals;
+  std::vector<uint32_t> depths;
+  for (const auto& scope : slot.scopes) {
+    if (scope.second_query == UINT32_MAX) continue;
+
+    if (trace) {
+      trace->gpu_event(scope.name, values[scope.first_query], values[scope.second_query]);
+    }
+
+    uint64_t ticks = (values[scope.second_query] - values[scope.first_query]) & valid_mask;
+    double milliseconds = ticks * period * 1e-6;
+
+    auto found = std::find_if(totals.begin(), totals.end(), [&](const auto& total) {
+      return std::strcmp(total.first, scope.name) == 0;
+    });
+    if (found == totals.end()) {
+      totals.emplace_back(scope.name, milliseconds);
+      depths.push_back(scope.depth);
+    } else {
+      found->second += milliseconds;
+    }
+  }
+
+  for (size_t i = 0; i < totals.size(); i++) {
+    Stats& entry = find_stats(totals[i].first, depths[i]);
+    entry.samples.push_back(totals[i].second);
+    if (entry.samples.size() > WINDOW) {
+      entry.samples.pop_front();
+    }
+  }
+
+  resolved_frames++;
+  if (report_interval > 0 && resolved_frames % report_interval == 0) {
+    report(std::cout);
+  }
+}
+
+std::vector<PassTiming> Profiler::summary() const {
+  std::vector<PassTiming> timings;
+
+  for (const auto& entry : stats) {
+    if (entry.samples.empty()) continue;
+
+    std::vector<double> sorted(entry.samples.begin(), entry.samples.end());
+    std::sort(sorted.begin(), sorted.end());
+
+    double sum = 0.0;
+    for (double sample : sorted) sum += sample;
+
+    auto percentile = [&](double p) {
+      size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+      return sorted[std::min(index, sorted.size() - 1)];
+    };
+
+    timings.push_back({entry.name, entry.depth, sorted.size(), sum / sorted.size(), percentile(0.50), percentile(0.95), percentile(0.99)});
+  }
+
+  return timings;
+}
+
+void Profiler::clear_stats() {
+  for (auto& entry : stats) {
+    entry.samples.clear();
+  }
+}
+
+void Profiler::report(std::ostream& out) const {
+  out << std::left << std::setw(28) << "pass" << std::right
+      << std::setw(10) << "avg ms" << std::setw(10) << "p50" << std::setw(10) << "p95" << std::setw(10) << "p99" << '\n';
+
+  for (const auto& timing : summary()) {
+    std::string name = std::string(timing.depth * 2, ' ') + timing.name;
+    out << std::left << std::setw(28) << name << std::right << std::fixed << std::setprecision(3)
+        << std::setw(10) << timing.mean
+        << std::setw(10) << timing.p50
+        << std::setw(10) << timing.p95
+        << std::setw(10) << timing.p99 << '\n';
+  }
+
+  out << '\n';
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "Trace.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <deque>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct PassTiming {
+  std::string name;
+  uint32_t depth;
+  size_t samples;
+  double mean;
+  double p50;
+  double p95;
+  double p99;
+};
+
+// GPU timestamps around named passes, one query range per frame in flight.
+// A range is read back when its frame slot comes round again, after that slot's
+// fence has been waited on, so reading results never stalls the queue.
+// Scopes with the same name in one frame are summed, so the 32 sort passes
+// report as one line per stage.
+class Profiler {
+
+  public:
+    Profiler(VkDevice device, VkPhysicalDevice physical_device, VkInstance instance, uint32_t queue_family, uint32_t frame_count, bool labels);
+    ~Profiler();
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    // Resolves what this slot recorded last time, then resets its queries
+    void begin_frame(VkCommandBuffer commandbuffer, uint32_t frame);
+
+    void begin(VkCommandBuffer commandbuffer, const char* name);
+    void end(VkCommandBuffer commandbuffer);
+
+    // Reads every recorded slot, only once the queue is idle
+    void flush();
+
+    // Rolling average and percentiles in milliseconds per scope name
+    std::vector<PassTiming> summary() const;
+    void report(std::ostream& out) const;
+
+    // Drops the collected samples, e.g. after warm-up
+    void clear_stats();
+
+    bool timestamps_supported() const { return pool != VK_NULL_HANDLE; }
+
+    // Every resolved scope also goes to the trace, unsummed
+    void set_trace(Trace* trace) { this->trace = trace; }
+
+    inline static bool enabled = false;
+    // Resolved frames between console reports
+    inline static uint32_t report_interval = 240;
+
+  private:
+    struct Scope {
+      const char* name;
+      uint32_t first_query;
+      uint32_t second_query;
+      uint32_t depth;
+    };
+
+    struct Frame {
+      std::vector<Scope> scopes;
+      std::vector<size_t> open;
+      uint32_t next_query = 0;
+      bool recorded = false;
+    };
+
+    struct Stats {
+      std::string name;
+      std::deque<double> samples;
+      uint32_t depth = 0;
+    };
+
+    void resolve(uint32_t frame);
+    Stats& find_stats(const char* name, uint32_t depth);
+
+    static constexpr uint32_t MAX_QUERIES = 8192;
+    static constexpr size_t WINDOW = 240;
+
+    VkDevice device;
+    VkQueryPool pool = VK_NULL_HANDLE;
+    double period = 1.0;
+    uint64_t valid_mask = ~0ull;
+
+    PFN_vkCmdBeginDebugUtilsLabelEXT begin_label = nullptr;
+    PFN_vkCmdEndDebugUtilsLabelEXT end_label = nullptr;
+
+    Trace* trace = nullptr;
+
+    std::vector<Frame> frames;
+    uint32_t current = 0;
+    uint32_t resolved_frames = 0;
+
+    // Kept in first seen order so the report follows the frame
+    std::vector<Stats> stats;
+};
+
+// Begins a scope on construction and ends it when it leaves scope, a null
+// profiler makes both no-ops
+class ProfileScope {
+
+  public:
+    ProfileScope(Profiler* profiler, VkCommandBuffer commandbuffer, const char* name) : profiler(profiler), commandbuffer(commandbuffer) {
+      if (profiler) profiler->begin(commandbuffer, name);
+    }
+
+    ~ProfileScope() {
+      if (profiler) profiler->end(commandbuffer);
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+  private:
+    Profiler* profiler;
+    VkCommandBuffer commandbuffer;
+};
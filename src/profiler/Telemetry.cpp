@@ -0,0 +1,177 @@
+#include "Telemetry.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+Telemetry::Telemetry(
+  VkDevice device,
+  VkPhysicalDevice physical_device,
+  uint32_t queue_family,
+  uint32_t frame_count
+) : device(device), slots(frame_count) {
+
+  uint32_t family_count;
+  vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, nullptr);
+  std::vector<VkQueueFamilyProperties> families(family_count);
+  vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, families.data());
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+  // Without timestamps the GPU column stays empty, the rest still records
+  uint32_t valid_bits = queue_family < family_count ? families[queue_family].timestampValidBits : 0;
+  if (valid_bits > 0 && properties.limits.timestampPeriod > 0.0f) {
+    period = properties.limits.timestampPeriod;
+    valid_mask = valid_bits >= 64 ? ~0ull : ((1ull << valid_bits) - 1);
+
+    VkQueryPoolCreateInfo pool_info{};
+    pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    pool_info.queryCount = 2 * frame_count;
+
+    if (vkCreateQueryPool(device, &pool_info, nullptr, &pool) != VK_SUCCESS) {
+      throw std::runtime_error("Unable to create telemetry query pool");
+    }
+  }
+}
+
+Telemetry::~Telemetry() {
+  if (!csv_path.empty() && !history.empty()) {
+    try {
+      write_csv(csv_path);
+    } catch (const std::exception& error) {
+      std::cerr << error.what() << '\n';
+    }
+  }
+
+  if (pool != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(device, pool, nullptr);
+  }
+}
+
+void Telemetry::begin_gpu(VkCommandBuffer commandbuffer, uint32_t slot) {
+  current = slot % slots.size();
+  if (pool == VK_NULL_HANDLE) return;
+
+  if (slots[current].recorded) {
+    resolve(current);
+  }
+
+  slots[current].frame = history.size();
+  slots[current].recorded = true;
+
+  vkCmdResetQueryPool(commandbuffer, pool, current * 2, 2);
+  vkCmdWriteTimestamp(commandbuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, pool, current * 2);
+}
+
+void Telemetry::end_gpu(VkCommandBuffer commandbuffer) {
+  if (pool == VK_NULL_HANDLE) return;
+  vkCmdWriteTimestamp(commandbuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, pool, current * 2 + 1);
+}
+
+void Telemetry::end_frame(double cpu_ms) {
+  pending.frame = history.size();
+  pending.cpu_ms = cpu_ms;
+  history.push_back(pending);
+  pending = FrameSample{};
+}
+
+void Telemetry::resolve(uint32_t slot) {
+  slots[slot].recorded = false;
+
+  uint64_t values[2];
+  VkResult result = vkGetQueryPoolResults(device, pool, slot * 2, 2, sizeof(values), values, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+  if (result != VK_SUCCESS || slots[slot].frame >= history.size()) {
+    return;
+  }
+
+  history[slots[slot].frame].gpu_ms = ((values[1] - values[0]) & valid_mask) * period * 1e-6;
+}
+
+void Telemetry::flush() {
+  if (pool == VK_NULL_HANDLE) return;
+
+  for (uint32_t slot = 0; slot < slots.size(); slot++) {
+    if (slots[slot].recorded) {
+      resolve(slot);
+    }
+  }
+}
+
+FrameSummary Telemetry::summarize(Metric metric, size_t window) const {
+  size_t first = history.size() > window ? history.size() - window : 0;
+
+  std::vector<double> values;
+  values.reserve(history.size() - first);
+  for (size_t i = first; i < history.size(); i++) {
+    const FrameSample& sample = history[i];
+    switch (metric) {
+      case Metric::cpu: values.push_back(sample.cpu_ms); break;
+      case Metric::gpu: if (sample.gpu_ms >= 0.0) values.push_back(sample.gpu_ms); break;
+      case Metric::present_wait: values.push_back(sample.present_wait_ms); break;
+    }
+  }
+
+  FrameSummary summary;
+  if (values.empty()) {
+    return summary;
+  }
+
+  std::sort(values.begin(), values.end());
+  auto percentile = [&](double p) {
+    size_t index = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+    return values[std::min(index, values.size() - 1)];
+  };
+
+  double sum = 0.0;
+  for (double value : values) sum += value;
+
+  summary.count = values.size();
+  summary.mean = sum / values.size();
+  summary.p50 = percentile(0.50);
+  summary.p95 = percentile(0.95);
+  summary.p99 = percentile(0.99);
+  summary.max = values.back();
+  return summary;
+}
+
+void Telemetry::report(std::ostream& out, size_t window) const {
+  out << std::left << std::setw(16) << "frame ms" << std::right
+      << std::setw(10) << "mean" << std::setw(10) << "p50" << std::setw(10) << "p95"
+      << std::setw(10) << "p99" << std::setw(10) << "max" << '\n';
+
+  const std::pair<const char*, Metric> rows[] = {
+    {"cpu", Metric::cpu},
+    {"gpu", Metric::gpu},
+    {"present wait", Metric::present_wait},
+  };
+
+  for (const auto& row : rows) {
+    FrameSummary summary = summarize(row.second, window);
+    if (summary.count == 0) continue;
+
+    out << std::left << std::setw(16) << row.first << std::right << std::fixed << std::setprecision(3)
+        << std::setw(10) << summary.mean << std::setw(10) << summary.p50 << std::setw(10) << summary.p95
+        << std::setw(10) << summary.p99 << std::setw(10) << summary.max << '\n';
+  }
+
+  out << '\n';
+}
+
+void Telemetry::write_csv(const std::string& path) const {
+  std::ofstream file(path);
+  if (!file) {
+    throw std::runtime_error("Unable to write telemetry to " + path);
+  }
+
+  file << "frame,cpu_ms,gpu_ms,present_wait_ms,sim_steps\n";
+  file << std::setprecision(6);
+  for (const auto& sample : history) {
+    file << sample.frame << ',' << sample.cpu_ms << ',';
+    if (sample.gpu_ms >= 0.0) file << sample.gpu_ms;
+    file << ',' << sample.present_wait_ms << ',' << sample.sim_steps << '\n';
+  }
+}
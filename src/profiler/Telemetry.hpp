@@ -0,0 +1,85 @@
+#pragma once
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct FrameSample {
+  uint64_t frame = 0;
+  // Host time from the start of one frame to the start of the next
+  double cpu_ms = 0.0;
+  // Between the first and last command of the frame, negative until resolved
+  double gpu_ms = -1.0;
+  // Waiting on the frame fence and the swapchain image
+  double present_wait_ms = 0.0;
+  uint32_t sim_steps = 0;
+};
+
+struct FrameSummary {
+  size_t count = 0;
+  double mean = 0.0;
+  double p50 = 0.0;
+  double p95 = 0.0;
+  double p99 = 0.0;
+  double max = 0.0;
+};
+
+// Keeps every frame's sample for the CSV dump and summarises a sliding window.
+// GPU times come from a timestamp pair per frame in flight and are filled in
+// when that slot is reused, like the Profiler.
+class Telemetry {
+
+  public:
+    Telemetry(VkDevice device, VkPhysicalDevice physical_device, uint32_t queue_family, uint32_t frame_count);
+    ~Telemetry();
+
+    Telemetry(const Telemetry&) = delete;
+    Telemetry& operator=(const Telemetry&) = delete;
+
+    // Around everything recorded for the frame, slot is the frame in flight
+    void begin_gpu(VkCommandBuffer commandbuffer, uint32_t slot);
+    void end_gpu(VkCommandBuffer commandbuffer);
+
+    void add_present_wait(double milliseconds) { pending.present_wait_ms += milliseconds; }
+    void add_steps(uint32_t steps) { pending.sim_steps += steps; }
+    void end_frame(double cpu_ms);
+
+    // Reads every slot, only once the queue is idle
+    void flush();
+
+    enum class Metric { cpu, gpu, present_wait };
+    FrameSummary summarize(Metric metric, size_t window) const;
+
+    void report(std::ostream& out, size_t window) const;
+    void write_csv(const std::string& path) const;
+
+    const std::vector<FrameSample>& samples() const { return history; }
+
+    // Written on exit, empty skips the dump
+    inline static std::string csv_path = "telemetry.csv";
+
+    // Frames summarised by the exit report
+    inline static size_t report_window = 1000;
+
+  private:
+    struct Slot {
+      uint64_t frame = 0;
+      bool recorded = false;
+    };
+
+    void resolve(uint32_t slot);
+
+    VkDevice device;
+    VkQueryPool pool = VK_NULL_HANDLE;
+    double period = 1.0;
+    uint64_t valid_mask = ~0ull;
+
+    std::vector<Slot> slots;
+    uint32_t current = 0;
+
+    FrameSample pending;
+    std::vector<FrameSample> history;
+};
@@ -0,0 +1,173 @@
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <time.h>
+
+Trace::Trace(
+  VkInstance instance,
+  VkDevice device,
+  VkPhysicalDevice physical_device,
+  uint32_t queue_family,
+  CommandPool& commandpool,
+  bool calibrated
+) : device(device) {
+
+  uint32_t family_count;
+  vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, nullptr);
+  std::vector<VkQueueFamilyProperties> families(family_count);
+  vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, families.data());
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+  uint32_t valid_bits = queue_family < family_count ? families[queue_family].timestampValidBits : 0;
+  has_timestamps = valid_bits > 0 && properties.limits.timestampPeriod > 0.0f;
+  if (!has_timestamps) {
+    std::cerr << "Queue has no timestamp support, tracing host scopes only" << '\n';
+    return;
+  }
+  period = properties.limits.timestampPeriod;
+
+  // The device clock has to be calibrateable against the same host clock as now()
+  if (calibrated) {
+    auto get_domains = (PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT) vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT");
+
+    uint32_t domain_count = 0;
+    std::vector<VkTimeDomainEXT> domains;
+    if (get_domains && get_domains(physical_device, &domain_count, nullptr) == VK_SUCCESS) {
+      domains.resize(domain_count);
+      get_domains(physical_device, &domain_count, domains.data());
+    }
+
+    bool device_domain = std::find(domains.begin(), domains.end(), VK_TIME_DOMAIN_DEVICE_EXT) != domains.end();
+    bool host_domain = std::find(domains.begin(), domains.end(), VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT) != domains.end();
+    if (device_domain && host_domain) {
+      get_calibrated_timestamps = (PFN_vkGetCalibratedTimestampsEXT) vkGetDeviceProcAddr(device, "vkGetCalibratedTimestampsEXT");
+    }
+  }
+
+  if (get_calibrated_timestamps) {
+    recalibrate();
+  } else {
+    calibrate_with_submit(commandpool);
+  }
+}
+
+Trace::~Trace() = default;
+
+uint64_t Trace::now() {
+  timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return static_cast<uint64_t>(time.tv_sec) * 1000000000ull + static_cast<uint64_t>(time.tv_nsec);
+}
+
+void Trace::recalibrate() {
+  if (!get_calibrated_timestamps) return;
+
+  VkCalibratedTimestampInfoEXT infos[2]{};
+  infos[0].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+  infos[0].timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+  infos[1].sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+  infos[1].timeDomain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+
+  uint64_t stamps[2];
+  uint64_t deviation;
+  if (get_calibrated_timestamps(device, 2, infos, stamps, &deviation) != VK_SUCCESS) {
+    return;
+  }
+
+  offset_ns = static_cast<double>(stamps[1]) - static_cast<double>(stamps[0]) * period;
+}
+
+void Trace::calibrate_with_submit(CommandPool& commandpool) {
+  VkQueryPoolCreateInfo pool_info{};
+  pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  pool_info.queryCount = 1;
+
+  VkQueryPool pool;
+  if (vkCreateQueryPool(device, &pool_info, nullptr, &pool) != VK_SUCCESS) {
+    throw std::runtime_error("Unable to create trace query pool");
+  }
+
+  VkCommandBuffer commandbuffer = commandpool.start_single_command();
+  vkCmdResetQueryPool(commandbuffer, pool, 0, 1);
+  vkCmdWriteTimestamp(commandbuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, pool, 0);
+
+  uint64_t before = now();
+  commandpool.end_single_command(commandbuffer);
+  uint64_t after = now();
+
+  uint64_t ticks = 0;
+  VkResult result = vkGetQueryPoolResults(device, pool, 0, 1, sizeof(ticks), &ticks, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+  vkDestroyQueryPool(device, pool, nullptr);
+
+  if (result != VK_SUCCESS) {
+    has_timestamps = false;
+    return;
+  }
+
+  // Somewhere between submit and the wait returning, off by at most that gap
+  double host = 0.5 * (static_cast<double>(before) + static_cast<double>(after));
+  offset_ns = host - static_cast<double>(ticks) * period;
+  std::cerr << "No calibrated timestamps, GPU track aligned to within " << (after - before) / 1000 << " us" << '\n';
+}
+
+void Trace::push(const Event& event) {
+  if (events.size() >= max_events) {
+    if (!dropped) {
+      std::cerr << "Trace is full, later events are dropped" << '\n';
+      dropped = true;
+    }
+    return;
+  }
+
+  events.push_back(event);
+}
+
+void Trace::cpu_event(const char* name, uint64_t begin_ns, uint64_t end_ns) {
+  push({name, begin_ns, end_ns, HOST});
+}
+
+void Trace::gpu_event(const char* name, uint64_t begin_ticks, uint64_t end_ticks) {
+  if (!has_timestamps) return;
+
+  double begin = static_cast<double>(begin_ticks) * period + offset_ns;
+  double end = static_cast<double>(end_ticks) * period + offset_ns;
+  if (begin < 0.0 || end < begin) return;
+
+  push({name, static_cast<uint64_t>(begin), static_cast<uint64_t>(end), QUEUE});
+}
+
+void Trace::write(const std::string& path) const {
+  std::ofstream file(path);
+  if (!file) {
+    throw std::runtime_error("Unable to write trace to " + path);
+  }
+
+  // Microseconds from the earliest event keep the numbers short
+  uint64_t origin = UINT64_MAX;
+  for (const auto& event : events) {
+    origin = std::min(origin, event.begin_ns);
+  }
+
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  file << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << HOST << ",\"args\":{\"name\":\"fluidsim\"}},\n";
+  file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << HOST << ",\"args\":{\"name\":\"host\"}},\n";
+  file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << QUEUE << ",\"args\":{\"name\":\"gpu queue\"}}";
+
+  file.setf(std::ios::fixed);
+  file.precision(3);
+  for (const auto& event : events) {
+    file << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"" << (event.track == HOST ? "cpu" : "gpu")
+         << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.track
+         << ",\"ts\":" << (event.begin_ns - origin) / 1000.0
+         << ",\"dur\":" << (event.end_ns - event.begin_ns) / 1000.0 << '}';
+  }
+
+  file << "\n]}\n";
+  std::cout << "Wrote " << events.size() << " trace events to " << path << '\n';
+}
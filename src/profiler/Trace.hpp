@@ -0,0 +1,86 @@
+#pragma once
+
+#include "../command/CommandPool.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Host scopes and resolved GPU scopes on one timeline, written as Chrome trace
+// event JSON that Perfetto and chrome://tracing load. GPU ticks are mapped to
+// CLOCK_MONOTONIC with VK_EXT_calibrated_timestamps when the device has it,
+// otherwise from one timestamp written by a single submit at startup.
+class Trace {
+
+  public:
+    Trace(VkInstance instance, VkDevice device, VkPhysicalDevice physical_device, uint32_t queue_family, CommandPool& commandpool, bool calibrated);
+    ~Trace();
+
+    Trace(const Trace&) = delete;
+    Trace& operator=(const Trace&) = delete;
+
+    // CLOCK_MONOTONIC in nanoseconds
+    static uint64_t now();
+
+    // Names must outlive the trace, every caller passes a literal
+    void cpu_event(const char* name, uint64_t begin_ns, uint64_t end_ns);
+    void gpu_event(const char* name, uint64_t begin_ticks, uint64_t end_ticks);
+
+    // Cheap with the extension, skipped without it since it would stall the queue
+    void recalibrate();
+
+    void write(const std::string& path) const;
+
+    // Empty disables tracing
+    inline static std::string path;
+    // Events past this are dropped, about 32 bytes each
+    inline static size_t max_events = 1 << 22;
+
+  private:
+    enum Track : uint32_t { HOST = 1, QUEUE = 2 };
+
+    struct Event {
+      const char* name;
+      uint64_t begin_ns;
+      uint64_t end_ns;
+      Track track;
+    };
+
+    void push(const Event& event);
+    void calibrate_with_submit(CommandPool& commandpool);
+
+    VkDevice device;
+
+    double period = 1.0;
+    // Host nanoseconds at GPU tick zero
+    double offset_ns = 0.0;
+    bool has_timestamps = false;
+
+    PFN_vkGetCalibratedTimestampsEXT get_calibrated_timestamps = nullptr;
+
+    std::vector<Event> events;
+    bool dropped = false;
+};
+
+// Times the enclosing block on the host track, a null trace makes it a no-op
+class TraceScope {
+
+  public:
+    TraceScope(Trace* trace, const char* name) : trace(trace), name(name) {
+      if (trace) begin = Trace::now();
+    }
+
+    ~TraceScope() {
+      if (trace) trace->cpu_event(name, begin, Trace::now());
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+  private:
+    Trace* trace;
+    const char* name;
+    uint64_t begin = 0;
+};
@@ -0,0 +1,78 @@
+#include "Checkpoint.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+CheckpointHeader Checkpoint::make_header(const SphConstants& constants, uint32_t particle_size) {
+  CheckpointHeader header{};
+  std::memcpy(header.magic, "FSCP", 4);
+  header.version = VERSION;
+  header.header_size = sizeof(CheckpointHeader);
+  header.particle_size = particle_size;
+  header.table_cells = constants.table_cells;
+  header.smoothing_radius = constants.smoothing_radius;
+  header.mass = constants.mass;
+  header.target_density = constants.target_density;
+  header.pressure_multiplier = constants.pressure_multiplier;
+  return header;
+}
+
+void Checkpoint::write(const std::string& path, CheckpointHeader header, const void* particles) {
+  header.particles_offset = ALIGNMENT;
+  header.particles_bytes = static_cast<uint64_t>(header.live) * header.particle_size;
+
+  std::string temporary = path + ".tmp";
+  {
+    std::ofstream file(temporary, std::ios::binary);
+    if (!file.is_open()) {
+      throw std::runtime_error("Unable to write checkpoint " + temporary);
+    }
+
+    std::vector<char> page(ALIGNMENT, 0);
+    std::memcpy(page.data(), &header, sizeof(CheckpointHeader));
+    file.write(page.data(), page.size());
+    file.write(static_cast<const char*>(particles), header.particles_bytes);
+
+    // Padded to whole pages so the last one maps without a partial tail
+    uint64_t tail = header.particles_bytes % ALIGNMENT;
+    if (tail != 0) {
+      std::vector<char> padding(ALIGNMENT - tail, 0);
+      file.write(padding.data(), padding.size());
+    }
+
+    if (!file) {
+      throw std::runtime_error("Unable to write checkpoint " + temporary);
+    }
+  }
+
+  std::filesystem::rename(temporary, path);
+}
+
+MappedCheckpoint::MappedCheckpoint(const std::string& path) : path(path), file(path) {
+  if (file.size() < sizeof(CheckpointHeader)) {
+    throw std::runtime_error("Checkpoint " + path + " is too short");
+  }
+
+  const CheckpointHeader& loaded = header();
+  if (std::memcmp(loaded.magic, "FSCP", 4) != 0 || loaded.version != Checkpoint::VERSION || loaded.header_size != sizeof(CheckpointHeader)) {
+    throw std::runtime_error(path + " is not a checkpoint, or from an unsupported version");
+  }
+  if (loaded.particles_offset % Checkpoint::ALIGNMENT != 0 || loaded.particles_offset + loaded.particles_bytes > file.size() ||
+      loaded.particles_bytes != static_cast<uint64_t>(loaded.live) * loaded.particle_size) {
+    throw std::runtime_error("Checkpoint " + path + " is truncated or has a broken layout");
+  }
+}
+
+void MappedCheckpoint::check(const SphConstants& constants, uint32_t particle_size) const {
+  CheckpointHeader expected = Checkpoint::make_header(constants, particle_size);
+  const CheckpointHeader& loaded = header();
+
+  if (loaded.particle_size != expected.particle_size || loaded.table_cells != expected.table_cells ||
+      loaded.smoothing_radius != expected.smoothing_radius || loaded.mass != expected.mass ||
+      loaded.target_density != expected.target_density || loaded.pressure_multiplier != expected.pressure_multiplier) {
+    throw std::runtime_error("Checkpoint " + path + " was written with different simulation constants");
+  }
+}
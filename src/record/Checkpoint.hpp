@@ -0,0 +1,67 @@
+#pragma once
+
+#include "MappedFile.hpp"
+#include "../system/cpu/Kernels.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Fixed size, little endian, at the start of every checkpoint. The particle
+// array follows at particles_offset, a multiple of Checkpoint::ALIGNMENT, so
+// a mapped file hands it out page aligned.
+struct CheckpointHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t header_size;
+  uint32_t particle_size;
+
+  // GPU step counter at save time, emitters seed from it
+  uint64_t step;
+  uint32_t live;
+
+  // Constants the shaders were built with, a checkpoint only loads into a
+  // build that matches
+  uint32_t table_cells;
+  float smoothing_radius;
+  float mass;
+  float target_density;
+  float pressure_multiplier;
+
+  // Box faces, front back bottom top right left
+  float boundary[6];
+
+  uint64_t particles_offset;
+  uint64_t particles_bytes;
+};
+
+struct Checkpoint {
+  static constexpr uint32_t VERSION = 1;
+  static constexpr uint64_t ALIGNMENT = 4096;
+
+  // Fills the layout fields of header and writes live particles of
+  // particle_size bytes each. The file goes to a temporary name first and is
+  // renamed over path, so a crash mid-write keeps the previous checkpoint.
+  static void write(const std::string& path, CheckpointHeader header, const void* particles);
+
+  // The header a run with these constants writes, step, live and boundary unset
+  static CheckpointHeader make_header(const SphConstants& constants, uint32_t particle_size);
+};
+
+// Read-only mapping of a whole checkpoint, checked against the header on open
+class MappedCheckpoint {
+
+  public:
+    explicit MappedCheckpoint(const std::string& path);
+
+    const CheckpointHeader& header() const { return *reinterpret_cast<const CheckpointHeader*>(file.data()); }
+    // Straight from the mapped pages, no copy
+    const void* particles() const { return file.data() + header().particles_offset; }
+
+    // Throws unless the header was written by a run with the same constants
+    void check(const SphConstants& constants, uint32_t particle_size) const;
+
+  private:
+    std::string path;
+    MappedFile file;
+};
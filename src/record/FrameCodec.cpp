@@ -0,0 +1,295 @@
+#include "FrameCodec.hpp"
+#include "MappedFile.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+// Velocity x y z and density after the position code
+static constexpr uint32_t FIELDS = 4;
+// Top 12 Morton bits pick the bucket
+static constexpr uint32_t BUCKET_BITS = 12;
+static constexpr uint32_t BUCKETS = 1u << BUCKET_BITS;
+
+static uint64_t zigzag(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+static void put_varint(std::vector<uint8_t>& out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+static uint64_t get_varint(const uint8_t*& at, const uint8_t* end) {
+  uint64_t value = 0;
+  for (uint32_t shift = 0; shift < 64; shift += 7) {
+    if (at >= end) {
+      throw std::runtime_error("Encoded frame ends inside a value");
+    }
+    uint8_t byte = *at++;
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) return value;
+  }
+  throw std::runtime_error("Encoded frame has an overlong value");
+}
+
+// Spreads the low 21 bits so three axes interleave into 63
+static uint64_t spread(uint64_t value) {
+  value &= 0x1fffff;
+  value = (value | value << 32) & 0x1f00000000ffffull;
+  value = (value | value << 16) & 0x1f0000ff0000ffull;
+  value = (value | value << 8) & 0x100f00f00f00f00full;
+  value = (value | value << 4) & 0x10c30c30c30c30c3ull;
+  value = (value | value << 2) & 0x1249249249249249ull;
+  return value;
+}
+
+static uint32_t compact(uint64_t value) {
+  value &= 0x1249249249249249ull;
+  value = (value | value >> 2) & 0x10c30c30c30c30c3ull;
+  value = (value | value >> 4) & 0x100f00f00f00f00full;
+  value = (value | value >> 8) & 0x1f0000ff0000ffull;
+  value = (value | value >> 16) & 0x1f00000000ffffull;
+  value = (value | value >> 32) & 0x1fffff;
+  return static_cast<uint32_t>(value);
+}
+
+static uint32_t quantize(float value, float low, float scale, uint32_t steps) {
+  float q = std::round((value - low) * scale);
+  return static_cast<uint32_t>(std::clamp(q, 0.0f, static_cast<float>(steps)));
+}
+
+// Quantization steps for one frame, the same on both sides
+struct Steps {
+  uint32_t position;
+  uint32_t velocity;
+  uint32_t density;
+
+  explicit Steps(const EncodedHeader& header)
+    : position((1u << header.position_bits) - 1),
+      velocity((1u << (header.velocity_bits - 1)) - 1),
+      density((1u << header.density_bits) - 1) {}
+};
+
+std::vector<uint8_t> FrameCodec::encode(const FramePoints& frame, ThreadPool& pool) {
+  uint32_t count = static_cast<uint32_t>(frame.count());
+  uint32_t chunk = std::max(chunk_size, 1u);
+  uint32_t chunk_count = (count + chunk - 1) / chunk;
+  const float* values = frame.values.data();
+
+  EncodedHeader header{};
+  std::memcpy(header.magic, "FSQ1", 4);
+  header.version = VERSION;
+  header.count = count;
+  header.chunk_count = chunk_count;
+  header.position_bits = std::clamp(position_bits, MIN_POSITION_BITS, MAX_POSITION_BITS);
+  header.velocity_bits = std::clamp(velocity_bits, MIN_VALUE_BITS, MAX_VALUE_BITS);
+  header.density_bits = std::clamp(density_bits, MIN_VALUE_BITS, MAX_VALUE_BITS);
+  Steps steps(header);
+
+  // Ranges per chunk first, then folded into the frame's
+  std::vector<std::array<float, 8>> ranges(chunk_count);
+  pool.parallel_for(0, chunk_count, 1, [&](size_t first, size_t last) {
+    for (size_t c = first; c < last; c++) {
+      std::array<float, 8> range = {INFINITY, INFINITY, INFINITY, -INFINITY, -INFINITY, -INFINITY, 0.0f, 0.0f};
+      size_t end = std::min<size_t>((c + 1) * chunk, count);
+      for (size_t i = c * chunk; i < end; i++) {
+        const float* p = values + i * 8;
+        for (int axis = 0; axis < 3; axis++) {
+          range[axis] = std::min(range[axis], p[axis]);
+          range[3 + axis] = std::max(range[3 + axis], p[axis]);
+          range[6] = std::max(range[6], std::abs(p[4 + axis]));
+        }
+        range[7] = std::max(range[7], p[3]);
+      }
+      ranges[c] = range;
+    }
+  });
+
+  for (int axis = 0; axis < 3; axis++) {
+    header.position_min[axis] = count > 0 ? INFINITY : 0.0f;
+    header.position_max[axis] = count > 0 ? -INFINITY : 0.0f;
+  }
+  for (const auto& range : ranges) {
+    for (int axis = 0; axis < 3; axis++) {
+      header.position_min[axis] = std::min(header.position_min[axis], range[axis]);
+      header.position_max[axis] = std::max(header.position_max[axis], range[3 + axis]);
+    }
+    header.velocity_range = std::max(header.velocity_range, range[6]);
+    header.density_range = std::max(header.density_range, range[7]);
+  }
+
+  float position_scale[3];
+  for (int axis = 0; axis < 3; axis++) {
+    float extent = header.position_max[axis] - header.position_min[axis];
+    position_scale[axis] = extent > 0.0f ? steps.position / extent : 0.0f;
+  }
+  float velocity_scale = header.velocity_range > 0.0f ? steps.velocity / header.velocity_range : 0.0f;
+  float density_scale = header.density_range > 0.0f ? steps.density / header.density_range : 0.0f;
+
+  // Quantize every particle and key its cell on a Morton curve, sorted the
+  // whole frame becomes one walk through the box and each chunk one region
+  std::vector<std::array<uint32_t, FIELDS>> quantized(count);
+  std::vector<uint64_t> codes(count);
+  pool.parallel_for(0, count, chunk, [&](size_t first, size_t last) {
+    for (size_t i = first; i < last; i++) {
+      const float* p = values + i * 8;
+      uint64_t code = 0;
+      for (int axis = 0; axis < 3; axis++) {
+        uint32_t cell = quantize(p[axis], header.position_min[axis], position_scale[axis], steps.position);
+        code |= spread(cell) << axis;
+        quantized[i][axis] = quantize(p[4 + axis], -header.velocity_range, velocity_scale, 2 * steps.velocity);
+      }
+      quantized[i][3] = quantize(std::max(p[3], 0.0f), 0.0f, density_scale, steps.density);
+      codes[i] = code;
+    }
+  });
+
+  // Counting sort on the top bits, then each bucket sorted on its own
+  uint32_t bucket_shift = 3 * header.position_bits - BUCKET_BITS;
+  std::vector<uint32_t> starts(BUCKETS + 1, 0);
+  for (uint64_t code : codes) starts[(code >> bucket_shift) + 1]++;
+  std::partial_sum(starts.begin(), starts.end(), starts.begin());
+
+  std::vector<uint32_t> order(count);
+  std::vector<uint32_t> cursor(starts.begin(), starts.end() - 1);
+  for (uint32_t i = 0; i < count; i++) order[cursor[codes[i] >> bucket_shift]++] = i;
+
+  pool.parallel_for(0, BUCKETS, 64, [&](size_t first, size_t last) {
+    for (size_t bucket = first; bucket < last; bucket++) {
+      std::sort(order.begin() + starts[bucket], order.begin() + starts[bucket + 1], [&](uint32_t a, uint32_t b) {
+        return codes[a] < codes[b];
+      });
+    }
+  });
+
+  // Sorted codes only grow, so their gaps are stored as they are, the
+  // other fields as zigzag differences
+  std::vector<std::vector<uint8_t>> payloads(chunk_count);
+  pool.parallel_for(0, chunk_count, 1, [&](size_t first, size_t last) {
+    for (size_t c = first; c < last; c++) {
+      size_t begin = c * chunk;
+      size_t end = std::min<size_t>(begin + chunk, count);
+
+      std::vector<uint8_t>& out = payloads[c];
+      out.reserve((end - begin) * 8);
+      uint64_t previous_code = 0;
+      std::array<uint32_t, FIELDS> previous{};
+      for (size_t i = begin; i < end; i++) {
+        uint32_t index = order[i];
+        put_varint(out, codes[index] - previous_code);
+        previous_code = codes[index];
+
+        const auto& q = quantized[index];
+        for (uint32_t field = 0; field < FIELDS; field++) {
+          put_varint(out, zigzag(static_cast<int64_t>(q[field]) - previous[field]));
+        }
+        previous = q;
+      }
+    }
+  });
+
+  std::vector<uint8_t> bytes(sizeof(EncodedHeader) + sizeof(ChunkEntry) * chunk_count);
+  std::memcpy(bytes.data(), &header, sizeof(EncodedHeader));
+  for (uint32_t c = 0; c < chunk_count; c++) {
+    ChunkEntry entry = {std::min(chunk, count - c * chunk), static_cast<uint32_t>(payloads[c].size())};
+    std::memcpy(bytes.data() + sizeof(EncodedHeader) + sizeof(ChunkEntry) * c, &entry, sizeof(ChunkEntry));
+  }
+  for (const auto& payload : payloads) {
+    bytes.insert(bytes.end(), payload.begin(), payload.end());
+  }
+  return bytes;
+}
+
+FramePoints FrameCodec::decode(const std::vector<uint8_t>& bytes, ThreadPool& pool) {
+  return decode(bytes.data(), bytes.size(), pool);
+}
+
+FramePoints FrameCodec::decode(const uint8_t* bytes, size_t size, ThreadPool& pool) {
+  EncodedHeader header;
+  if (size < sizeof(EncodedHeader)) {
+    throw std::runtime_error("Encoded frame is too short");
+  }
+  std::memcpy(&header, bytes, sizeof(EncodedHeader));
+  if (std::memcmp(header.magic, "FSQ1", 4) != 0 || header.version != VERSION) {
+    throw std::runtime_error("Not an encoded frame, or an unsupported version");
+  }
+  if (header.position_bits < MIN_POSITION_BITS || header.position_bits > MAX_POSITION_BITS ||
+      header.velocity_bits < MIN_VALUE_BITS || header.velocity_bits > MAX_VALUE_BITS ||
+      header.density_bits < MIN_VALUE_BITS || header.density_bits > MAX_VALUE_BITS) {
+    throw std::runtime_error("Encoded frame has an invalid precision");
+  }
+  Steps steps(header);
+
+  size_t table_end = sizeof(EncodedHeader) + sizeof(ChunkEntry) * static_cast<size_t>(header.chunk_count);
+  if (size < table_end) {
+    throw std::runtime_error("Encoded frame is missing its chunk table");
+  }
+
+  std::vector<ChunkEntry> entries(header.chunk_count);
+  std::vector<size_t> offsets(header.chunk_count);
+  std::vector<size_t> firsts(header.chunk_count);
+  size_t offset = table_end;
+  size_t first = 0;
+  for (uint32_t c = 0; c < header.chunk_count; c++) {
+    std::memcpy(&entries[c], bytes + sizeof(EncodedHeader) + sizeof(ChunkEntry) * c, sizeof(ChunkEntry));
+    offsets[c] = offset;
+    firsts[c] = first;
+    offset += entries[c].bytes;
+    first += entries[c].count;
+  }
+  if (offset > size || first != header.count) {
+    throw std::runtime_error("Encoded frame chunk table does not match its size");
+  }
+
+  float position_step[3];
+  for (int axis = 0; axis < 3; axis++) {
+    position_step[axis] = (header.position_max[axis] - header.position_min[axis]) / steps.position;
+  }
+  float velocity_step = header.velocity_range / steps.velocity;
+  float density_step = header.density_range / steps.density;
+
+  FramePoints frame;
+  frame.values.resize(static_cast<size_t>(header.count) * 8);
+
+  pool.parallel_for(0, header.chunk_count, 1, [&](size_t begin, size_t end) {
+    for (size_t c = begin; c < end; c++) {
+      const uint8_t* at = bytes + offsets[c];
+      const uint8_t* stop = at + entries[c].bytes;
+
+      uint64_t code = 0;
+      std::array<int64_t, FIELDS> q{};
+      for (size_t i = firsts[c]; i < firsts[c] + entries[c].count; i++) {
+        code += get_varint(at, stop);
+        for (uint32_t field = 0; field < FIELDS; field++) {
+          q[field] += unzigzag(get_varint(at, stop));
+        }
+
+        float* p = frame.values.data() + i * 8;
+        for (int axis = 0; axis < 3; axis++) {
+          p[axis] = header.position_min[axis] + compact(code >> axis) * position_step[axis];
+          p[4 + axis] = -header.velocity_range + q[axis] * velocity_step;
+        }
+        p[3] = q[3] * density_step;
+        p[7] = 0.0f;
+      }
+    }
+  });
+
+  return frame;
+}
+
+FramePoints FrameCodec::read(const std::string& path, ThreadPool& pool) {
+  MappedFile file(path);
+  return decode(file.data(), file.size(), pool);
+}
@@ -0,0 +1,44 @@
+#include "MappedFile.hpp"
+
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& path) {
+  int descriptor = open(path.c_str(), O_RDONLY);
+  if (descriptor < 0) {
+    throw std::runtime_error("Unable to open " + path);
+  }
+
+  struct stat info;
+  if (fstat(descriptor, &info) != 0) {
+    close(descriptor);
+    throw std::runtime_error("Unable to read the size of " + path);
+  }
+  length = static_cast<size_t>(info.st_size);
+
+  // Nothing to map, data() stays null
+  if (length == 0) {
+    close(descriptor);
+    return;
+  }
+
+  mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+  close(descriptor);
+  if (mapped == MAP_FAILED) {
+    mapped = nullptr;
+    throw std::runtime_error("Unable to map " + path);
+  }
+
+  // Every reader here walks the file front to back once
+  madvise(mapped, length, MADV_SEQUENTIAL);
+}
+
+MappedFile::~MappedFile() {
+  if (mapped) {
+    munmap(mapped, length);
+  }
+}
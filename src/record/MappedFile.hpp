@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only mapping of a whole file, unmapped on destruction
+class MappedFile {
+
+  public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data() const { return static_cast<const uint8_t*>(mapped); }
+    size_t size() const { return length; }
+
+  private:
+    void* mapped = nullptr;
+    size_t length = 0;
+};
@@ -0,0 +1,81 @@
+#include "Recording.hpp"
+#include "MappedFile.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+Recording::Recording(const std::string& directory) {
+  if (!std::filesystem::is_directory(directory)) {
+    throw std::runtime_error("No recording at " + directory);
+  }
+
+  for (const auto& file : std::filesystem::directory_iterator(directory)) {
+    std::string name = file.path().filename().string();
+    std::string extension = file.path().extension().string();
+    if (name.rfind("frame_", 0) != 0 || (extension != ".bin" && extension != ".fsq")) {
+      continue;
+    }
+
+    Entry entry;
+    try {
+      entry.frame = std::stoull(name.substr(6, name.size() - 6 - extension.size()));
+    } catch (const std::exception&) {
+      continue;
+    }
+    entry.path = file.path().string();
+    entry.encoded = extension == ".fsq";
+
+    // Both formats lead with enough to know the count
+    std::ifstream stream(entry.path, std::ios::binary);
+    if (entry.encoded) {
+      EncodedHeader header{};
+      stream.read(reinterpret_cast<char*>(&header), sizeof(EncodedHeader));
+      entry.count = header.count;
+    } else {
+      entry.count = 0;
+      stream.read(reinterpret_cast<char*>(&entry.count), sizeof(uint32_t));
+    }
+    if (!stream) {
+      throw std::runtime_error("Unable to read the frame header of " + entry.path);
+    }
+
+    largest = std::max(largest, entry.count);
+    entries.push_back(entry);
+  }
+
+  if (entries.empty()) {
+    throw std::runtime_error("No raw or fsq frames in " + directory);
+  }
+
+  std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+    return a.frame < b.frame;
+  });
+}
+
+size_t Recording::find(uint64_t frame) const {
+  auto after = std::upper_bound(entries.begin(), entries.end(), frame, [](uint64_t value, const Entry& entry) {
+    return value < entry.frame;
+  });
+  return after == entries.begin() ? 0 : static_cast<size_t>(after - entries.begin() - 1);
+}
+
+void Recording::read(size_t index, FramePoints& frame, ThreadPool& pool) const {
+  const Entry& entry = entries[index];
+  MappedFile file(entry.path);
+
+  if (entry.encoded) {
+    frame = FrameCodec::decode(file.data(), file.size(), pool);
+    return;
+  }
+
+  size_t floats = static_cast<size_t>(entry.count) * 8;
+  if (file.size() < sizeof(uint32_t) + floats * sizeof(float)) {
+    throw std::runtime_error("Frame " + entry.path + " is truncated");
+  }
+
+  frame.values.resize(floats);
+  std::memcpy(frame.values.data(), file.data() + sizeof(uint32_t), floats * sizeof(float));
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "FrameCodec.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Index of the frames an export run wrote to one directory, raw and fsq
+// frames only. Frame numbers count every exported step, so gaps left by
+// dropped frames keep the timing of the rest.
+class Recording {
+
+  public:
+    struct Entry {
+      uint64_t frame;
+      std::string path;
+      bool encoded;
+      uint32_t count;
+    };
+
+    explicit Recording(const std::string& directory);
+
+    size_t size() const { return entries.size(); }
+    const Entry& entry(size_t index) const { return entries[index]; }
+    // Most particles in any one frame, what the buffers need room for
+    uint32_t max_count() const { return largest; }
+
+    // Last entry at or before the frame number, the first when there is none
+    size_t find(uint64_t frame) const;
+
+    // Eight floats per particle as FramePoints holds them, read from the mapped file
+    void read(size_t index, FramePoints& frame, ThreadPool& pool) const;
+
+  private:
+    std::vector<Entry> entries;
+    uint32_t largest = 0;
+};
@@ -0,0 +1,181 @@
+#include "Replayer.hpp"
+#include "../system/SimulationBackend.hpp"
+
+#include <vulkan/vulkan_core.h>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+
+Replayer::Replayer(VkDevice device, VkPhysicalDevice physical_device, const std::string& directory) : recording(directory), slots(SLOTS) {
+  for (auto& slot : slots) {
+    slot.buffer = std::make_unique<HostBuffer>(
+      device,
+      physical_device,
+      sizeof(FluidData) * std::max(recording.max_count(), 1u),
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+    );
+    slot.buffer->map();
+  }
+
+  playhead = static_cast<double>(recording.entry(0).frame);
+  std::cout << "Replaying " << recording.size() << " frames from " << directory << ", up to " << recording.max_count() << " particles" << '\n';
+
+  loader = std::thread(&Replayer::loader_loop, this);
+}
+
+Replayer::~Replayer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_one();
+  loader.join();
+}
+
+void Replayer::update(Window& window, float delta_time) {
+  bool pause_key = window.pressed(GLFW_KEY_P);
+  if (pause_key && !pause_held) {
+    paused = !paused;
+  }
+  pause_held = pause_key;
+
+  double first = static_cast<double>(recording.entry(0).frame);
+  double last = static_cast<double>(recording.entry(recording.size() - 1).frame);
+
+  double speed = paused ? 0.0 : 1.0;
+  if (window.pressed(GLFW_KEY_LEFT)) speed = -4.0;
+  if (window.pressed(GLFW_KEY_RIGHT)) speed = 4.0;
+
+  playhead += delta_time * frame_rate * speed;
+  if (window.pressed(GLFW_KEY_HOME)) playhead = first;
+  if (playhead > last + 1.0 && speed == 1.0) playhead = first;
+  playhead = std::clamp(playhead, first, last + 1.0);
+
+  size_t entry = recording.find(static_cast<uint64_t>(std::floor(playhead)));
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (entry == wanted) {
+      return;
+    }
+    wanted = entry;
+  }
+  wake.notify_one();
+}
+
+Replayer::Slot* Replayer::free_slot() {
+  for (auto& slot : slots) {
+    if (slot.state == State::free) return &slot;
+  }
+  return nullptr;
+}
+
+void Replayer::loader_loop() {
+  FramePoints frame;
+
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    wake.wait(lock, [&] { return stopping || (wanted != loaded && free_slot() != nullptr); });
+    if (stopping) {
+      return;
+    }
+
+    Slot* slot = free_slot();
+    size_t entry = wanted;
+    slot->state = State::loading;
+    lock.unlock();
+
+    uint32_t count = 0;
+    try {
+      recording.read(entry, frame, pool);
+      count = static_cast<uint32_t>(std::min<size_t>(frame.count(), recording.max_count()));
+    } catch (const std::exception& error) {
+      std::cerr << error.what() << '\n';
+    }
+
+    // The draw reads FluidData, velocity.w stays zero so nothing counts as removed
+    FluidData* target = static_cast<FluidData*>(slot->buffer->map());
+    const float* values = frame.values.data();
+    pool.parallel_for(0, count, 16384, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        const float* p = values + i * 8;
+        target[i].position = {p[0], p[1], p[2], 0.0f};
+        target[i].velocity = {p[4], p[5], p[6], 0.0f};
+        target[i].predicted_position = {p[0], p[1], p[2], p[3]};
+      }
+    });
+
+    lock.lock();
+    // An older frame nobody copied yet is stale now
+    for (auto& other : slots) {
+      if (other.state == State::ready) other.state = State::free;
+    }
+    slot->state = State::ready;
+    slot->entry = entry;
+    slot->count = count;
+    loaded = entry;
+  }
+}
+
+void Replayer::record(VkCommandBuffer commandbuffer, VkBuffer particles, VkBuffer draw_arguments) {
+  Slot* ready = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    records++;
+
+    // The renderer waited on this command buffer's fence, so copies recorded
+    // a full round of frames ago are done
+    for (auto& slot : slots) {
+      if (slot.state == State::in_flight && slot.release <= records) slot.state = State::free;
+      if (slot.state == State::ready) ready = &slot;
+    }
+
+    if (ready) {
+      ready->state = State::in_flight;
+      ready->release = records + Swapchain::MAX_FRAMES_IN_FLIGHT;
+    }
+  }
+  wake.notify_one();
+
+  if (!ready) {
+    return;
+  }
+
+  // Earlier frames may still be drawing from the particle buffer
+  VkMemoryBarrier draw_barrier{};
+  draw_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  draw_barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+  draw_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+    VK_PIPELINE_STAGE_TRANSFER_BIT,
+    0,
+    1, &draw_barrier,
+    0, nullptr,
+    0, nullptr
+  );
+
+  if (ready->count > 0) {
+    VkBufferCopy copy{};
+    copy.size = sizeof(FluidData) * ready->count;
+    vkCmdCopyBuffer(commandbuffer, ready->buffer->buffer, particles, 1, &copy);
+  }
+  vkCmdUpdateBuffer(commandbuffer, draw_arguments, offsetof(VkDrawIndexedIndirectCommand, instanceCount), sizeof(uint32_t), &ready->count);
+
+  VkMemoryBarrier upload_barrier{};
+  upload_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  upload_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  upload_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_TRANSFER_BIT,
+    VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+    0,
+    1, &upload_barrier,
+    0, nullptr,
+    0, nullptr
+  );
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Recording.hpp"
+#include "../buffer/HostBuffer.hpp"
+#include "../context/Window.hpp"
+#include "../renderpass/Swapchain.hpp"
+#include "../system/cpu/ThreadPool.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Replayer {
+
+  public:
+    // Plays a recording back through the particle buffer vertex.vert reads,
+    // in place of the simulation step. A loader thread maps the wanted frame,
+    // decodes it if needed and expands it into one of a few persistently
+    // mapped staging buffers. Each rendered frame copies the newest finished
+    // one on the GPU, so neither the loader nor the renderer waits on the
+    // other and a slow frame only shows the previous one a little longer.
+    Replayer(VkDevice device, VkPhysicalDevice physical_device, const std::string& directory);
+    ~Replayer();
+
+    Replayer(const Replayer&) = delete;
+    Replayer& operator=(const Replayer&) = delete;
+
+    // Particles in the largest frame, the scene needs at least this capacity
+    uint32_t capacity() const { return recording.max_count(); }
+
+    // P pauses, holding the left or right arrow scrubs at four times speed,
+    // Home rewinds. Playback loops at the end.
+    void update(Window& window, float delta_time);
+    void record(VkCommandBuffer commandbuffer, VkBuffer particles, VkBuffer draw_arguments);
+
+    // Empty turns replay off
+    inline static std::string directory;
+    // Recorded frames shown per second, the export interval is already in the frame numbers
+    inline static float frame_rate = 60.0f;
+
+  private:
+    enum class State { free, loading, ready, in_flight };
+
+    struct Slot {
+      std::unique_ptr<HostBuffer> buffer;
+      State state = State::free;
+      size_t entry = 0;
+      uint32_t count = 0;
+      // Record call from which the GPU copy has certainly finished
+      uint64_t release = 0;
+    };
+
+    // Each in flight frame can hold one, plus one loading and one ready
+    static constexpr uint32_t SLOTS = Swapchain::MAX_FRAMES_IN_FLIGHT + 2;
+    static constexpr size_t NONE = SIZE_MAX;
+
+    void loader_loop();
+    Slot* free_slot();
+
+    Recording recording;
+    ThreadPool pool;
+    std::vector<Slot> slots;
+
+    double playhead = 0.0;
+    bool paused = false;
+    bool pause_held = false;
+    uint64_t records = 0;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    size_t wanted = 0;
+    // Entry of the last finished load
+    size_t loaded = NONE;
+    bool stopping = false;
+    std::thread loader;
+};
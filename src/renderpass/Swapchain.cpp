@@ -176,7 +176,12 @@ VkExtent2D Swapchain::choose_swap_extent(const VkSurfaceCapabilitiesKHR& capabil
 
 
 VkResult Swapchain::acquire_image(uint32_t* index, uint32_t current_frame) {
-  vkWaitForFences(device, 1, &in_flight_fences[current_frame], VK_TRUE, UINT64_MAX);
+  {
+    TraceScope scope(trace, "fence wait");
+    vkWaitForFences(device, 1, &in_flight_fences[current_frame], VK_TRUE, UINT64_MAX);
+  }
+
+  TraceScope scope(trace, "acquire image");
   auto result = vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, available_images[current_frame], VK_NULL_HANDLE, index); 
   return result;
 }
@@ -198,8 +203,11 @@ VkResult Swapchain::submit_command(VkCommandBuffer command_buffer, uint32_t curr
   submitInfo.pSignalSemaphores = finished_render_image;
 
   vkResetFences(device, 1, &in_flight_fences[current_frame]);
-  if (vkQueueSubmit(queue, 1, &submitInfo, in_flight_fences[current_frame]) != VK_SUCCESS) {
-    throw std::runtime_error("Unable to submit command to queue");
+  {
+    TraceScope scope(trace, "queue submit");
+    if (vkQueueSubmit(queue, 1, &submitInfo, in_flight_fences[current_frame]) != VK_SUCCESS) {
+      throw std::runtime_error("Unable to submit command to queue");
+    }
   }
 
   VkPresentInfoKHR presentInfo{};
@@ -212,6 +220,7 @@ VkResult Swapchain::submit_command(VkCommandBuffer command_buffer, uint32_t curr
   presentInfo.pSwapchains = swapChains;
   presentInfo.pImageIndices = image_index;
 
+  TraceScope scope(trace, "present");
   auto result = vkQueuePresentKHR(queue, &presentInfo);
 
   return result;
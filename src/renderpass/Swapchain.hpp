@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../context/VulkanContext.hpp"
+#include "../profiler/Trace.hpp"
 
 class Swapchain {
 
@@ -24,6 +25,9 @@ class Swapchain {
 
     inline static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
 
+    // Times the fence wait, acquire, submit and present when set
+    Trace* trace = nullptr;
+
   private:
 
     void create_swapchain(Window& window);
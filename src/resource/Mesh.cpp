@@ -1,6 +1,6 @@
 #include "Mesh.hpp"
 
-#include "../buffer/HostBuffer.hpp"
+#include "../command/UploadManager.hpp"
 #include <iostream>
 
 Mesh::Mesh(
@@ -17,15 +17,6 @@ Mesh::Mesh(
 void Mesh::create_vertex_buffer(Entity& entity, CommandPool& command_pool) {
   VkDeviceSize size = sizeof(entity.vertices[0]) * entity.vertices.size();
 
-  HostBuffer staging(
-    device, 
-    physical_device, 
-    size, 
-    VK_BUFFER_USAGE_TRANSFER_SRC_BIT
-  );
-
-  staging.fillData(entity.vertices.data(), size); 
-
   vertex_buffer = std::make_unique<Buffer>(
     device, 
     physical_device, 
@@ -34,21 +25,13 @@ void Mesh::create_vertex_buffer(Entity& entity, CommandPool& command_pool) {
     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
   );
 
-  vertex_buffer->copyBuffer(staging, command_pool);
+  command_pool.uploads().upload(vertex_buffer->buffer, 0, entity.vertices.data(), size);
 }
 
 void Mesh::create_index_buffer(Entity& entity, CommandPool& command_pool) {
   VkDeviceSize size = sizeof(entity.indices[0]) * entity.indices.size();
   index_count = static_cast<uint32_t>(entity.indices.size());
 
-  HostBuffer staging(
-    device, 
-    physical_device, 
-    size, 
-    VK_BUFFER_USAGE_TRANSFER_SRC_BIT
-  );
-  staging.fillData(entity.indices.data(), size); 
-
   index_buffer = std::make_unique<Buffer>(
     device, 
     physical_device, 
@@ -57,7 +40,7 @@ void Mesh::create_index_buffer(Entity& entity, CommandPool& command_pool) {
     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
   );
 
-  index_buffer->copyBuffer(staging, command_pool);
+  command_pool.uploads().upload(index_buffer->buffer, 0, entity.indices.data(), size);
 }
 
 void Mesh::bind(VkCommandBuffer commandbuffer) {
@@ -71,3 +54,7 @@ void Mesh::bind(VkCommandBuffer commandbuffer) {
 void Mesh::draw(VkCommandBuffer commandbuffer) {
   vkCmdDrawIndexed(commandbuffer, index_count, instances, 0, 0, 0);
 }
+
+void Mesh::draw_indirect(VkCommandBuffer commandbuffer, VkBuffer arguments) {
+  vkCmdDrawIndexedIndirect(commandbuffer, arguments, 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+}
@@ -12,6 +12,8 @@ class Mesh {
 
     void bind(VkCommandBuffer commandbuffer);
     void draw(VkCommandBuffer commandbuffer);
+    void draw_indirect(VkCommandBuffer commandbuffer, VkBuffer arguments);
+    uint32_t get_index_count() const { return index_count; }
     uint32_t instances;
 
   private:
@@ -1,5 +1,6 @@
 
 #include "Camera.hpp"
+#include "../renderpass/Swapchain.hpp"
 #include <iostream>
 #include <vulkan/vulkan_core.h>
 
@@ -9,10 +10,11 @@ Camera::Camera(
   DescriptorBuilder& builder
 ) : device(device), physical_device(physical_device) {
 
-  buffer = std::make_unique<HostBuffer>(device, physical_device, sizeof(CameraData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+  ring = std::make_unique<UniformRing>(device, physical_device, sizeof(CameraData), Swapchain::MAX_FRAMES_IN_FLIGHT);
+  ring->write_all(&data);
 
   builder.clear();
-  builder.bind_buffer(0, VK_SHADER_STAGE_VERTEX_BIT, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, buffer->get_info());
+  builder.bind_buffer(0, VK_SHADER_STAGE_VERTEX_BIT, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, ring->get_info());
   builder.build(set, layout); 
 
 }
@@ -51,8 +53,6 @@ void Camera::update(Window& window, float delta_time) {
   if (window.pressed(GLFW_KEY_SPACE)) position += up * speed * delta_time;
   if (window.pressed(GLFW_KEY_LEFT_SHIFT)) position -= up * speed * delta_time;
 
-  CameraData data{};  
-
   data.model = glm::mat4(1.0f); 
   data.view = glm::lookAt(position, front + position , up);
 
@@ -61,11 +61,13 @@ void Camera::update(Window& window, float delta_time) {
   data.proj = glm::perspective(glm::radians(45.0f), width / (float) height, 0.1f, 500.0f);
   data.proj[1][1] *= -1;
 
-  buffer->fillData(&data, sizeof(data));
-
   window.reset_cursor_position();
 }
 
+void Camera::upload(uint32_t frame) {
+  offset = ring->write(frame, &data);
+}
+
 void Camera::bind_camera(VkCommandBuffer commandbuffer, Pipeline& pipeline, VkPipelineBindPoint bind_point) {  
-  pipeline.bind_descriptor_sets(commandbuffer, bind_point, 1, 1, &set);
+  pipeline.bind_descriptor_sets(commandbuffer, bind_point, 1, 1, &set, 1, &offset);
 }
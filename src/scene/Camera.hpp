@@ -1,7 +1,7 @@
 
 #pragma once
 
-#include "../buffer/HostBuffer.hpp"
+#include "../buffer/UniformRing.hpp"
 #include "../context/Window.hpp"
 #include "../descriptors/DescriptorBuilder.hpp"
 #include "../pipeline/Pipeline.hpp"
@@ -25,7 +25,10 @@ class Camera {
     Camera(VkDevice device, VkPhysicalDevice physical_device, DescriptorBuilder& builder);
 
     void bind_camera(VkCommandBuffer commandbuffer, Pipeline& pipeline, VkPipelineBindPoint bind_point);
+    // Moves the camera, the matrices reach the GPU with upload
     void update(Window& window, float delta_time);
+    // Writes the matrices into this frame's slot, after its fence has signalled
+    void upload(uint32_t frame);
 
     double yaw = 70;
     double pitch = 20;
@@ -39,6 +42,8 @@ class Camera {
     VkPhysicalDevice physical_device;
     uint32_t binding;
 
-    std::unique_ptr<HostBuffer> buffer;
+    std::unique_ptr<UniformRing> ring;
+    CameraData data{};
+    uint32_t offset = 0;
     VkDescriptorSet set;
 };
@@ -4,14 +4,174 @@
 #include "Camera.hpp"
 #include "entities/Sphere.hpp"
 #include "entities/Cube.hpp"
+#include "entities/Model.hpp"
+#include "entities/Box.hpp"
+#include "../pipeline/PipelineCompiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
 #include <memory>
 
+static std::unique_ptr<Entity> boundary_entity(const BoundaryMesh& boundary) {
+  if (boundary.shape == "box") return std::make_unique<Box>();
+  if (boundary.shape == "sphere") return std::make_unique<Sphere>(1.0f);
+  return std::make_unique<Model>(boundary.path);
+}
+
 void Scene::init(VulkanContext& context, DescriptorBuilder& builder) {
-  fluid_system = std::make_unique<FluidSystem>(context.device, context.physical_device, builder, Scene::instances); 
-  fluid_system->init_data(context.get_commandpool(), context.physical_device);
+  uint32_t capacity = std::max(Scene::instances, Scene::max_instances);
+  if (!Replayer::directory.empty()) {
+    replayer = std::make_unique<Replayer>(context.device, context.physical_device, Replayer::directory);
+    capacity = std::max(capacity, replayer->capacity());
+  }
+
+  // The meshes' bounds are known before the buffers are, the lattice over
+  // them is the most the fill can place
+  MeshFill fill(context.device, context.physical_device);
+  if (!replayer && restore.empty()) {
+    for (const auto& mesh : fill_meshes) {
+      Model model(mesh.path);
+      fill.add_mesh(builder, model, mesh.transform, mesh.velocity);
+    }
+    if (!fill.empty()) {
+      capacity = static_cast<uint32_t>(std::min<uint64_t>(std::max<uint64_t>(capacity, fill.lattice_points()), UINT32_MAX));
+    }
+  }
+
+  fluid_system = std::make_unique<FluidSystem>(context.device, context.physical_device, builder, capacity); 
+  // Every compute pipeline is queued by now, build them together before the first use
+  PipelineCompiler::compile();
+  if (replayer) {
+    // Nothing to draw until the first frame lands
+    fluid_system->load_particles(context.get_commandpool(), {});
+  } else if (!fill.empty()) {
+    auto start = std::chrono::steady_clock::now();
+    uint32_t layout_seed = seed ? *seed : std::random_device{}();
+    fluid_system->fill_particles(context.get_commandpool(), builder, fill, layout_seed);
+    uint32_t live = fluid_system->read_counts(context.get_commandpool()).live;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Filled " << fill_meshes.size() << " meshes with " << live << " particles in " << seconds << " s" << '\n';
+  } else if (restore.empty()) {
+    uint32_t layout_seed = seed ? *seed : std::random_device{}();
+    fluid_system->init_data(context.get_commandpool(), context.physical_device, Scene::instances, layout_seed, blocks);
+  } else {
+    auto start = std::chrono::steady_clock::now();
+    MappedCheckpoint checkpoint(restore);
+    fluid_system->load_checkpoint(context.get_commandpool(), checkpoint);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Restored " << checkpoint.header().live << " particles at step " << checkpoint.header().step << " from " << restore << " in " << seconds << " s" << '\n';
+  }
+
+  // A checkpoint brings its own box, replay has none
+  if (boundary && restore.empty() && !replayer) {
+    fluid_system->set_boundary(*boundary);
+  }
+
+  if (cpu_simulation) {
+    cpu_system = std::make_unique<CpuFluidSystem>(capacity);
+    cpu_system->load_particles(context.get_commandpool(), fluid_system->read_particles(context.get_commandpool()));
+    cpu_system->set_boundary(fluid_system->get_boundary());
+    // A restored checkpoint carries its step on
+    cpu_system->start_at(fluid_system->read_counts(context.get_commandpool()).step);
+  }
+
+  for (const auto& emitter : emitters) {
+    fluid_system->add_emitter(emitter);
+  }
+  for (const auto& sink : sinks) {
+    fluid_system->add_sink(sink);
+  }
+
+  for (const auto& boundary : boundary_meshes) {
+    std::unique_ptr<Entity> mesh = boundary_entity(boundary);
+    fluid_system->add_boundary_mesh(*mesh, boundary.transform, boundary.container);
+  }
+  fluid_system->bake_boundary(context.get_commandpool(), builder);
+
+  for (const auto& body : rigid_bodies) {
+    fluid_system->add_rigid_body(body);
+  }
+  fluid_system->upload_rigid_bodies(context.get_commandpool());
 
   camera = std::make_unique<Camera>(context.device, context.physical_device, builder);
 
   entities.emplace_back(std::make_unique<Sphere>());
 }
 
+
+void Scene::begin_frame(uint32_t frame) {
+  camera->upload(frame);
+  fluid_system->begin_frame(frame);
+}
+
+void Scene::step(CommandPool& commandpool, VkCommandBuffer commandbuffer) {
+  if (replayer) {
+    replayer->record(commandbuffer, fluid_system->particle_buffer(), fluid_system->draw_arguments());
+    return;
+  }
+
+  if (!cpu_system) {
+    fluid_system->run(commandpool, commandbuffer);
+    return;
+  }
+
+  // The particle buffers only feed the draw, so upload the host step into
+  // them, keeping the device step counter for checkpoints and emitter seeds
+  cpu_system->run(commandpool, commandbuffer);
+  fluid_system->load_particles(commandpool, cpu_system->read_particles(commandpool), cpu_system->steps());
+}
+
+SimulationBackend& Scene::simulation() {
+  if (cpu_system) {
+    return *cpu_system;
+  }
+  return *fluid_system;
+}
+
+void Scene::save_checkpoint(CommandPool& commandpool) {
+  // Both would rename over the same file
+  fluid_system->flush_checkpoints();
+
+  CheckpointHeader header = fluid_system->checkpoint_header();
+  BoxBoundary boundary = simulation().get_boundary();
+  float faces[6] = {boundary.front, boundary.back, boundary.bottom, boundary.top, boundary.right, boundary.left};
+  std::copy(faces, faces + 6, header.boundary);
+
+  std::vector<FluidData> particles = simulation().read_particles(commandpool);
+  header.step = fluid_system->read_counts(commandpool).step;
+  header.live = static_cast<uint32_t>(particles.size());
+
+  Checkpoint::write(Checkpointer::path, header, particles.data());
+  std::cout << "Checkpoint of " << header.live << " particles written to " << Checkpointer::path << '\n';
+}
+
+void Scene::grow(CommandPool& commandpool, DescriptorBuilder& builder) {
+  // Only the GPU backend has emitters to fill the buffers
+  if (replayer || cpu_system || grow_limit <= fluid_system->capacity()) {
+    return;
+  }
+
+  // The readback trails by the frames in flight, so grow with an eighth to spare
+  uint64_t capacity = fluid_system->capacity();
+  if (static_cast<uint64_t>(fluid_system->occupied()) * 8 < capacity * 7) {
+    return;
+  }
+  reserve(commandpool, builder, static_cast<uint32_t>(std::min<uint64_t>(capacity * 2, grow_limit)));
+}
+
+void Scene::reserve(CommandPool& commandpool, DescriptorBuilder& builder, uint32_t capacity) {
+  // Replay sizes the buffers for the largest recorded frame up front
+  if (replayer || capacity <= fluid_system->capacity()) {
+    return;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  fluid_system->reserve(commandpool, builder, capacity);
+  if (cpu_system) {
+    cpu_system->reserve(capacity);
+  }
+  double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "Grew the particle capacity to " << capacity << " in " << milliseconds << " ms" << '\n';
+}
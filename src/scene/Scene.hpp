@@ -2,20 +2,75 @@
 #pragma once
 
 #include "../system/FluidSystem.hpp"
+#include "../system/CpuFluidSystem.hpp"
 #include "../context/VulkanContext.hpp"
+#include "../record/Replayer.hpp"
 #include "Camera.hpp"
 #include "Entity.hpp"
 
 #include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+struct BoundaryMesh {
+  std::string path;
+  // Built-in "box" or "sphere" with a half extent of 1, used when path is empty
+  std::string shape;
+  glm::mat4 transform = glm::mat4(1.0f);
+  // Keeps fluid inside the mesh instead of outside
+  bool container = false;
+};
+
+struct FillMesh {
+  std::string path;
+  glm::mat4 transform = glm::mat4(1.0f);
+  glm::vec3 velocity = glm::vec3(0.0f);
+};
 
 struct Scene {
+  // Particles at startup, emitters can grow this up to max_instances
   inline static uint32_t instances = 30000;
+  inline static uint32_t max_instances = 30000;
+  // Emitters grow the particle buffers up to this many, doubling whenever
+  // they run nearly full. Zero keeps the starting capacity.
+  inline static uint32_t grow_limit = 0;
+  // Where the starting particles go, the default block when empty
+  inline static std::vector<FluidBlock> blocks;
+  // Box faces to start from, unset keeps FluidSystem's default box
+  inline static std::optional<BoxBoundary> boundary;
+  inline static std::vector<ParticleEmitter> emitters;
+  inline static std::vector<ParticleSink> sinks;
+  inline static std::vector<BoundaryMesh> boundary_meshes;
+  // Meshes whose insides become the starting particles, replacing instances
+  inline static std::vector<FillMesh> fill_meshes;
+  inline static std::vector<RigidBodyDesc> rigid_bodies;
+  // Unset draws a fresh layout every run
+  inline static std::optional<uint32_t> seed;
+  // Step on the host with CpuFluidSystem, the GPU only draws the particles
+  inline static bool cpu_simulation = false;
+  // Checkpoint to start from instead of a fresh layout, empty for none
+  inline static std::string restore;
 
   void init(VulkanContext& context, DescriptorBuilder& builder);
+  // Camera and boundary uniforms for the frame slot whose fence was just waited on
+  void begin_frame(uint32_t frame);
+  void step(CommandPool& commandpool, VkCommandBuffer commandbuffer);
+  SimulationBackend& simulation();
+  // Writes the current state to Checkpointer::path, the device must be idle
+  void save_checkpoint(CommandPool& commandpool);
+  // Doubles the capacity once emitters have nearly filled it, up to
+  // grow_limit. Waits for the device when it grows, call it between frames.
+  void grow(CommandPool& commandpool, DescriptorBuilder& builder);
+  // Room for capacity particles in both backends, the current ones carry over
+  void reserve(CommandPool& commandpool, DescriptorBuilder& builder, uint32_t capacity);
   // void update(Window& window, double delta_time);
 
   std::vector<std::unique_ptr<Entity>> entities;
   std::unique_ptr<FluidSystem> fluid_system;
+  std::unique_ptr<CpuFluidSystem> cpu_system;
+  // Set when Replayer::directory is, the step then plays frames back instead
+  std::unique_ptr<Replayer> replayer;
   std::unique_ptr<Camera> camera;
   std::unique_ptr<CommandPool> commandpool;
 
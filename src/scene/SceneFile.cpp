@@ -0,0 +1,418 @@
+#include "SceneFile.hpp"
+#include "Scene.hpp"
+#include "../system/Solver.hpp"
+#include "../system/subsystem/MeshFill.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+static std::string trim(const std::string& text) {
+  size_t begin = text.find_first_not_of(" \t\r");
+  if (begin == std::string::npos) {
+    return "";
+  }
+  size_t end = text.find_last_not_of(" \t\r");
+  return text.substr(begin, end - begin + 1);
+}
+
+// Everything from a # outside a string on
+static std::string strip_comment(const std::string& line) {
+  bool quoted = false;
+  for (size_t i = 0; i < line.size(); i++) {
+    if (line[i] == '\\' && quoted) {
+      i++;
+    } else if (line[i] == '"') {
+      quoted = !quoted;
+    } else if (line[i] == '#' && !quoted) {
+      return line.substr(0, i);
+    }
+  }
+  return line;
+}
+
+static bool valid_key(const std::string& key) {
+  if (key.empty() || key.front() == '.' || key.back() == '.' || key.find("..") != std::string::npos) {
+    return false;
+  }
+  for (char c : key) {
+    bool bare = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '-' || c == '.';
+    if (!bare) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static double parse_number(const std::string& text, const std::string& where) {
+  // TOML allows 1_000_000
+  std::string digits;
+  for (char c : text) {
+    if (c != '_') digits += c;
+  }
+
+  size_t end = 0;
+  double result = 0.0;
+  try {
+    result = std::stod(digits, &end);
+  } catch (const std::exception&) {
+    end = 0;
+  }
+
+  if (digits.empty() || end != digits.size() || !std::isfinite(result)) {
+    throw std::runtime_error(where + ": expected a number, got '" + text + "'");
+  }
+  return result;
+}
+
+SceneFile::Value SceneFile::parse_value(const std::string& text, const std::string& where) {
+  Value value;
+
+  if (text.empty()) {
+    throw std::runtime_error(where + ": missing value");
+  }
+
+  if (text.front() == '"') {
+    value.type = Value::Type::string;
+    size_t i = 1;
+    for (; i < text.size() && text[i] != '"'; i++) {
+      if (text[i] != '\\') {
+        value.text += text[i];
+        continue;
+      }
+      if (++i >= text.size()) break;
+      switch (text[i]) {
+        case 'n': value.text += '\n'; break;
+        case 't': value.text += '\t'; break;
+        default: value.text += text[i]; break;
+      }
+    }
+    if (i + 1 != text.size()) {
+      throw std::runtime_error(where + ": unterminated string or text after it");
+    }
+    return value;
+  }
+
+  if (text == "true" || text == "false") {
+    value.type = Value::Type::boolean;
+    value.boolean = text == "true";
+    return value;
+  }
+
+  if (text.front() == '[') {
+    if (text.back() != ']') {
+      throw std::runtime_error(where + ": arrays have to close on the same line");
+    }
+    value.type = Value::Type::array;
+
+    std::string items = text.substr(1, text.size() - 2);
+    size_t start = 0;
+    while (start <= items.size()) {
+      size_t comma = items.find(',', start);
+      std::string item = trim(items.substr(start, comma == std::string::npos ? std::string::npos : comma - start));
+      // A trailing comma leaves one empty item at the end
+      if (!item.empty()) {
+        value.array.push_back(parse_number(item, where));
+      } else if (comma != std::string::npos) {
+        throw std::runtime_error(where + ": empty array item");
+      }
+      if (comma == std::string::npos) break;
+      start = comma + 1;
+    }
+    return value;
+  }
+
+  value.type = Value::Type::number;
+  value.number = parse_number(text, where);
+  return value;
+}
+
+SceneFile SceneFile::load(const std::string& path) {
+  std::ifstream file(path);
+  if (!file) {
+    throw std::runtime_error("Could not open scene file " + path);
+  }
+
+  SceneFile scene;
+  std::string prefix;
+  Table* entry = nullptr;
+
+  std::string line;
+  for (uint32_t number = 1; std::getline(file, line); number++) {
+    std::string where = path + ":" + std::to_string(number);
+    line = trim(strip_comment(line));
+    if (line.empty()) {
+      continue;
+    }
+
+    if (line.rfind("[[", 0) == 0) {
+      if (line.size() < 4 || line.compare(line.size() - 2, 2, "]]") != 0) {
+        throw std::runtime_error(where + ": expected [[name]]");
+      }
+      std::string name = trim(line.substr(2, line.size() - 4));
+      if (!valid_key(name)) {
+        throw std::runtime_error(where + ": bad table name '" + name + "'");
+      }
+      scene.entries.emplace_back(name, Table{});
+      entry = &scene.entries.back().second;
+      continue;
+    }
+
+    if (line.front() == '[') {
+      if (line.back() != ']') {
+        throw std::runtime_error(where + ": expected [name]");
+      }
+      prefix = trim(line.substr(1, line.size() - 2));
+      if (!valid_key(prefix)) {
+        throw std::runtime_error(where + ": bad table name '" + prefix + "'");
+      }
+      entry = nullptr;
+      continue;
+    }
+
+    size_t equals = line.find('=');
+    if (equals == std::string::npos) {
+      throw std::runtime_error(where + ": expected key = value");
+    }
+    std::string key = trim(line.substr(0, equals));
+    if (!valid_key(key)) {
+      throw std::runtime_error(where + ": bad key '" + key + "'");
+    }
+
+    Table& table = entry ? *entry : scene.values;
+    std::string full = entry || prefix.empty() ? key : prefix + "." + key;
+    if (table.count(full)) {
+      throw std::runtime_error(where + ": " + full + " is set twice");
+    }
+    table[full] = parse_value(trim(line.substr(equals + 1)), where);
+  }
+
+  return scene;
+}
+
+void SceneFile::set(const std::string& assignment) {
+  size_t equals = assignment.find('=');
+  std::string key = trim(assignment.substr(0, equals));
+  if (equals == std::string::npos || !valid_key(key)) {
+    throw std::runtime_error("--set expects key=value, got '" + assignment + "'");
+  }
+  values[key] = parse_value(trim(assignment.substr(equals + 1)), "--set " + key);
+}
+
+static double number(const SceneFile::Value& value, const std::string& key) {
+  if (value.type != SceneFile::Value::Type::number) {
+    throw std::runtime_error(key + " expects a number");
+  }
+  return value.number;
+}
+
+static uint32_t whole(const SceneFile::Value& value, const std::string& key) {
+  double result = number(value, key);
+  if (result < 0.0 || result > UINT32_MAX || std::floor(result) != result) {
+    throw std::runtime_error(key + " expects an unsigned integer");
+  }
+  return static_cast<uint32_t>(result);
+}
+
+static glm::vec3 vector(const SceneFile::Value& value, const std::string& key) {
+  if (value.type != SceneFile::Value::Type::array || value.array.size() != 3) {
+    throw std::runtime_error(key + " expects [x, y, z]");
+  }
+  return glm::vec3(value.array[0], value.array[1], value.array[2]);
+}
+
+static bool flag(const SceneFile::Value& value, const std::string& key) {
+  if (value.type != SceneFile::Value::Type::boolean) {
+    throw std::runtime_error(key + " expects true or false");
+  }
+  return value.boolean;
+}
+
+static std::string text(const SceneFile::Value& value, const std::string& key) {
+  if (value.type != SceneFile::Value::Type::string) {
+    throw std::runtime_error(key + " expects a string");
+  }
+  return value.text;
+}
+
+// translate, rotate and scale of the [[*.mesh]] tables. Rotation is in
+// degrees about x, then y, then z, scale is one number or [x, y, z].
+struct MeshPlacement {
+  glm::vec3 translate = glm::vec3(0.0f);
+  glm::vec3 rotate = glm::vec3(0.0f);
+  glm::vec3 scale = glm::vec3(1.0f);
+
+  // False for keys that are not part of the placement
+  bool read(const std::string& key, const SceneFile::Value& value, const std::string& table) {
+    if (key == "translate") translate = vector(value, table + ".translate");
+    else if (key == "rotate") rotate = vector(value, table + ".rotate");
+    else if (key == "scale") scale = value.type == SceneFile::Value::Type::number ? glm::vec3(static_cast<float>(value.number)) : vector(value, table + ".scale");
+    else return false;
+    return true;
+  }
+
+  glm::mat4 matrix() const {
+    glm::mat4 transform = glm::translate(glm::mat4(1.0f), translate);
+    transform = glm::rotate(transform, glm::radians(rotate.z), glm::vec3(0.0f, 0.0f, 1.0f));
+    transform = glm::rotate(transform, glm::radians(rotate.y), glm::vec3(0.0f, 1.0f, 0.0f));
+    transform = glm::rotate(transform, glm::radians(rotate.x), glm::vec3(1.0f, 0.0f, 0.0f));
+    return glm::scale(transform, scale);
+  }
+};
+
+void SceneFile::apply() const {
+  SphConstants constants = Solver::constants;
+  // The box FluidSystem::init_boundary starts from, faces the file leaves out keep it
+  BoxBoundary boundary{5.0f, -5.0f, 5.0f, -5.0f, 5.0f, -5.0f};
+  bool domain = false;
+
+  for (const auto& [key, value] : values) {
+    float* face = nullptr;
+    if (key == "domain.front") face = &boundary.front;
+    else if (key == "domain.back") face = &boundary.back;
+    else if (key == "domain.bottom") face = &boundary.bottom;
+    else if (key == "domain.top") face = &boundary.top;
+    else if (key == "domain.right") face = &boundary.right;
+    else if (key == "domain.left") face = &boundary.left;
+
+    if (face) {
+      *face = static_cast<float>(number(value, key));
+      domain = true;
+    } else if (key == "particles.count") {
+      Scene::instances = whole(value, key);
+    } else if (key == "particles.capacity") {
+      Scene::max_instances = whole(value, key);
+    } else if (key == "particles.grow_to") {
+      Scene::grow_limit = whole(value, key);
+    } else if (key == "particles.seed") {
+      Scene::seed = whole(value, key);
+    } else if (key == "solver.smoothing_radius") {
+      constants.smoothing_radius = static_cast<float>(number(value, key));
+    } else if (key == "solver.mass") {
+      constants.mass = static_cast<float>(number(value, key));
+    } else if (key == "solver.target_density") {
+      constants.target_density = static_cast<float>(number(value, key));
+    } else if (key == "solver.pressure_multiplier") {
+      constants.pressure_multiplier = static_cast<float>(number(value, key));
+    } else if (key == "solver.gravity") {
+      constants.gravity = static_cast<float>(number(value, key));
+    } else if (key == "solver.time_step") {
+      constants.time_step = static_cast<float>(number(value, key));
+    } else if (key == "solver.rest_steps") {
+      Solver::rest_steps = whole(value, key);
+    } else if (key == "solver.rest_velocity") {
+      Solver::rest_velocity = static_cast<float>(number(value, key));
+    } else if (key == "solver.rest_density") {
+      Solver::rest_density = static_cast<float>(number(value, key));
+    } else if (key == "hash.table_cells") {
+      constants.table_cells = whole(value, key);
+    } else if (key == "fill.spacing") {
+      MeshFill::spacing = static_cast<float>(number(value, key));
+    } else if (key == "fill.jitter") {
+      MeshFill::jitter = static_cast<float>(number(value, key));
+    } else if (key == "fill.resolution") {
+      MeshFill::resolution = whole(value, key);
+    } else {
+      throw std::runtime_error("Unknown scene key " + key);
+    }
+  }
+
+  Solver::validate(constants);
+  Solver::constants = constants;
+  if (domain) {
+    Scene::boundary = boundary;
+  }
+  if (!(Solver::rest_velocity >= 0.0f) || !(Solver::rest_density >= 0.0f)) {
+    throw std::runtime_error("solver.rest_velocity and solver.rest_density can't be negative");
+  }
+  if (!(MeshFill::spacing > 0.0f) || MeshFill::resolution < 2) {
+    throw std::runtime_error("fill.spacing has to be positive and fill.resolution at least 2");
+  }
+
+  for (const auto& [name, table] : entries) {
+    if (name == "block") {
+      FluidBlock block{};
+      for (const auto& [key, value] : table) {
+        if (key == "minimum") block.minimum = vector(value, "block.minimum");
+        else if (key == "maximum") block.maximum = vector(value, "block.maximum");
+        else if (key == "velocity") block.velocity = vector(value, "block.velocity");
+        else throw std::runtime_error("Unknown scene key block." + key);
+      }
+      Scene::blocks.push_back(block);
+    } else if (name == "fill.mesh") {
+      FillMesh mesh{};
+      MeshPlacement placement;
+      for (const auto& [key, value] : table) {
+        if (key == "path") mesh.path = text(value, "fill.mesh.path");
+        else if (key == "velocity") mesh.velocity = vector(value, "fill.mesh.velocity");
+        else if (!placement.read(key, value, "fill.mesh")) throw std::runtime_error("Unknown scene key fill.mesh." + key);
+      }
+      if (mesh.path.empty()) {
+        throw std::runtime_error("[[fill.mesh]] needs a path");
+      }
+      mesh.transform = placement.matrix();
+      Scene::fill_meshes.push_back(mesh);
+    } else if (name == "boundary.mesh") {
+      BoundaryMesh mesh{};
+      MeshPlacement placement;
+      for (const auto& [key, value] : table) {
+        if (key == "path") mesh.path = text(value, "boundary.mesh.path");
+        else if (key == "shape") mesh.shape = text(value, "boundary.mesh.shape");
+        else if (key == "container") mesh.container = flag(value, "boundary.mesh.container");
+        else if (!placement.read(key, value, "boundary.mesh")) throw std::runtime_error("Unknown scene key boundary.mesh." + key);
+      }
+      if (mesh.path.empty() == mesh.shape.empty()) {
+        throw std::runtime_error("[[boundary.mesh]] needs either a path or a shape");
+      }
+      if (!mesh.shape.empty() && mesh.shape != "box" && mesh.shape != "sphere") {
+        throw std::runtime_error("boundary.mesh.shape is box or sphere, got '" + mesh.shape + "'");
+      }
+      mesh.transform = placement.matrix();
+      Scene::boundary_meshes.push_back(mesh);
+    } else if (name == "emitter") {
+      ParticleEmitter emitter{};
+      for (const auto& [key, value] : table) {
+        if (key == "position") emitter.position = vector(value, "emitter.position");
+        else if (key == "radius") emitter.radius = static_cast<float>(number(value, "emitter.radius"));
+        else if (key == "velocity") emitter.velocity = vector(value, "emitter.velocity");
+        else if (key == "rate") emitter.rate = whole(value, "emitter.rate");
+        else throw std::runtime_error("Unknown scene key emitter." + key);
+      }
+      if (!(emitter.radius > 0.0f) || emitter.rate > 256) {
+        throw std::runtime_error("[[emitter]] needs a positive radius and a rate of at most 256");
+      }
+      Scene::emitters.push_back(emitter);
+    } else if (name == "sink") {
+      ParticleSink sink{};
+      for (const auto& [key, value] : table) {
+        if (key == "minimum") sink.minimum = vector(value, "sink.minimum");
+        else if (key == "maximum") sink.maximum = vector(value, "sink.maximum");
+        else throw std::runtime_error("Unknown scene key sink." + key);
+      }
+      Scene::sinks.push_back(sink);
+    } else if (name == "body") {
+      RigidBodyDesc body{};
+      for (const auto& [key, value] : table) {
+        if (key == "shape") {
+          std::string shape = text(value, "body.shape");
+          if (shape == "sphere") body.shape = RigidShape::Sphere;
+          else if (shape == "box") body.shape = RigidShape::Box;
+          else throw std::runtime_error("body.shape is sphere or box, got '" + shape + "'");
+        }
+        else if (key == "position") body.position = vector(value, "body.position");
+        else if (key == "velocity") body.velocity = vector(value, "body.velocity");
+        else if (key == "half_extent") body.half_extent = value.type == Value::Type::number ? glm::vec3(static_cast<float>(value.number)) : vector(value, "body.half_extent");
+        else if (key == "density") body.density = static_cast<float>(number(value, "body.density"));
+        else throw std::runtime_error("Unknown scene key body." + key);
+      }
+      if (!(body.density >= 0.0f) || !(glm::min(body.half_extent.x, glm::min(body.half_extent.y, body.half_extent.z)) > 0.0f)) {
+        throw std::runtime_error("[[body]] needs a positive half_extent and a density of at least 0");
+      }
+      Scene::rigid_bodies.push_back(body);
+    } else {
+      throw std::runtime_error("Unknown scene table [[" + name + "]]");
+    }
+  }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+// A scene description in a small subset of TOML: [table] and [[array]]
+// headers, key = value lines with numbers, strings, true/false or arrays of
+// numbers, and # comments. Values are kept by their dotted path, solver.mass
+// for mass under [solver], until apply writes them into the settings the
+// Scene, FluidSystem and shaders are built from.
+//
+//   [particles]
+//   count = 200000
+//   [solver]
+//   smoothing_radius = 0.15
+//   [[block]]
+//   minimum = [-2, -4, -2]
+//   maximum = [2, 0, 2]
+class SceneFile {
+
+  public:
+    struct Value {
+      enum class Type { number, string, boolean, array };
+
+      Type type = Type::number;
+      double number = 0.0;
+      std::string text;
+      bool boolean = false;
+      std::vector<double> array;
+    };
+
+    using Table = std::map<std::string, Value>;
+
+    static SceneFile load(const std::string& path);
+
+    // key.path=value, with the value written as it would be in the file. Only
+    // plain keys, entries of [[array]] tables come from the file.
+    void set(const std::string& assignment);
+
+    // Throws on unknown keys and values of the wrong type, so a typo in a
+    // scaling run fails at startup instead of running the default scene
+    void apply() const;
+
+  private:
+    static Value parse_value(const std::string& text, const std::string& where);
+
+    Table values;
+    // [[name]] entries in file order, each with its own keys
+    std::vector<std::pair<std::string, Table>> entries;
+};
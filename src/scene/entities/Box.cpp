@@ -0,0 +1,34 @@
+#include "Box.hpp"
+
+Box::Box() {
+  load_mesh();
+}
+
+void Box::load_mesh() {
+  const glm::vec3 normals[6] = {
+    { 1, 0, 0}, {-1, 0, 0},
+    { 0, 1, 0}, { 0,-1, 0},
+    { 0, 0, 1}, { 0, 0,-1},
+  };
+
+  for (const auto& normal : normals) {
+    // Two axes spanning the face
+    glm::vec3 u = glm::vec3(normal.y, normal.z, normal.x);
+    glm::vec3 v = glm::cross(normal, u);
+
+    uint32_t first = static_cast<uint32_t>(vertices.size());
+
+    vertices.push_back({normal - u - v, {0.6f, 0.6f, 0.6f}, normal, {0, 0}});
+    vertices.push_back({normal + u - v, {0.6f, 0.6f, 0.6f}, normal, {1, 0}});
+    vertices.push_back({normal + u + v, {0.6f, 0.6f, 0.6f}, normal, {1, 1}});
+    vertices.push_back({normal - u + v, {0.6f, 0.6f, 0.6f}, normal, {0, 1}});
+
+    indices.push_back(first);
+    indices.push_back(first + 1);
+    indices.push_back(first + 2);
+
+    indices.push_back(first);
+    indices.push_back(first + 2);
+    indices.push_back(first + 3);
+  }
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "../Entity.hpp"
+
+// Solid unit box, half extent of 1 along every axis
+class Box : public Entity {
+
+  public:
+    Box();
+
+  private:
+    void load_mesh() override;
+
+};
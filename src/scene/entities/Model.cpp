@@ -0,0 +1,50 @@
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+
+#include "Model.hpp"
+
+#include <stdexcept>
+
+Model::Model(const std::string& path) : path(path) {
+  load_mesh();
+}
+
+void Model::load_mesh() {
+  tinyobj::ObjReader reader;
+
+  if (!reader.ParseFromFile(path)) {
+    throw std::runtime_error("Unable to load model " + path + ": " + reader.Error());
+  }
+
+  const tinyobj::attrib_t& attrib = reader.GetAttrib();
+
+  for (const auto& shape : reader.GetShapes()) {
+    for (const auto& index : shape.mesh.indices) {
+      Vertex vertex{};
+      vertex.position = {
+        attrib.vertices[3 * index.vertex_index + 0],
+        attrib.vertices[3 * index.vertex_index + 1],
+        attrib.vertices[3 * index.vertex_index + 2]
+      };
+      vertex.color = {0.6f, 0.6f, 0.6f};
+
+      if (index.normal_index >= 0) {
+        vertex.normal = {
+          attrib.normals[3 * index.normal_index + 0],
+          attrib.normals[3 * index.normal_index + 1],
+          attrib.normals[3 * index.normal_index + 2]
+        };
+      }
+
+      if (index.texcoord_index >= 0) {
+        vertex.uv = {
+          attrib.texcoords[2 * index.texcoord_index + 0],
+          1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
+        };
+      }
+
+      indices.push_back(static_cast<uint32_t>(vertices.size()));
+      vertices.push_back(vertex);
+    }
+  }
+}
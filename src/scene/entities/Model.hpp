@@ -0,0 +1,16 @@
+#pragma once
+
+#include "../Entity.hpp"
+
+#include <string>
+
+class Model : public Entity {
+
+  public:
+    Model(const std::string& path);
+
+  private:
+    void load_mesh() override;
+
+    std::string path;
+};
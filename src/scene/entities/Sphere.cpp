@@ -8,12 +8,11 @@
 
 #include "Sphere.hpp"
 
-Sphere::Sphere() {
+Sphere::Sphere(float radius) : radius(radius) {
   load_mesh();
 }
 
 void Sphere::load_mesh() {
-  float radius = 0.1f;
   uint32_t stacks = 32;
   uint32_t slices = 32;
 
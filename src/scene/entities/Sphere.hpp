@@ -5,9 +5,11 @@
 class Sphere : public Entity {
   
   public:
-    Sphere();
+    Sphere(float radius = 0.1f);
 
   private:
     void load_mesh() override;
 
+    float radius;
+
 };
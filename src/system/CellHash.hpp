@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+
+// Host copy of shaders/include/hash.glsl, so the CPU backend files every
+// cell under the same key as the shaders. Taken unsigned there and here.
+inline uint32_t cell_key(int32_t x, int32_t y, int32_t z, uint32_t cells) {
+  // Wrapping multiply like the shaders, signed overflow would be undefined here
+  uint32_t hash = (static_cast<uint32_t>(x) * 73856093u) ^ (static_cast<uint32_t>(y) * 19349663u) ^ (static_cast<uint32_t>(z) * 83492791u);
+  return hash % cells;
+}
@@ -0,0 +1,305 @@
+#include "CpuFluidSystem.hpp"
+#include "CellHash.hpp"
+
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+static const float damping = 0.95f;
+static const float viscosity_strength = 0.8f;
+
+void CpuFluidSystem::Particles::resize(size_t size) {
+  for (auto* values : {&x, &y, &z, &vx, &vy, &vz, &px, &py, &pz, &rest, &density}) {
+    values->resize(size, 0.0f);
+  }
+}
+
+CpuFluidSystem::CpuFluidSystem(uint32_t instance_count, size_t thread_count) : instance_count(instance_count) {
+  pool = std::make_unique<ThreadPool>(thread_count);
+
+  state.resize(instance_count);
+  sorted.resize(instance_count);
+  density.assign(instance_count, 0.0f);
+  keys.assign(instance_count, 0);
+  cell_start.assign(table_cells, 0);
+  cell_end.assign(table_cells, 0);
+
+  density_run = Kernels::density_run();
+  pressure_run = Kernels::pressure_run();
+
+  front = 5.0;
+  back = -5.0;
+  bottom = 5.0;
+  top = -5.0;
+  right = 5.0;
+  left = -5.0;
+}
+
+void CpuFluidSystem::reserve(uint32_t capacity) {
+  if (capacity <= instance_count) {
+    return;
+  }
+
+  // Particles keep their slots, everything else is rebuilt every step
+  instance_count = capacity;
+  state.resize(instance_count);
+  sorted.resize(instance_count);
+  density.resize(instance_count, 0.0f);
+  keys.resize(instance_count, 0);
+}
+
+uint32_t CpuFluidSystem::get_key(float x, float y, float z) const {
+  int32_t grid_x = static_cast<int32_t>(std::floor(x / constants.smoothing_radius));
+  int32_t grid_y = static_cast<int32_t>(std::floor(y / constants.smoothing_radius));
+  int32_t grid_z = static_cast<int32_t>(std::floor(z / constants.smoothing_radius));
+  return cell_key(grid_x, grid_y, grid_z, static_cast<uint32_t>(table_cells));
+}
+
+void CpuFluidSystem::predict_positions() {
+  pool->parallel_for(0, live_count, grain, [this](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      state.px[i] = state.x[i] + state.vx[i] * constants.time_step;
+      state.py[i] = state.y[i] + state.vy[i] * constants.time_step;
+      state.pz[i] = state.z[i] + state.vz[i] * constants.time_step;
+      keys[i] = get_key(state.px[i], state.py[i], state.pz[i]);
+    }
+  });
+}
+
+void CpuFluidSystem::sort_by_cell() {
+  // Counting sort: a histogram per chunk, one scan over (key, chunk), then every
+  // chunk scatters to its own offsets so equal keys keep their order
+  size_t chunk_size = std::max<size_t>(grain, (live_count + pool->size() - 1) / pool->size());
+  sort_chunks = std::max<size_t>((live_count + chunk_size - 1) / chunk_size, 1);
+  histogram.assign(sort_chunks * table_cells, 0);
+
+  pool->parallel_for(0, sort_chunks, 1, [&](size_t begin, size_t end) {
+    for (size_t chunk = begin; chunk < end; chunk++) {
+      uint32_t* counts = histogram.data() + chunk * table_cells;
+      size_t first = chunk * chunk_size;
+      size_t last = std::min<size_t>(first + chunk_size, live_count);
+      for (size_t i = first; i < last; i++) {
+        counts[keys[i]]++;
+      }
+    }
+  });
+
+  uint32_t offset = 0;
+  for (int key = 0; key < table_cells; key++) {
+    cell_start[key] = offset;
+    for (size_t chunk = 0; chunk < sort_chunks; chunk++) {
+      uint32_t count = histogram[chunk * table_cells + key];
+      histogram[chunk * table_cells + key] = offset;
+      offset += count;
+    }
+    cell_end[key] = offset;
+  }
+
+  pool->parallel_for(0, sort_chunks, 1, [&](size_t begin, size_t end) {
+    for (size_t chunk = begin; chunk < end; chunk++) {
+      uint32_t* offsets = histogram.data() + chunk * table_cells;
+      size_t first = chunk * chunk_size;
+      size_t last = std::min<size_t>(first + chunk_size, live_count);
+      for (size_t i = first; i < last; i++) {
+        uint32_t target = offsets[keys[i]]++;
+        sorted.x[target] = state.x[i];
+        sorted.y[target] = state.y[i];
+        sorted.z[target] = state.z[i];
+        sorted.vx[target] = state.vx[i];
+        sorted.vy[target] = state.vy[i];
+        sorted.vz[target] = state.vz[i];
+        sorted.px[target] = state.px[i];
+        sorted.py[target] = state.py[i];
+        sorted.pz[target] = state.pz[i];
+        sorted.rest[target] = state.rest[i];
+        sorted.density[target] = state.density[i];
+      }
+    }
+  });
+}
+
+void CpuFluidSystem::calculate_density() {
+  ParticleView view = {sorted.px.data(), sorted.py.data(), sorted.pz.data(), sorted.vx.data(), sorted.vy.data(), sorted.vz.data(), density.data()};
+  float self_density = constants.mass * Kernels::poly6(0.0f, constants);
+  float h = constants.smoothing_radius;
+
+  pool->parallel_for(0, live_count, grain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      uint32_t self = static_cast<uint32_t>(i);
+      float value = self_density;
+
+      // Same 27 lookups as the shader, a key hit twice is counted twice there too
+      for (int x = -1; x <= 1; x++) {
+        for (int y = -1; y <= 1; y++) {
+          for (int z = -1; z <= 1; z++) {
+            uint32_t key = get_key(view.x[i] + x * h, view.y[i] + y * h, view.z[i] + z * h);
+            value += density_run(view, cell_start[key], cell_end[key], self, constants);
+          }
+        }
+      }
+
+      density[i] = value;
+    }
+  });
+}
+
+void CpuFluidSystem::move_particles() {
+  ParticleView view = {sorted.px.data(), sorted.py.data(), sorted.pz.data(), sorted.vx.data(), sorted.vy.data(), sorted.vz.data(), density.data()};
+  float h = constants.smoothing_radius;
+
+  // Reads only the sorted arrays and writes state, which becomes cell ordered
+  pool->parallel_for(0, live_count, grain, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      uint32_t self = static_cast<uint32_t>(i);
+      float self_pressure = Kernels::density_to_pressure(density[i], constants);
+
+      PressureSum sum;
+      for (int x = -1; x <= 1; x++) {
+        for (int y = -1; y <= 1; y++) {
+          for (int z = -1; z <= 1; z++) {
+            uint32_t key = get_key(view.x[i] + x * h, view.y[i] + y * h, view.z[i] + z * h);
+            pressure_run(view, cell_start[key], cell_end[key], self, self_pressure, constants, sum);
+          }
+        }
+      }
+
+      float ax = (sum.pressure[0] + sum.viscosity[0] * viscosity_strength) / density[i];
+      float ay = (sum.pressure[1] + sum.viscosity[1] * viscosity_strength) / density[i] + constants.gravity;
+      float az = (sum.pressure[2] + sum.viscosity[2] * viscosity_strength) / density[i];
+
+      float vx = (sorted.vx[i] + ax * constants.time_step) * 0.995f;
+      float vy = (sorted.vy[i] + ay * constants.time_step) * 0.995f;
+      float vz = (sorted.vz[i] + az * constants.time_step) * 0.995f;
+
+      float x = sorted.x[i] + vx * constants.time_step;
+      float y = sorted.y[i] + vy * constants.time_step;
+      float z = sorted.z[i] + vz * constants.time_step;
+
+      if (x > right) {
+        x = right;
+        vx = -vx * damping;
+      } else if (x < left) {
+        x = left;
+        vx = -vx * damping;
+      }
+
+      if (y > bottom) {
+        y = bottom;
+        vy = -vy * damping;
+      } else if (y < top) {
+        y = top;
+        vy = -vy * damping;
+      }
+
+      if (z > front) {
+        z = front;
+        vz = -vz * damping;
+      } else if (z < back) {
+        z = back;
+        vz = -vz * damping;
+      }
+
+      // Rest counter kept in step with move.comp so a GPU reload keeps sleeping
+      float speed = std::sqrt(vx * vx + vy * vy + vz * vz);
+      float density_change = std::abs(density[i] - sorted.density[i]);
+      float rest = (speed < Solver::rest_velocity && density_change < Solver::rest_density) ? std::min(sorted.rest[i] + 1.0f, 65535.0f) : 0.0f;
+
+      state.x[i] = x;
+      state.y[i] = y;
+      state.z[i] = z;
+      state.vx[i] = vx;
+      state.vy[i] = vy;
+      state.vz[i] = vz;
+      state.px[i] = sorted.px[i];
+      state.py[i] = sorted.py[i];
+      state.pz[i] = sorted.pz[i];
+      state.rest[i] = rest;
+      state.density[i] = density[i];
+    }
+  });
+}
+
+void CpuFluidSystem::step() {
+  step_count++;
+  if (live_count == 0) {
+    return;
+  }
+
+  predict_positions();
+  sort_by_cell();
+  calculate_density();
+  move_particles();
+}
+
+void CpuFluidSystem::run(CommandPool& commandpool, VkCommandBuffer commandbuffer) {
+  step();
+}
+
+void CpuFluidSystem::init_data(CommandPool& commandpool, VkPhysicalDevice physical_device, uint32_t live_count, uint32_t seed, const std::vector<FluidBlock>& blocks) {
+  load_particles(commandpool, FluidBlock::place(blocks, std::min(live_count, instance_count), seed));
+}
+
+void CpuFluidSystem::load_particles(CommandPool& commandpool, const std::vector<FluidData>& particles) {
+  live_count = std::min(static_cast<uint32_t>(particles.size()), instance_count);
+
+  for (uint32_t i = 0; i < live_count; i++) {
+    const FluidData& data = particles[i];
+    state.x[i] = data.position.x;
+    state.y[i] = data.position.y;
+    state.z[i] = data.position.z;
+    state.vx[i] = data.velocity.x;
+    state.vy[i] = data.velocity.y;
+    state.vz[i] = data.velocity.z;
+    state.px[i] = data.predicted_position.x;
+    state.py[i] = data.predicted_position.y;
+    state.pz[i] = data.predicted_position.z;
+    state.rest[i] = data.velocity.w;
+    state.density[i] = data.predicted_position.w;
+  }
+}
+
+std::vector<FluidData> CpuFluidSystem::read_particles(CommandPool& commandpool) {
+  std::vector<FluidData> values(live_count);
+
+  for (uint32_t i = 0; i < live_count; i++) {
+    FluidData& data = values[i];
+    data.position = {state.x[i], state.y[i], state.z[i], 0.0f};
+    data.set_key(get_key(state.px[i], state.py[i], state.pz[i]));
+    data.velocity = {state.vx[i], state.vy[i], state.vz[i], state.rest[i]};
+    data.predicted_position = {state.px[i], state.py[i], state.pz[i], state.density[i]};
+  }
+
+  return values;
+}
+
+void CpuFluidSystem::set_boundary(float half_width, float half_height, float half_depth) {
+  front = half_depth;
+  back = -half_depth;
+  bottom = half_height;
+  top = -half_height;
+  right = half_width;
+  left = -half_width;
+}
+
+void CpuFluidSystem::set_boundary(const BoxBoundary& boundary) {
+  front = boundary.front;
+  back = boundary.back;
+  bottom = boundary.bottom;
+  top = boundary.top;
+  right = boundary.right;
+  left = boundary.left;
+}
+
+BoxBoundary CpuFluidSystem::get_boundary() const {
+  return {front, back, bottom, top, right, left};
+}
+
+void CpuFluidSystem::update_boundary(Window& window) {
+  if (window.pressed(GLFW_KEY_Z)) front += 0.05;
+  if (window.pressed(GLFW_KEY_X)) front -= 0.05;
+  if (window.pressed(GLFW_KEY_C)) back += 0.05;
+  if (window.pressed(GLFW_KEY_V)) back -= 0.05;
+  if (window.pressed(GLFW_KEY_B)) bottom += 0.05;
+  if (window.pressed(GLFW_KEY_N)) bottom -= 0.05;
+}
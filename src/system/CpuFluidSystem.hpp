@@ -0,0 +1,96 @@
+#pragma once
+
+#include "SimulationBackend.hpp"
+#include "cpu/ThreadPool.hpp"
+#include "cpu/Kernels.hpp"
+#include "Solver.hpp"
+
+#include <vector>
+#include <memory>
+
+// Host implementation of the core SPH step in move.comp: density, pressure,
+// viscosity, gravity and the box boundary. Mesh boundaries, rigid bodies,
+// sleeping and emitters stay GPU only.
+class CpuFluidSystem : public SimulationBackend {
+
+  public:
+    // thread_count zero uses every hardware thread
+    CpuFluidSystem(uint32_t instance_count, size_t thread_count = 0);
+
+    void init_data(CommandPool& commandpool, VkPhysicalDevice physical_device, uint32_t live_count, uint32_t seed, const std::vector<FluidBlock>& blocks) override;
+
+    std::vector<FluidData> read_particles(CommandPool& commandpool) override;
+    void load_particles(CommandPool& commandpool, const std::vector<FluidData>& particles) override;
+
+    void update_boundary(Window& window) override;
+    void set_boundary(float half_width, float half_height, float half_depth) override;
+    void set_boundary(const BoxBoundary& boundary) override;
+    BoxBoundary get_boundary() const override;
+
+    // Nothing is recorded, the step runs on the pool before returning
+    void run(CommandPool& commandpool, VkCommandBuffer commandbuffer) override;
+
+    // Room for capacity particles, the current ones stay as they are
+    void reserve(uint32_t capacity);
+
+    void step();
+    uint32_t count() const { return live_count; }
+
+    // Steps taken, carried on from start_at like the GPU step counter
+    uint32_t steps() const { return step_count; }
+    void start_at(uint32_t step) { step_count = step; }
+
+  private:
+    // Structure of arrays so the kernels load eight neighbours at once
+    struct Particles {
+      std::vector<float> x, y, z;
+      std::vector<float> vx, vy, vz;
+      std::vector<float> px, py, pz;
+      // velocity.w and predicted_position.w of FluidData
+      std::vector<float> rest;
+      std::vector<float> density;
+
+      void resize(size_t size);
+    };
+
+    void predict_positions();
+    void sort_by_cell();
+    void calculate_density();
+    void move_particles();
+
+    uint32_t get_key(float x, float y, float z) const;
+
+    uint32_t instance_count;
+    uint32_t live_count = 0;
+    uint32_t step_count = 0;
+
+    // Any order between steps, cell order after each move
+    Particles state;
+    Particles sorted;
+
+    std::vector<float> density;
+    std::vector<uint32_t> keys;
+
+    // [cell_start, cell_end) of every key in the sorted arrays
+    std::vector<uint32_t> cell_start;
+    std::vector<uint32_t> cell_end;
+
+    // One histogram row per sort chunk
+    std::vector<uint32_t> histogram;
+    size_t sort_chunks = 0;
+
+    std::unique_ptr<ThreadPool> pool;
+    SphConstants constants = Solver::constants;
+    Kernels::DensityRun density_run;
+    Kernels::PressureRun pressure_run;
+
+    const int table_cells = static_cast<int>(Solver::constants.table_cells);
+    const size_t grain = 1024;
+
+    float front;
+    float back;
+    float bottom;
+    float top;
+    float right;
+    float left;
+};
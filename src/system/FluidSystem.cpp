@@ -1,12 +1,19 @@
 
 #include "FluidSystem.hpp"
 #include "../buffer/HostBuffer.hpp"
+#include "../command/UploadManager.hpp"
+#include "Solver.hpp"
+#include "../renderpass/Swapchain.hpp"
 
 #include <random>
+#include <algorithm>
 #include <iostream>
 #include <cmath>
 #include <array>
 #include <limits>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
 #include <vulkan/vulkan_core.h>
 
 FluidSystem::FluidSystem(
@@ -16,6 +23,8 @@ FluidSystem::FluidSystem(
   uint32_t instance_count
 ) : device(device), physical_device(physical_device), instance_count(instance_count) {
 
+  check_limits(instance_count);
+
   particle_buffers.reserve(2);  
 
   for (size_t i = 0; i < 2; i++) {
@@ -52,11 +61,12 @@ FluidSystem::FluidSystem(
     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
   );
 
-  boundary_buffer = std::make_unique<HostBuffer>(
+  // The headless runner keeps fewer frames in flight than the swapchain
+  boundary_ring = std::make_unique<UniformRing>(
     device,
     physical_device,
-    sizeof(float)*6,
-    VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT
+    sizeof(BoxBoundary),
+    Swapchain::MAX_FRAMES_IN_FLIGHT
   );
 
   // For compute
@@ -84,38 +94,69 @@ FluidSystem::FluidSystem(
   builder.build(spatial_lookup_set, spatial_lookup_layout);
   builder.clear();
 
+  counters = std::make_unique<Counters>(device, physical_device);
+
   builder.bind_buffer(1, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, density_buffer->get_info());
+  builder.bind_buffer(2, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, counters->get_info());
   builder.build(density_set, density_layout);
   builder.clear();
 
-  builder.bind_buffer(1, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, boundary_buffer->get_info());
+  builder.bind_buffer(1, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, boundary_ring->get_info());
   builder.build(boundary_set, boundary_layout);
   builder.clear();
 
+  distance_field = std::make_unique<DistanceField>(device, physical_device, builder, 64);
+
+  rigid_bodies = std::make_unique<RigidBodies>(device, physical_device, RigidBodies::MAX_BODIES);
+  rigid_bodies->init(builder, boundary_layout);
+
+  population = std::make_unique<Population>(device, physical_device, instance_count);
+  population->init(builder, particle_layout);
+
   // Key descriptors 
   sort = std::make_unique<Sort>(device, physical_device, instance_count, sizeof(FluidData));
-  sort->init(builder, particle_layout, (instance_count / 256) + 1, 1, 1);
+  sort->init(builder, particle_layout, population->layout);
+
+  sleep = std::make_unique<Sleep>(device, physical_device, instance_count, table_cells);
+  sleep->init(builder, particle_layout, density_layout, population->layout, boundary_layout, rigid_bodies->layout);
+
+  exporter = std::make_unique<Exporter>(device, physical_device, instance_count);
+  exporter->init(builder, particle_layout, population->layout);
+
+  checkpointer = std::make_unique<Checkpointer>(device, physical_device, instance_count);
+  checkpointer->init();
 
   VkPushConstantRange particle_constant{};
   particle_constant.size = sizeof(uint32_t);
   particle_constant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
   spatial_pipeline = std::make_unique<ComputePipeline>(device, "shaders/vertex.spatial.comp.spv"); 
-  spatial_pipeline->create({particle_layout, spatial_lookup_layout}, {particle_constant});
+  spatial_pipeline->create({particle_layout, spatial_lookup_layout, population->layout}, {particle_constant}, Solver::specialization());
 
   position_pipline = std::make_unique<ComputePipeline>(device, "shaders/vertex.position.comp.spv");
-  position_pipline->create({position_layout, particle_layout}, {particle_constant});
+  position_pipline->create({position_layout, particle_layout, population->layout}, {particle_constant}, Solver::specialization());
 
   density_pipeline = std::make_unique<ComputePipeline>(device, "shaders/vertex.density.comp.spv");   
-  density_pipeline->create({particle_layout, density_layout, spatial_lookup_layout}, {particle_constant});
+  density_pipeline->create({particle_layout, density_layout, spatial_lookup_layout, sleep->active_layout}, {particle_constant}, Solver::specialization());
 
   move_pipeline = std::make_unique<ComputePipeline>(device, "shaders/vertex.move.comp.spv");
-  move_pipeline->create({particle_layout, particle_layout, density_layout, spatial_lookup_layout, boundary_layout}, {particle_constant});
+  move_pipeline->create({particle_layout, particle_layout, density_layout, spatial_lookup_layout, boundary_layout, sleep->active_layout, distance_field->layout, rigid_bodies->layout}, {particle_constant}, Solver::specialization());
+
+  counters->init(builder, particle_layout, density_layout, population->layout);
+  if (Counters::interval > 0) {
+    density_counted_pipeline = std::make_unique<ComputePipeline>(device, "shaders/vertex.density.comp.spv");
+    density_counted_pipeline->create({particle_layout, density_layout, spatial_lookup_layout, sleep->active_layout}, {particle_constant}, Solver::specialization(true));
+
+    move_counted_pipeline = std::make_unique<ComputePipeline>(device, "shaders/vertex.move.comp.spv");
+    move_counted_pipeline->create({particle_layout, particle_layout, density_layout, spatial_lookup_layout, boundary_layout, sleep->active_layout, distance_field->layout, rigid_bodies->layout}, {particle_constant}, Solver::specialization(true));
+  }
   
   init_boundary();
 };
 
 void FluidSystem::calculate_predicted_position(VkCommandBuffer commandbuffer) {
+  population->emit(commandbuffer, particle_set[read_index], particle_buffers[read_index].buffer);
+
   VkBufferCopy region{};
   region.size = sizeof(FluidData) * instance_count;
   vkCmdCopyBuffer(commandbuffer, particle_buffers[read_index].buffer, position_buffer->buffer, 1, &region);
@@ -139,11 +180,11 @@ void FluidSystem::calculate_predicted_position(VkCommandBuffer commandbuffer) {
   );
 
 
-  std::array<VkDescriptorSet, 2> sets = {position_set, particle_set[read_index]}; 
-  position_pipline->bind_descriptor_sets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, 0, 2, sets.data()); 
+  std::array<VkDescriptorSet, 3> sets = {position_set, particle_set[read_index], population->set}; 
+  position_pipline->bind_descriptor_sets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, 0, static_cast<uint32_t>(sets.size()), sets.data()); 
   position_pipline->bind_push_constants(commandbuffer, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(uint32_t), &instance_count);
   position_pipline->bind_pipeline(commandbuffer);
-  vkCmdDispatch(commandbuffer, (instance_count / 256) + 1, 1, 1);
+  population->dispatch_total(commandbuffer);
 
   VkBufferMemoryBarrier position_barrier{};
   position_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
@@ -165,7 +206,17 @@ void FluidSystem::calculate_predicted_position(VkCommandBuffer commandbuffer) {
 }
 
 void FluidSystem::update_spatial_lookup(VkCommandBuffer commandbuffer, CommandPool& commandpool) {
-  sort->run(commandpool, commandbuffer, particle_buffers[read_index].buffer);
+  sort_particles(commandbuffer, commandpool);
+  build_spatial_table(commandbuffer);
+}
+
+void FluidSystem::sort_particles(VkCommandBuffer commandbuffer, CommandPool& commandpool) {
+  sort->run(commandpool, commandbuffer, particle_buffers[read_index].buffer, population->set, population->count_buffer(), offsetof(PopulationCounts, total_x));
+}
+
+void FluidSystem::build_spatial_table(VkCommandBuffer commandbuffer) {
+  ProfileScope scope(profiler, commandbuffer, "spatial");
+  population->settle(commandbuffer);
   
   vkCmdFillBuffer(commandbuffer, spatial_lookup_buffer->buffer, 0, spatial_lookup_buffer->size, std::numeric_limits<uint32_t>::max());
 
@@ -188,11 +239,11 @@ void FluidSystem::update_spatial_lookup(VkCommandBuffer commandbuffer, CommandPo
   );
 
 
-  std::array<VkDescriptorSet, 2> sets = {particle_set[read_index], spatial_lookup_set};
+  std::array<VkDescriptorSet, 3> sets = {particle_set[read_index], spatial_lookup_set, population->set};
   spatial_pipeline->bind_descriptor_sets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, 0, static_cast<uint32_t>(sets.size()), sets.data());
   spatial_pipeline->bind_push_constants(commandbuffer, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(uint32_t), &instance_count);
   spatial_pipeline->bind_pipeline(commandbuffer);
-  vkCmdDispatch(commandbuffer, (instance_count / 256) + 1, 1, 1);
+  population->dispatch_live(commandbuffer);
 
   VkBufferMemoryBarrier barrier{};
   VkBufferMemoryBarrier position_barrier{};
@@ -216,12 +267,27 @@ void FluidSystem::update_spatial_lookup(VkCommandBuffer commandbuffer, CommandPo
 
 }
 
+void FluidSystem::update_active_particles(VkCommandBuffer commandbuffer) {
+  // Faces moved since the last step wake the particles resting against them
+  std::array<float, 6> faces = {front, back, bottom, top, right, left};
+  uint32_t moved = 0;
+  for (uint32_t i = 0; i < faces.size(); i++) {
+    if (faces[i] != stepped_faces[i]) moved |= 1u << i;
+  }
+  stepped_faces = faces;
+  sleep->wake_faces(moved);
+
+  sleep->run(commandbuffer, particle_set[read_index], particle_set[write_index], density_set, density_buffer->buffer, population->set, population->count_buffer(), offsetof(PopulationCounts, live_x), boundary_set, boundary_offset, rigid_bodies->set);
+}
+
 void FluidSystem::calculate_density(VkCommandBuffer commandbuffer){ 
-  std::array<VkDescriptorSet, 3> sets = { particle_set[read_index], density_set, spatial_lookup_set };
-  density_pipeline->bind_descriptor_sets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, 0, static_cast<uint32_t>(sets.size()), sets.data());
-  density_pipeline->bind_push_constants(commandbuffer, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(float), &instance_count);
-  density_pipeline->bind_pipeline(commandbuffer);
-  vkCmdDispatch(commandbuffer, (instance_count / 256) + 1, 1, 1);
+  ComputePipeline& pipeline = counting ? *density_counted_pipeline : *density_pipeline;
+
+  std::array<VkDescriptorSet, 4> sets = { particle_set[read_index], density_set, spatial_lookup_set, sleep->active_set };
+  pipeline.bind_descriptor_sets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, 0, static_cast<uint32_t>(sets.size()), sets.data());
+  pipeline.bind_push_constants(commandbuffer, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(float), &instance_count);
+  pipeline.bind_pipeline(commandbuffer);
+  sleep->dispatch(commandbuffer);
 
   VkBufferMemoryBarrier density_barrier{};
   density_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
@@ -245,13 +311,15 @@ void FluidSystem::calculate_density(VkCommandBuffer commandbuffer){
 }
 
 void FluidSystem::move_particles(VkCommandBuffer commandbuffer) {
+  // Sleeping particles were already carried into the write buffer by the compaction
+  std::array<VkDescriptorSet, 8> sets = {particle_set[read_index], particle_set[write_index], density_set, spatial_lookup_set, boundary_set, sleep->active_set, distance_field->set, rigid_bodies->set};
 
-  std::array<VkDescriptorSet, 5> sets = {particle_set[read_index], particle_set[write_index], density_set, spatial_lookup_set, boundary_set};
+  ComputePipeline& pipeline = counting ? *move_counted_pipeline : *move_pipeline;
 
-  move_pipeline->bind_descriptor_sets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, 0, static_cast<uint32_t>(sets.size()), sets.data());
-  move_pipeline->bind_push_constants(commandbuffer, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(uint32_t), &instance_count);
-  move_pipeline->bind_pipeline(commandbuffer);  
-  vkCmdDispatch(commandbuffer, (instance_count / 256) + 1, 1, 1);
+  pipeline.bind_descriptor_sets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, 0, static_cast<uint32_t>(sets.size()), sets.data(), 1, &boundary_offset);
+  pipeline.bind_push_constants(commandbuffer, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(uint32_t), &instance_count);
+  pipeline.bind_pipeline(commandbuffer);  
+  sleep->dispatch(commandbuffer);
 
   VkBufferMemoryBarrier move_barrier{};
   move_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
@@ -274,48 +342,165 @@ void FluidSystem::move_particles(VkCommandBuffer commandbuffer) {
   );
 }
 
+void FluidSystem::update_rigid_bodies(VkCommandBuffer commandbuffer) {
+  // Pressure forces on the bodies come from the move pass, so integrate after it
+  rigid_bodies->integrate(commandbuffer, boundary_set, boundary_offset);
+}
+
 void FluidSystem::run(CommandPool& commandpool, VkCommandBuffer commandbuffer) {
-  calculate_predicted_position(commandbuffer);
+  ProfileScope step_scope(profiler, commandbuffer, "simulation");
+
+  {
+    ProfileScope scope(profiler, commandbuffer, "predict");
+    calculate_predicted_position(commandbuffer);
+  }
+
   update_spatial_lookup(commandbuffer, commandpool);
-  calculate_density(commandbuffer); 
-  move_particles(commandbuffer);
+
+  // Spatial order is settled here, so the key runs can be measured before density
+  counting = counters->begin_step();
+  if (counting) {
+    ProfileScope scope(profiler, commandbuffer, "counters");
+    counters->reset(commandbuffer);
+    counters->occupancy(commandbuffer, particle_set[read_index], density_set, population->set, population->count_buffer(), offsetof(PopulationCounts, live_x));
+  }
+
+  {
+    ProfileScope scope(profiler, commandbuffer, "collisions");
+    rigid_bodies->detect_collisions(commandbuffer);
+  }
+
+  {
+    ProfileScope scope(profiler, commandbuffer, "sleep");
+    update_active_particles(commandbuffer);
+  }
+
+  {
+    ProfileScope scope(profiler, commandbuffer, "density");
+    calculate_density(commandbuffer); 
+  }
+
+  {
+    ProfileScope scope(profiler, commandbuffer, "move");
+    move_particles(commandbuffer);
+  }
+
+  if (counting) {
+    counters->read_back(commandbuffer);
+  }
+
+  {
+    ProfileScope scope(profiler, commandbuffer, "bodies");
+    update_rigid_bodies(commandbuffer);
+  }
+
+  {
+    ProfileScope scope(profiler, commandbuffer, "sinks");
+    population->remove(commandbuffer, particle_set[write_index], particle_buffers[write_index].buffer);
+  }
+
+  if (exporter->begin_step()) {
+    ProfileScope scope(profiler, commandbuffer, "export");
+    exporter->record(commandbuffer, particle_set[write_index], population->set, population->count_buffer(), offsetof(PopulationCounts, total_x));
+  }
+
+  if (checkpointer->begin_step()) {
+    ProfileScope scope(profiler, commandbuffer, "checkpoint");
+    checkpointer->record(commandbuffer, particle_buffers[write_index].buffer, population->count_buffer(), checkpoint_header());
+  }
+
+  population->read_back(commandbuffer);
 
   read_index = (read_index + 1) % 2;
   write_index = (write_index + 1) % 2;
 }
 
+std::vector<StageCapture> FluidSystem::capture_step(CommandPool& commandpool) {
+  // The counting shaders would change nothing here, keep the normal ones
+  counting = false;
 
-void FluidSystem::bind_particle(VkCommandBuffer commandbuffer, Pipeline& pipeline, VkPipelineBindPoint bind_point) {
-  pipeline.bind_descriptor_sets(commandbuffer, bind_point, 0, 1, &particle_set_graphics[read_index]);
-}
+  std::vector<StageCapture> captures;
+  auto particles = [&](uint32_t index) {
+    std::vector<FluidData> values(instance_count);
+    download(particle_buffers[index], values.data(), commandpool);
+    return values;
+  };
 
-void FluidSystem::init_data(CommandPool& commandpool, VkPhysicalDevice physical_device) {
-  VkDeviceSize size = sizeof(FluidData) * instance_count; 
+  VkCommandBuffer commandbuffer = commandpool.start_single_command();
+  calculate_predicted_position(commandbuffer);
+  commandpool.end_single_command(commandbuffer);
+  captures.push_back({"predict", particles(read_index), {}, {}});
+
+  // The key pass runs as the first step of the sort, keys land in position.w
+  commandbuffer = commandpool.start_single_command();
+  sort_particles(commandbuffer, commandpool);
+  commandpool.end_single_command(commandbuffer);
+  captures.push_back({"sort", particles(read_index), {}, {}});
+
+  commandbuffer = commandpool.start_single_command();
+  build_spatial_table(commandbuffer);
+  commandpool.end_single_command(commandbuffer);
+  StageCapture spatial{"spatial", {}, std::vector<uint32_t>(table_cells), {}};
+  download(*spatial_lookup_buffer, spatial.table.data(), commandpool);
+  captures.push_back(spatial);
+
+  commandbuffer = commandpool.start_single_command();
+  rigid_bodies->detect_collisions(commandbuffer);
+  update_active_particles(commandbuffer);
+  calculate_density(commandbuffer);
+  commandpool.end_single_command(commandbuffer);
+  StageCapture density{"density", {}, {}, std::vector<float>(instance_count)};
+  download(*density_buffer, density.density.data(), commandpool);
+  captures.push_back(density);
+
+  commandbuffer = commandpool.start_single_command();
+  move_particles(commandbuffer);
+  commandpool.end_single_command(commandbuffer);
+  captures.push_back({"move", particles(write_index), {}, {}});
 
+  commandbuffer = commandpool.start_single_command();
+  update_rigid_bodies(commandbuffer);
+  population->remove(commandbuffer, particle_set[write_index], particle_buffers[write_index].buffer);
+  commandpool.end_single_command(commandbuffer);
+
+  read_index = (read_index + 1) % 2;
+  write_index = (write_index + 1) % 2;
+
+  return captures;
+}
+
+void FluidSystem::download(Buffer& source, void* values, CommandPool& commandpool) {
   HostBuffer staging(
-    device, 
-    physical_device, 
-    size, 
-    VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+    device,
+    physical_device,
+    source.size,
+    VK_BUFFER_USAGE_TRANSFER_DST_BIT
   );
 
-  std::vector<FluidData> values;
-  values.reserve(instance_count);
+  staging.copyBuffer(source, commandpool);
+  staging.getData(values);
+}
 
-  std::random_device rd;
-  std::mt19937 gen(rd());
-  std::uniform_real_distribution<float> height(-5.0f, 0.0f);
-  std::uniform_real_distribution<float> width(-2.5f, 2.5f);
-  for (int i = 0; i < instance_count; ++i) {
-    float x = width(gen);
-    float y = height(gen);
-    float z = width(gen);
 
+void FluidSystem::bind_particle(VkCommandBuffer commandbuffer, Pipeline& pipeline, VkPipelineBindPoint bind_point) {
+  pipeline.bind_descriptor_sets(commandbuffer, bind_point, 0, 1, &particle_set_graphics[read_index]);
+}
 
-    FluidData data{};
-    data.position = {x, y ,z, 0};
-    values.push_back(data);
-  }
+void FluidSystem::bind_bodies(VkCommandBuffer commandbuffer, Pipeline& pipeline, VkPipelineBindPoint bind_point) {
+  pipeline.bind_descriptor_sets(commandbuffer, bind_point, 0, 1, &rigid_bodies->graphics_set);
+}
+
+void FluidSystem::set_profiler(Profiler* profiler) {
+  this->profiler = profiler;
+  sort->profiler = profiler;
+}
+
+void FluidSystem::init_draw_arguments(CommandPool& commandpool, uint32_t index_count) {
+  population->set_index_count(commandpool, index_count);
+}
+
+void FluidSystem::init_data(CommandPool& commandpool, VkPhysicalDevice physical_device, uint32_t live_count, uint32_t seed, const std::vector<FluidBlock>& blocks) {
+  std::vector<FluidData> values = FluidBlock::place(blocks, std::min(live_count, instance_count), seed);
 
   // FluidData data1{};
   // data1.position = {0.2, 0.2, 0.0, 0}; // (0, 0, 0);
@@ -380,11 +565,237 @@ void FluidSystem::init_data(CommandPool& commandpool, VkPhysicalDevice physical_
   //   std::cout << i.position.x << " " << i.position.y << " " << i.position.z << " key: " << (hash % instance_count) << '\n';
   // }
   //
-  staging.fillData(values.data(), size);
+  load_particles(commandpool, values);
+}
+
+void FluidSystem::load_particles(CommandPool& commandpool, const std::vector<FluidData>& particles) {
+  upload_particles(commandpool, particles.data(), static_cast<uint32_t>(particles.size()), 0);
+}
+
+void FluidSystem::load_particles(CommandPool& commandpool, const std::vector<FluidData>& particles, uint32_t step) {
+  upload_particles(commandpool, particles.data(), static_cast<uint32_t>(particles.size()), step);
+}
+
+void FluidSystem::upload_particles(CommandPool& commandpool, const FluidData* particles, uint32_t count, uint32_t step) {
+  VkDeviceSize size = sizeof(FluidData) * instance_count; 
+
+  // Both particle buffers get the same staging
+  uint32_t live_count = std::min(count, instance_count);
+  FluidData* values = static_cast<FluidData*>(commandpool.uploads().stage({particle_buffers[0].buffer, particle_buffers[1].buffer}, 0, size));
+  std::copy(particles, particles + live_count, values);
+
+  fill_free_slots(values + live_count, instance_count - live_count);
+
+  population->reset(commandpool, live_count, step);
+}
+
+void FluidSystem::check_limits(uint32_t capacity) const {
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physical_device, &properties);
+  const VkPhysicalDeviceLimits& limits = properties.limits;
+
+  // Every per-particle buffer is bound whole as one storage buffer
+  VkDeviceSize particle_bytes = static_cast<VkDeviceSize>(sizeof(FluidData)) * capacity;
+  if (particle_bytes > limits.maxStorageBufferRange) {
+    throw std::runtime_error(
+      std::to_string(capacity) + " particles need a " + std::to_string(particle_bytes) + " byte storage buffer, " +
+      properties.deviceName + " binds at most " + std::to_string(limits.maxStorageBufferRange)
+    );
+  }
+
+  VkDeviceSize table_bytes = static_cast<VkDeviceSize>(sizeof(uint32_t)) * static_cast<uint32_t>(table_cells);
+  if (table_bytes > limits.maxStorageBufferRange) {
+    throw std::runtime_error(
+      "hash.table_cells " + std::to_string(table_cells) + " needs a " + std::to_string(table_bytes) + " byte storage buffer, " +
+      properties.deviceName + " binds at most " + std::to_string(limits.maxStorageBufferRange)
+    );
+  }
+
+  // Particle passes put up to 65535 workgroups in x and the rest in y, see vertex.count.comp
+  uint32_t groups = (capacity + 255) / 256;
+  uint32_t groups_y = (groups + 65534) / 65535;
+  if (groups_y > limits.maxComputeWorkGroupCount[1]) {
+    throw std::runtime_error(
+      std::to_string(capacity) + " particles need " + std::to_string(groups_y) + " workgroup rows, " +
+      properties.deviceName + " dispatches at most " + std::to_string(limits.maxComputeWorkGroupCount[1])
+    );
+  }
+}
+
+void FluidSystem::fill_free_slots(FluidData* values, uint32_t count) {
+  // Free slots look like removed particles until an emitter claims them
+  for (uint32_t i = 0; i < count; ++i) {
+    FluidData data{};
+    data.position = glm::vec4(0.0f);
+    data.set_key(table_cells);
+    data.velocity = {0, 0, 0, -1};
+    values[i] = data;
+  }
+}
+
+void FluidSystem::reserve(CommandPool& commandpool, DescriptorBuilder& builder, uint32_t capacity) {
+  if (capacity <= instance_count) {
+    return;
+  }
+  check_limits(capacity);
+
+  // Every recorded step reads the old buffers and their sets
+  vkDeviceWaitIdle(device);
+
+  std::vector<Buffer> grown_buffers;
+  grown_buffers.reserve(2);
+  for (size_t i = 0; i < 2; i++) {
+    grown_buffers.emplace_back(
+        device,
+        physical_device,
+        sizeof(FluidData)*capacity,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+    );
+  }
+
+  HostBuffer staging(
+    device,
+    physical_device,
+    sizeof(FluidData) * (capacity - instance_count),
+    VK_BUFFER_USAGE_TRANSFER_SRC_BIT
+  );
+  fill_free_slots(static_cast<FluidData*>(staging.map()), capacity - instance_count);
+
+  // Old slots keep their place, so the counts on the device stay valid
+  VkCommandBuffer commandbuffer = commandpool.start_single_command();
+  for (size_t i = 0; i < 2; i++) {
+    VkBufferCopy kept{};
+    kept.size = sizeof(FluidData) * instance_count;
+    vkCmdCopyBuffer(commandbuffer, particle_buffers[i].buffer, grown_buffers[i].buffer, 1, &kept);
+
+    VkBufferCopy tail{};
+    tail.dstOffset = sizeof(FluidData) * instance_count;
+    tail.size = staging.size;
+    vkCmdCopyBuffer(commandbuffer, staging.buffer, grown_buffers[i].buffer, 1, &tail);
+  }
+  commandpool.end_single_command(commandbuffer);
+
+  particle_buffers.swap(grown_buffers);
+
+  // Both are rewritten every step before they are read
+  position_buffer = std::make_unique<Buffer>(
+    device,
+    physical_device,
+    sizeof(FluidData)*capacity,
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+  );
+
+  density_buffer = std::make_unique<Buffer>(
+    device,
+    physical_device,
+    sizeof(float)*capacity,
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+  );
+
+  builder.clear();
+  for (size_t i = 0; i < 2; i++) {
+    builder.bind_buffer(0, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, particle_buffers[i].get_info());
+    builder.update(particle_set[i]);
+    builder.clear();
+
+    builder.bind_buffer(0, VK_SHADER_STAGE_VERTEX_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, particle_buffers[i].get_info());
+    builder.update(particle_set_graphics[i]);
+    builder.clear();
+  }
+
+  builder.bind_buffer(0, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, position_buffer->get_info());
+  builder.update(position_set);
+  builder.clear();
+
+  // The counters at binding 2 stay where they are
+  builder.bind_buffer(1, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, density_buffer->get_info());
+  builder.update(density_set);
+  builder.clear();
+
+  instance_count = capacity;
+  population->set_capacity(capacity);
+  sort->resize(builder, capacity);
+  sleep->resize(builder, capacity);
+  exporter->resize(builder, capacity);
+  checkpointer->resize(capacity);
+}
+
+void FluidSystem::fill_particles(CommandPool& commandpool, DescriptorBuilder& builder, MeshFill& fill, uint32_t seed) {
+  fill.fill(commandpool, builder, particle_set[read_index], particle_layout, population->set, population->layout, population->count_buffer(), instance_count, table_cells, seed);
 
-  for (auto& buffer : particle_buffers) {
-    buffer.copyBuffer(staging, commandpool);
+  // Both buffers start from the same particles, as after an upload
+  VkCommandBuffer commandbuffer = commandpool.start_single_command();
+  VkBufferCopy region{};
+  region.size = sizeof(FluidData) * instance_count;
+  vkCmdCopyBuffer(commandbuffer, particle_buffers[read_index].buffer, particle_buffers[write_index].buffer, 1, &region);
+  commandpool.end_single_command(commandbuffer);
+}
+
+PopulationCounts FluidSystem::read_counts(CommandPool& commandpool) {
+  HostBuffer count_staging(
+    device,
+    physical_device,
+    sizeof(PopulationCounts),
+    VK_BUFFER_USAGE_TRANSFER_DST_BIT
+  );
+  count_staging.copyBuffer(population->count_buffer(), commandpool);
+
+  PopulationCounts counts{};
+  count_staging.getData(&counts);
+  return counts;
+}
+
+void FluidSystem::load_checkpoint(CommandPool& commandpool, const MappedCheckpoint& checkpoint) {
+  checkpoint.check(Solver::constants, sizeof(FluidData));
+
+  const CheckpointHeader& header = checkpoint.header();
+  if (header.live > instance_count) {
+    throw std::runtime_error("Checkpoint holds " + std::to_string(header.live) + " particles, more than the " + std::to_string(instance_count) + " this scene has room for");
   }
+
+  const float* faces = header.boundary;
+  set_boundary(BoxBoundary{faces[0], faces[1], faces[2], faces[3], faces[4], faces[5]});
+  upload_particles(commandpool, static_cast<const FluidData*>(checkpoint.particles()), header.live, static_cast<uint32_t>(header.step));
+}
+
+CheckpointHeader FluidSystem::checkpoint_header() const {
+  CheckpointHeader header = Checkpoint::make_header(Solver::constants, sizeof(FluidData));
+  float faces[6] = {front, back, bottom, top, right, left};
+  std::copy(faces, faces + 6, header.boundary);
+  return header;
+}
+
+void FluidSystem::flush_checkpoints() {
+  checkpointer->flush();
+}
+
+std::vector<FluidData> FluidSystem::read_particles(CommandPool& commandpool) {
+  vkDeviceWaitIdle(device);
+
+  PopulationCounts counts = read_counts(commandpool);
+
+  HostBuffer staging(
+    device,
+    physical_device,
+    sizeof(FluidData) * instance_count,
+    VK_BUFFER_USAGE_TRANSFER_DST_BIT
+  );
+
+  // run swaps at the end, so read_index holds the newest step
+  staging.copyBuffer(particle_buffers[read_index], commandpool);
+
+  std::vector<FluidData> values(instance_count);
+  staging.getData(values.data());
+  values.resize(std::min(counts.live, instance_count));
+
+  // Sinks mark particles dead after the live count was taken
+  values.erase(std::remove_if(values.begin(), values.end(), [](const FluidData& data) {
+    return data.velocity.w < 0.0f;
+  }), values.end());
+  return values;
 }
 
 
@@ -409,7 +820,7 @@ void FluidSystem::print_data(CommandPool& commandpool, VkPhysicalDevice physical
 
   // Key
   for (size_t i = 0; i < instance_count; i++) {
-    std::cout << reading[i].predicted_position.x << " " << reading[i].predicted_position.y << " " << reading[i].predicted_position.z << " " << reading[i].position.w << '\n';
+    std::cout << reading[i].predicted_position.x << " " << reading[i].predicted_position.y << " " << reading[i].predicted_position.z << " " << reading[i].key() << '\n';
     // std::cout << reading[i].position.x << " " << reading[i].position.y << " " << reading[i].position.z << " " << reading[i].position.w << '\n';
     std::cout << '\n';
   }
@@ -455,8 +866,66 @@ void FluidSystem::init_boundary() {
   right = 5.0;
   left = -5.0;
 
-  std::vector<float> boundaries = {front, back, bottom, top, right, left};  
-  boundary_buffer->fillData(boundaries.data(), sizeof(float)*6);    
+  BoxBoundary boundary = get_boundary();
+  boundary_ring->write_all(&boundary);
+}
+
+void FluidSystem::add_boundary_mesh(const Entity& entity, const glm::mat4& transform, bool container) {
+  distance_field->add_mesh(entity, transform, container);
+}
+
+void FluidSystem::bake_boundary(CommandPool& commandpool, DescriptorBuilder& builder) {
+  distance_field->bake(commandpool, builder);
+  sleep->wake_all();
+}
+
+void FluidSystem::add_rigid_body(const RigidBodyDesc& desc) {
+  rigid_bodies->add_body(desc);
+}
+
+void FluidSystem::add_emitter(const ParticleEmitter& emitter) {
+  population->add_emitter(emitter);
+}
+
+void FluidSystem::add_sink(const ParticleSink& sink) {
+  population->add_sink(sink);
+}
+
+void FluidSystem::upload_rigid_bodies(CommandPool& commandpool) {
+  rigid_bodies->upload(commandpool);
+  // Static bodies never count as moving, so wake the fluid they were placed into
+  sleep->wake_all();
+}
+
+void FluidSystem::set_boundary(float half_width, float half_height, float half_depth) {
+  front = half_depth;
+  back = -half_depth;
+  bottom = half_height;
+  top = -half_height;
+  right = half_width;
+  left = -half_width;
+
+  // Set up before any frame is in flight, so every slot takes the new box
+  BoxBoundary boundary = get_boundary();
+  boundary_ring->write_all(&boundary);
+  sleep->wake_all();
+}
+
+void FluidSystem::set_boundary(const BoxBoundary& boundary) {
+  front = boundary.front;
+  back = boundary.back;
+  bottom = boundary.bottom;
+  top = boundary.top;
+  right = boundary.right;
+  left = boundary.left;
+
+  // Set up before any frame is in flight, so every slot takes the new box
+  boundary_ring->write_all(&boundary);
+  sleep->wake_all();
+}
+
+BoxBoundary FluidSystem::get_boundary() const {
+  return {front, back, bottom, top, right, left};
 }
 
 void FluidSystem::update_boundary(Window& window) {
@@ -466,8 +935,11 @@ void FluidSystem::update_boundary(Window& window) {
   if (window.pressed(GLFW_KEY_V)) back -= 0.05;
   if (window.pressed(GLFW_KEY_B)) bottom += 0.05;
   if (window.pressed(GLFW_KEY_N)) bottom -= 0.05;
+}
 
-
-  std::vector<float> boundaries = {front, back, bottom, top, right, left};  
-  boundary_buffer->fillData(boundaries.data(), sizeof(float)*6);    
+void FluidSystem::begin_frame(uint32_t frame) {
+  BoxBoundary boundary = get_boundary();
+  boundary_offset = boundary_ring->write(frame, &boundary);
+  counters->begin_frame(frame);
+  rigid_bodies->begin_frame(frame);
 }
@@ -1,41 +1,112 @@
 
 #pragma once
 
+#include "SimulationBackend.hpp"
+#include "Solver.hpp"
+#include "../profiler/Profiler.hpp"
 #include "../command/CommandPool.hpp"
 #include "../buffer/Buffer.hpp"
 #include "../buffer/HostBuffer.hpp"
+#include "../buffer/UniformRing.hpp"
 #include "../context/Window.hpp"
 #include "subsystem/Sort.hpp"
-
-#define GLM_FORCE_RADIANS
-#define GLM_FORCE_DEPTH_ZERO_TO_ONE
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/glm.hpp>
-
+#include "subsystem/Sleep.hpp"
+#include "subsystem/DistanceField.hpp"
+#include "subsystem/RigidBodies.hpp"
+#include "subsystem/Population.hpp"
+#include "subsystem/Counters.hpp"
+#include "subsystem/Exporter.hpp"
+#include "subsystem/Checkpointer.hpp"
+#include "subsystem/MeshFill.hpp"
+#include "../record/Checkpoint.hpp"
+
+#include <array>
 #include <vector>
 #include <memory>
-
-struct FluidData {
-  // Position x, y, z first 3 slots and final slot is key
-  glm::vec4 position;
-  glm::vec4 velocity;
-  glm::vec4 predicted_position;
+#include <string>
+
+// One stage's output from FluidSystem::capture_step, only the fields that
+// stage writes are filled
+struct StageCapture {
+  std::string stage;
+  std::vector<FluidData> particles;
+  std::vector<uint32_t> table;
+  std::vector<float> density;
 };
 
-class FluidSystem {
+class FluidSystem : public SimulationBackend {
 
   public:
+    // instance_count is the capacity, the live count is only kept on the device
     FluidSystem(VkDevice device, VkPhysicalDevice physical_device, DescriptorBuilder& builder, uint32_t instance_count); 
     
-    void init_data(CommandPool& commandpool, VkPhysicalDevice physical_device);
+    void init_data(CommandPool& commandpool, VkPhysicalDevice physical_device, uint32_t live_count, uint32_t seed, const std::vector<FluidBlock>& blocks) override;
+
+    std::vector<FluidData> read_particles(CommandPool& commandpool) override;
+    void load_particles(CommandPool& commandpool, const std::vector<FluidData>& particles) override;
+    // Keeps the step counter at step instead of starting over, for particles
+    // stepped elsewhere such as the CPU backend
+    void load_particles(CommandPool& commandpool, const std::vector<FluidData>& particles, uint32_t step);
+    PopulationCounts read_counts(CommandPool& commandpool);
+
+    // Uploads the particles straight from the mapped file and restores the
+    // boundary and step counter, the constants have to match this build
+    void load_checkpoint(CommandPool& commandpool, const MappedCheckpoint& checkpoint);
+    // Header with this build's constants and the current boundary
+    CheckpointHeader checkpoint_header() const;
+    // Waits for a background checkpoint still being written
+    void flush_checkpoints();
 
     void print_data(CommandPool& commandpool, VkPhysicalDevice physical_device);
     void print_density(CommandPool& commandpool, VkPhysicalDevice pysical_device);
 
-    void update_boundary(Window& window);
-
-    void run(CommandPool& commandpool, VkCommandBuffer commandbuffer);
+    // Moves the faces on the host, begin_frame hands them to the GPU
+    void update_boundary(Window& window) override;
+    void set_boundary(float half_width, float half_height, float half_depth) override;
+    void set_boundary(const BoxBoundary& boundary) override;
+    BoxBoundary get_boundary() const override;
+    // Writes the boundary into this frame's uniform slot, after its fence has signalled
+    void begin_frame(uint32_t frame);
+
+    // Reallocates every per-particle buffer for capacity particles and points
+    // the existing descriptor sets at the new ones. The particles and the
+    // counts carry over, the new slots start free. Waits for the device, so
+    // callers grow in large steps between frames.
+    void reserve(CommandPool& commandpool, DescriptorBuilder& builder, uint32_t capacity);
+    uint32_t capacity() const { return instance_count; }
+    // Live plus emitted particles a few steps ago, without a queue wait
+    uint32_t occupied() const { return population->occupied(); }
+
+    // Replaces the particles with the meshes' fill, generated on the device
+    void fill_particles(CommandPool& commandpool, DescriptorBuilder& builder, MeshFill& fill, uint32_t seed);
+
+    void add_boundary_mesh(const Entity& entity, const glm::mat4& transform, bool container);
+    void bake_boundary(CommandPool& commandpool, DescriptorBuilder& builder);
+
+    void add_rigid_body(const RigidBodyDesc& desc);
+
+    void add_emitter(const ParticleEmitter& emitter);
+    void add_sink(const ParticleSink& sink);
+    void upload_rigid_bodies(CommandPool& commandpool);
+
+    void run(CommandPool& commandpool, VkCommandBuffer commandbuffer) override;
+    // The same step as run, one submit per stage with the outputs read back
+    // in between. Slow, meant for checking the kernels against golden data.
+    std::vector<StageCapture> capture_step(CommandPool& commandpool);
     void bind_particle(VkCommandBuffer commandbuffer, Pipeline& pipeline, VkPipelineBindPoint bind_point);
+    void bind_bodies(VkCommandBuffer commandbuffer, Pipeline& pipeline, VkPipelineBindPoint bind_point);
+
+    // Instanced particle draw, the instance count is written from the live count each step
+    void init_draw_arguments(CommandPool& commandpool, uint32_t index_count);
+    VkBuffer draw_arguments() const { return population->draw_buffer(); }
+    // The buffer the draw reads, holding the newest step
+    VkBuffer particle_buffer() const { return particle_buffers[read_index].buffer; }
+
+    // Null turns the pass timestamps off again
+    void set_profiler(Profiler* profiler);
+
+    uint32_t body_count() const { return rigid_bodies->count(); }
+    VkDescriptorSetLayout body_layout_graphics() const { return rigid_bodies->graphics_layout; }
 
     const float PI = 3.1415926538;
 
@@ -43,9 +114,18 @@ class FluidSystem {
   private:
     void calculate_predicted_position(VkCommandBuffer commandbuffer);
     void update_spatial_lookup(VkCommandBuffer commandbuffer, CommandPool& commandpool);
+    void sort_particles(VkCommandBuffer commandbuffer, CommandPool& commandpool);
+    void build_spatial_table(VkCommandBuffer commandbuffer);
+    void update_active_particles(VkCommandBuffer commandbuffer);
     void calculate_density(VkCommandBuffer commandbuffer);
     void move_particles(VkCommandBuffer commandbuffer);
+    void update_rigid_bodies(VkCommandBuffer commandbuffer);
     void init_boundary();
+    void download(Buffer& source, void* values, CommandPool& commandpool);
+    void upload_particles(CommandPool& commandpool, const FluidData* particles, uint32_t count, uint32_t step);
+    void fill_free_slots(FluidData* values, uint32_t count);
+    // Throws when capacity particles or the hash table don't fit the device's buffer and dispatch limits
+    void check_limits(uint32_t capacity) const;
 
     VkDevice device;
     VkPhysicalDevice physical_device;
@@ -63,6 +143,11 @@ class FluidSystem {
 
     std::unique_ptr<CommandPool> commandpool;
     std::unique_ptr<Sort> sort;
+    std::unique_ptr<Sleep> sleep;
+    std::unique_ptr<Population> population;
+    std::unique_ptr<Counters> counters;
+    std::unique_ptr<Exporter> exporter;
+    std::unique_ptr<Checkpointer> checkpointer;
 
     VkDescriptorSet spatial_lookup_set;
     VkDescriptorSetLayout spatial_lookup_layout;
@@ -74,17 +159,28 @@ class FluidSystem {
 
     VkDescriptorSet boundary_set;
     VkDescriptorSetLayout boundary_layout;
-    std::unique_ptr<HostBuffer> boundary_buffer;
+    std::unique_ptr<UniformRing> boundary_ring;
+    uint32_t boundary_offset = 0;
+
+    std::unique_ptr<DistanceField> distance_field;
+    std::unique_ptr<RigidBodies> rigid_bodies;
 
     std::unique_ptr<ComputePipeline> position_pipline;
     std::unique_ptr<ComputePipeline> spatial_pipeline;
     std::unique_ptr<ComputePipeline> density_pipeline;
     std::unique_ptr<ComputePipeline> move_pipeline;
 
+    // Counting variants, only created when Counters::interval is set
+    std::unique_ptr<ComputePipeline> density_counted_pipeline;
+    std::unique_ptr<ComputePipeline> move_counted_pipeline;
+    bool counting = false;
+
+    Profiler* profiler = nullptr;
+
     uint32_t read_index = 0;
     uint32_t write_index = 1;
 
-    const int table_cells = 17658;
+    const int table_cells = static_cast<int>(Solver::constants.table_cells);
 
     float front ;
     float back;
@@ -93,6 +189,9 @@ class FluidSystem {
     float right;
     float left;
 
+    // Faces the last step ran with, in BoxBoundary order
+    std::array<float, 6> stepped_faces{};
+
 };
 
 
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "../command/CommandPool.hpp"
+#include "../context/Window.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// Faces of the box boundary, in the order the boundary uniform holds them
+struct BoxBoundary {
+  float front;
+  float back;
+  float bottom;
+  float top;
+  float right;
+  float left;
+};
+
+struct FluidData {
+  // Position x, y, z first 3 slots and final slot is the key's raw bits
+  glm::vec4 position;
+  glm::vec4 velocity;
+  glm::vec4 predicted_position;
+
+  // The shaders write the key with uintBitsToFloat, a float value would lose
+  // keys past 2^24
+  uint32_t key() const {
+    uint32_t key;
+    std::memcpy(&key, &position.w, sizeof(key));
+    return key;
+  }
+
+  void set_key(uint32_t key) {
+    std::memcpy(&position.w, &key, sizeof(key));
+  }
+};
+
+// Box filled with fluid at startup. The default is the block every scene
+// started from, y grows downwards like the boundary.
+struct FluidBlock {
+  glm::vec3 minimum = glm::vec3(-2.5f, -5.0f, -2.5f);
+  glm::vec3 maximum = glm::vec3(2.5f, 0.0f, 2.5f);
+  glm::vec3 velocity = glm::vec3(0.0f);
+
+  // live_count particles spread over the blocks by volume, uniformly at random
+  // inside each. No blocks places them in the default one.
+  static std::vector<FluidData> place(std::vector<FluidBlock> blocks, uint32_t live_count, uint32_t seed) {
+    if (blocks.empty()) {
+      blocks.emplace_back();
+    }
+
+    float total_volume = 0.0f;
+    for (const auto& block : blocks) {
+      glm::vec3 extent = glm::max(block.maximum - block.minimum, glm::vec3(0.0f));
+      total_volume += extent.x * extent.y * extent.z;
+    }
+
+    std::vector<FluidData> values;
+    values.reserve(live_count);
+
+    std::mt19937 gen(seed);
+    uint32_t placed = 0;
+    for (size_t b = 0; b < blocks.size(); b++) {
+      const FluidBlock& block = blocks[b];
+      glm::vec3 extent = glm::max(block.maximum - block.minimum, glm::vec3(0.0f));
+      float share = total_volume > 0.0f ? extent.x * extent.y * extent.z / total_volume : 1.0f / blocks.size();
+
+      // The last block takes the rounding remainder
+      uint32_t count = b + 1 == blocks.size() ? live_count - placed : std::min(static_cast<uint32_t>(live_count * share), live_count - placed);
+      placed += count;
+
+      std::uniform_real_distribution<float> x_range(block.minimum.x, block.maximum.x);
+      std::uniform_real_distribution<float> y_range(block.minimum.y, block.maximum.y);
+      std::uniform_real_distribution<float> z_range(block.minimum.z, block.maximum.z);
+      for (uint32_t i = 0; i < count; i++) {
+        float x = x_range(gen);
+        float y = y_range(gen);
+        float z = z_range(gen);
+
+        FluidData data{};
+        data.position = {x, y, z, 0};
+        data.velocity = {block.velocity, 0};
+        values.push_back(data);
+      }
+    }
+    return values;
+  }
+};
+
+// One fluid step implementation. FluidSystem records Vulkan compute work into
+// the frame's command buffer, CpuFluidSystem steps on the host and ignores it.
+class SimulationBackend {
+
+  public:
+    virtual ~SimulationBackend() = default;
+
+    // The same seed and blocks always place the same particles
+    virtual void init_data(CommandPool& commandpool, VkPhysicalDevice physical_device, uint32_t live_count, uint32_t seed, const std::vector<FluidBlock>& blocks) = 0;
+
+    // Live particles only, in whatever order the backend keeps them
+    virtual std::vector<FluidData> read_particles(CommandPool& commandpool) = 0;
+    virtual void load_particles(CommandPool& commandpool, const std::vector<FluidData>& particles) = 0;
+
+    virtual void update_boundary(Window& window) = 0;
+    // Box centred on the origin, the keys move its faces from there
+    virtual void set_boundary(float half_width, float half_height, float half_depth) = 0;
+    virtual void set_boundary(const BoxBoundary& boundary) = 0;
+    virtual BoxBoundary get_boundary() const = 0;
+    virtual void run(CommandPool& commandpool, VkCommandBuffer commandbuffer) = 0;
+};
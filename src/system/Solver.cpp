@@ -0,0 +1,83 @@
+#include "Solver.hpp"
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+
+// Layout the map entries below point into
+struct SpecializationData {
+  VkBool32 instrumented;
+  float smoothing_radius;
+  float mass;
+  float target_density;
+  float pressure_multiplier;
+  float gravity;
+  float time_step;
+  int32_t table_cells;
+  float rest_velocity;
+  float rest_density;
+};
+
+struct Specialization {
+  SpecializationData data{};
+  std::array<VkSpecializationMapEntry, 10> entries{};
+  VkSpecializationInfo info{};
+};
+
+void Solver::validate(const SphConstants& constants) {
+  if (!(constants.smoothing_radius > 0.0f) || !std::isfinite(constants.smoothing_radius)) {
+    throw std::runtime_error("solver.smoothing_radius has to be positive");
+  }
+  if (!(constants.mass > 0.0f) || !(constants.target_density > 0.0f)) {
+    throw std::runtime_error("solver.mass and solver.target_density have to be positive");
+  }
+  if (!(constants.time_step > 0.0f)) {
+    throw std::runtime_error("solver.time_step has to be positive");
+  }
+  // Shaders take the count as an int, and the removed key one past the last cell has to fit too
+  if (constants.table_cells == 0 || constants.table_cells >= (1u << 31)) {
+    throw std::runtime_error("hash.table_cells has to be between 1 and 2147483647");
+  }
+}
+
+const VkSpecializationInfo* Solver::specialization(bool instrumented) {
+  // One per variant, the data is copied when a pipeline is created
+  static std::array<Specialization, 2> variants;
+  Specialization& variant = variants[instrumented ? 1 : 0];
+
+  variant.data.instrumented = instrumented ? VK_TRUE : VK_FALSE;
+  variant.data.smoothing_radius = constants.smoothing_radius;
+  variant.data.mass = constants.mass;
+  variant.data.target_density = constants.target_density;
+  variant.data.pressure_multiplier = constants.pressure_multiplier;
+  variant.data.gravity = constants.gravity;
+  variant.data.time_step = constants.time_step;
+  variant.data.table_cells = static_cast<int32_t>(constants.table_cells);
+  variant.data.rest_velocity = rest_velocity;
+  variant.data.rest_density = rest_density;
+
+  std::array<size_t, 10> offsets = {
+    offsetof(SpecializationData, instrumented),
+    offsetof(SpecializationData, smoothing_radius),
+    offsetof(SpecializationData, mass),
+    offsetof(SpecializationData, target_density),
+    offsetof(SpecializationData, pressure_multiplier),
+    offsetof(SpecializationData, gravity),
+    offsetof(SpecializationData, time_step),
+    offsetof(SpecializationData, table_cells),
+    offsetof(SpecializationData, rest_velocity),
+    offsetof(SpecializationData, rest_density),
+  };
+  for (uint32_t i = 0; i < variant.entries.size(); i++) {
+    variant.entries[i].constantID = i;
+    variant.entries[i].offset = static_cast<uint32_t>(offsets[i]);
+    variant.entries[i].size = 4;
+  }
+
+  variant.info.mapEntryCount = static_cast<uint32_t>(variant.entries.size());
+  variant.info.pMapEntries = variant.entries.data();
+  variant.info.dataSize = sizeof(SpecializationData);
+  variant.info.pData = &variant.data;
+  return &variant.info;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "cpu/Kernels.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+// Constants every backend steps with. The shaders take them as
+// specialization constants, so they fold away at pipeline creation like the
+// literals they replace. Set before the systems are built, they are read once.
+struct Solver {
+  inline static SphConstants constants;
+
+  // Sleeping, GPU only. A particle below both thresholds for rest_steps steps
+  // leaves the active list, zero keeps every particle awake.
+  inline static uint32_t rest_steps = 0;
+  inline static float rest_velocity = 0.05f;
+  inline static float rest_density = 0.5f;
+
+  // Throws when a value would break the solver, such as a zero radius
+  static void validate(const SphConstants& constants);
+
+  // Same map for every fluid shader, a shader ignores the ids it does not
+  // declare. constant_id 0 picks the counting variants.
+  //   0 instrumented, 1 smoothing_radius, 2 mass, 3 target_density,
+  //   4 pressure_multiplier, 5 gravity, 6 time_step, 7 table_cells,
+  //   8 rest_velocity, 9 rest_density
+  static const VkSpecializationInfo* specialization(bool instrumented = false);
+};
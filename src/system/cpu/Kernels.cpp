@@ -0,0 +1,243 @@
+
+#include "Kernels.hpp"
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FLUIDSIM_X86 1
+#endif
+
+static const float PI = 3.1415926538f;
+
+static float poly6_scale(const SphConstants& constants) {
+  return 315.0f / (64.0f * PI * std::pow(constants.smoothing_radius, 9.0f));
+}
+
+static float spiky_scale(const SphConstants& constants) {
+  return -45.0f / (PI * std::pow(constants.smoothing_radius, 6.0f));
+}
+
+float Kernels::poly6(float dst, const SphConstants& constants) {
+  float h = constants.smoothing_radius;
+  if (dst >= h) return 0.0f;
+  float value = h * h - dst * dst;
+  return poly6_scale(constants) * value * value * value;
+}
+
+float Kernels::density_to_pressure(float density, const SphConstants& constants) {
+  return (density - constants.target_density) * constants.pressure_multiplier;
+}
+
+static float density_run_scalar(const ParticleView& view, uint32_t begin, uint32_t end, uint32_t self, const SphConstants& constants) {
+  float h2 = constants.smoothing_radius * constants.smoothing_radius;
+  float scale = constants.mass * poly6_scale(constants);
+
+  float x = view.x[self];
+  float y = view.y[self];
+  float z = view.z[self];
+
+  float density = 0.0f;
+  for (uint32_t j = begin; j < end; j++) {
+    if (j == self) continue;
+
+    float dx = view.x[j] - x;
+    float dy = view.y[j] - y;
+    float dz = view.z[j] - z;
+    float r2 = dx * dx + dy * dy + dz * dz;
+    if (r2 >= h2) continue;
+
+    float value = h2 - r2;
+    density += scale * value * value * value;
+  }
+
+  return density;
+}
+
+static void pressure_run_scalar(const ParticleView& view, uint32_t begin, uint32_t end, uint32_t self, float self_pressure, const SphConstants& constants, PressureSum& sum) {
+  float h = constants.smoothing_radius;
+  float h2 = h * h;
+  float poly = poly6_scale(constants);
+  float spiky = spiky_scale(constants);
+
+  float x = view.x[self];
+  float y = view.y[self];
+  float z = view.z[self];
+
+  for (uint32_t j = begin; j < end; j++) {
+    if (j == self) continue;
+
+    float dx = view.x[j] - x;
+    float dy = view.y[j] - y;
+    float dz = view.z[j] - z;
+    float r2 = dx * dx + dy * dy + dz * dz;
+
+    // Same cut offs as the shader, too close or outside the kernel adds nothing
+    if (r2 < 1e-4f || r2 >= h2) continue;
+
+    float len = std::sqrt(r2);
+    float falloff = h - len;
+    float gradient = spiky * falloff * falloff / len;
+
+    float density = view.density[j];
+    float shared_pressure = (Kernels::density_to_pressure(density, constants) + self_pressure) * 0.5f;
+    float weight = constants.mass * shared_pressure * gradient / density;
+
+    sum.pressure[0] += weight * dx;
+    sum.pressure[1] += weight * dy;
+    sum.pressure[2] += weight * dz;
+
+    float value = h2 - r2;
+    float influence = poly * value * value * value;
+    sum.viscosity[0] += (view.vx[j] - view.vx[self]) * influence;
+    sum.viscosity[1] += (view.vy[j] - view.vy[self]) * influence;
+    sum.viscosity[2] += (view.vz[j] - view.vz[self]) * influence;
+  }
+}
+
+#ifdef FLUIDSIM_X86
+
+__attribute__((target("avx2,fma")))
+static float horizontal_sum(__m256 value) {
+  __m128 low = _mm256_castps256_ps128(value);
+  __m128 high = _mm256_extractf128_ps(value, 1);
+  __m128 sum = _mm_add_ps(low, high);
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
+  return _mm_cvtss_f32(sum);
+}
+
+// All bits set on every lane except the one holding self
+__attribute__((target("avx2,fma")))
+static __m256 neighbour_mask(uint32_t j, uint32_t self) {
+  __m256i lanes = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(j)), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+  __m256i is_self = _mm256_cmpeq_epi32(lanes, _mm256_set1_epi32(static_cast<int>(self)));
+  return _mm256_castsi256_ps(_mm256_xor_si256(is_self, _mm256_set1_epi32(-1)));
+}
+
+__attribute__((target("avx2,fma")))
+static float density_run_avx2(const ParticleView& view, uint32_t begin, uint32_t end, uint32_t self, const SphConstants& constants) {
+  float h2 = constants.smoothing_radius * constants.smoothing_radius;
+  float scale = constants.mass * poly6_scale(constants);
+
+  __m256 x = _mm256_set1_ps(view.x[self]);
+  __m256 y = _mm256_set1_ps(view.y[self]);
+  __m256 z = _mm256_set1_ps(view.z[self]);
+  __m256 radius = _mm256_set1_ps(h2);
+
+  __m256 sum = _mm256_setzero_ps();
+  uint32_t j = begin;
+  for (; j + 8 <= end; j += 8) {
+    __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(view.x + j), x);
+    __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(view.y + j), y);
+    __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(view.z + j), z);
+    __m256 r2 = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+
+    __m256 mask = _mm256_and_ps(_mm256_cmp_ps(r2, radius, _CMP_LT_OQ), neighbour_mask(j, self));
+    __m256 value = _mm256_sub_ps(radius, r2);
+    __m256 cube = _mm256_mul_ps(_mm256_mul_ps(value, value), value);
+    sum = _mm256_add_ps(sum, _mm256_and_ps(cube, mask));
+  }
+
+  float density = scale * horizontal_sum(sum);
+  return density + density_run_scalar(view, j, end, self, constants);
+}
+
+__attribute__((target("avx2,fma")))
+static void pressure_run_avx2(const ParticleView& view, uint32_t begin, uint32_t end, uint32_t self, float self_pressure, const SphConstants& constants, PressureSum& sum) {
+  float h = constants.smoothing_radius;
+
+  __m256 x = _mm256_set1_ps(view.x[self]);
+  __m256 y = _mm256_set1_ps(view.y[self]);
+  __m256 z = _mm256_set1_ps(view.z[self]);
+  __m256 vx = _mm256_set1_ps(view.vx[self]);
+  __m256 vy = _mm256_set1_ps(view.vy[self]);
+  __m256 vz = _mm256_set1_ps(view.vz[self]);
+
+  __m256 radius = _mm256_set1_ps(h);
+  __m256 radius2 = _mm256_set1_ps(h * h);
+  __m256 minimum2 = _mm256_set1_ps(1e-4f);
+  __m256 poly = _mm256_set1_ps(poly6_scale(constants));
+  __m256 spiky = _mm256_set1_ps(spiky_scale(constants));
+  __m256 mass = _mm256_set1_ps(constants.mass);
+  __m256 half = _mm256_set1_ps(0.5f);
+  __m256 target = _mm256_set1_ps(constants.target_density);
+  __m256 multiplier = _mm256_set1_ps(constants.pressure_multiplier);
+  __m256 own_pressure = _mm256_set1_ps(self_pressure);
+  __m256 one = _mm256_set1_ps(1.0f);
+
+  __m256 px = _mm256_setzero_ps();
+  __m256 py = _mm256_setzero_ps();
+  __m256 pz = _mm256_setzero_ps();
+  __m256 qx = _mm256_setzero_ps();
+  __m256 qy = _mm256_setzero_ps();
+  __m256 qz = _mm256_setzero_ps();
+
+  uint32_t j = begin;
+  for (; j + 8 <= end; j += 8) {
+    __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(view.x + j), x);
+    __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(view.y + j), y);
+    __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(view.z + j), z);
+    __m256 r2 = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+
+    __m256 mask = _mm256_and_ps(
+      _mm256_and_ps(_mm256_cmp_ps(r2, radius2, _CMP_LT_OQ), _mm256_cmp_ps(r2, minimum2, _CMP_GE_OQ)),
+      neighbour_mask(j, self)
+    );
+
+    // Masked lanes divide by one instead of a possible zero
+    __m256 len = _mm256_sqrt_ps(_mm256_blendv_ps(one, r2, mask));
+    __m256 falloff = _mm256_sub_ps(radius, len);
+    __m256 gradient = _mm256_div_ps(_mm256_mul_ps(spiky, _mm256_mul_ps(falloff, falloff)), len);
+
+    __m256 density = _mm256_blendv_ps(one, _mm256_loadu_ps(view.density + j), mask);
+    __m256 pressure = _mm256_mul_ps(_mm256_sub_ps(density, target), multiplier);
+    __m256 shared_pressure = _mm256_mul_ps(_mm256_add_ps(pressure, own_pressure), half);
+    __m256 weight = _mm256_and_ps(_mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(mass, shared_pressure), gradient), density), mask);
+
+    px = _mm256_fmadd_ps(weight, dx, px);
+    py = _mm256_fmadd_ps(weight, dy, py);
+    pz = _mm256_fmadd_ps(weight, dz, pz);
+
+    __m256 value = _mm256_sub_ps(radius2, r2);
+    __m256 influence = _mm256_and_ps(_mm256_mul_ps(poly, _mm256_mul_ps(_mm256_mul_ps(value, value), value)), mask);
+
+    qx = _mm256_fmadd_ps(_mm256_sub_ps(_mm256_loadu_ps(view.vx + j), vx), influence, qx);
+    qy = _mm256_fmadd_ps(_mm256_sub_ps(_mm256_loadu_ps(view.vy + j), vy), influence, qy);
+    qz = _mm256_fmadd_ps(_mm256_sub_ps(_mm256_loadu_ps(view.vz + j), vz), influence, qz);
+  }
+
+  sum.pressure[0] += horizontal_sum(px);
+  sum.pressure[1] += horizontal_sum(py);
+  sum.pressure[2] += horizontal_sum(pz);
+  sum.viscosity[0] += horizontal_sum(qx);
+  sum.viscosity[1] += horizontal_sum(qy);
+  sum.viscosity[2] += horizontal_sum(qz);
+
+  pressure_run_scalar(view, j, end, self, self_pressure, constants, sum);
+}
+
+#endif
+
+bool Kernels::using_avx2() {
+#ifdef FLUIDSIM_X86
+  static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+  return supported;
+#else
+  return false;
+#endif
+}
+
+Kernels::DensityRun Kernels::density_run() {
+#ifdef FLUIDSIM_X86
+  if (using_avx2()) return density_run_avx2;
+#endif
+  return density_run_scalar;
+}
+
+Kernels::PressureRun Kernels::pressure_run() {
+#ifdef FLUIDSIM_X86
+  if (using_avx2()) return pressure_run_avx2;
+#endif
+  return pressure_run_scalar;
+}
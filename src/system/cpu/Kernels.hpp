@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Same constants and kernels as the compute shaders
+struct SphConstants {
+  float smoothing_radius = 0.2f;
+  float mass = 1.0f;
+  float target_density = 200.0f;
+  float pressure_multiplier = 27.0f;
+  float gravity = -9.8f;
+  float time_step = 0.01f;
+  // Spatial hash keys, grid cells are smoothing_radius wide
+  uint32_t table_cells = 17658;
+};
+
+// Cell ordered structure of arrays, one entry per particle
+struct ParticleView {
+  const float* x;
+  const float* y;
+  const float* z;
+  const float* vx;
+  const float* vy;
+  const float* vz;
+  const float* density;
+};
+
+struct PressureSum {
+  float pressure[3] = {0.0f, 0.0f, 0.0f};
+  float viscosity[3] = {0.0f, 0.0f, 0.0f};
+};
+
+struct Kernels {
+
+  // Density from the particles in [begin, end), skipping self
+  using DensityRun = float (*)(const ParticleView& view, uint32_t begin, uint32_t end, uint32_t self, const SphConstants& constants);
+
+  // Adds the pressure and viscosity terms from [begin, end) acting on self
+  using PressureRun = void (*)(const ParticleView& view, uint32_t begin, uint32_t end, uint32_t self, float self_pressure, const SphConstants& constants, PressureSum& sum);
+
+  static float poly6(float dst, const SphConstants& constants);
+  static float density_to_pressure(float density, const SphConstants& constants);
+
+  // AVX2 when the CPU supports it, the scalar loop otherwise
+  static DensityRun density_run();
+  static PressureRun pressure_run();
+
+  static bool using_avx2();
+};
@@ -0,0 +1,132 @@
+
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t thread_count) {
+  if (thread_count == 0) {
+    thread_count = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+  }
+
+  for (size_t i = 0; i < thread_count; i++) {
+    queues.push_back(std::make_unique<Queue>());
+  }
+
+  // The calling thread works too, so it owns the last queue
+  workers.reserve(thread_count - 1);
+  for (size_t i = 0; i + 1 < thread_count; i++) {
+    workers.emplace_back(&ThreadPool::worker_loop, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+bool ThreadPool::pop_local(size_t index, Task& task) {
+  Queue& queue = *queues[index];
+  std::lock_guard<std::mutex> lock(queue.mutex);
+  if (queue.tasks.empty()) {
+    return false;
+  }
+
+  task = queue.tasks.back();
+  queue.tasks.pop_back();
+  return true;
+}
+
+bool ThreadPool::steal(size_t thief, Task& task) {
+  for (size_t offset = 1; offset < queues.size(); offset++) {
+    Queue& queue = *queues[(thief + offset) % queues.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      task = queue.tasks.front();
+      queue.tasks.pop_front();
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool ThreadPool::find_task(size_t index, Task& task) {
+  if (pop_local(index, task) || steal(index, task)) {
+    pending.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+  return false;
+}
+
+void ThreadPool::run_task(const Task& task) {
+  (*task.body)(task.begin, task.end);
+  task.remaining->fetch_sub(1, std::memory_order_acq_rel);
+}
+
+void ThreadPool::worker_loop(size_t index) {
+  while (true) {
+    Task task;
+    if (find_task(index, task)) {
+      run_task(task);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(wake_mutex);
+    wake.wait(lock, [this] { return stopping || pending.load(std::memory_order_relaxed) > 0; });
+    if (stopping) {
+      return;
+    }
+  }
+}
+
+void ThreadPool::parallel_for(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body) {
+  if (begin >= end) {
+    return;
+  }
+
+  grain = std::max<size_t>(grain, 1);
+  size_t chunks = (end - begin + grain - 1) / grain;
+
+  if (chunks == 1 || workers.empty()) {
+    body(begin, end);
+    return;
+  }
+
+  std::atomic<size_t> remaining{chunks};
+
+  // Counted before queueing so a fast thief never takes pending below zero
+  pending.fetch_add(chunks, std::memory_order_relaxed);
+
+  // Deal chunks round robin so every queue starts with local work
+  for (size_t i = 0; i < chunks; i++) {
+    size_t chunk_begin = begin + i * grain;
+    Task task = {chunk_begin, std::min(chunk_begin + grain, end), &body, &remaining};
+
+    Queue& queue = *queues[i % queues.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_back(task);
+  }
+
+  {
+    // Taken so a worker between its check and its wait still sees the notify
+    std::lock_guard<std::mutex> lock(wake_mutex);
+  }
+  wake.notify_all();
+
+  size_t caller = queues.size() - 1;
+  while (remaining.load(std::memory_order_acquire) > 0) {
+    Task task;
+    if (find_task(caller, task)) {
+      run_task(task);
+    } else {
+      std::this_thread::yield();
+    }
+  }
+}
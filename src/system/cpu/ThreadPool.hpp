@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+
+  public:
+    // Zero picks one worker per hardware thread
+    explicit ThreadPool(size_t thread_count = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Splits [begin, end) into chunks of grain items spread over the worker queues.
+    // Idle workers steal from the front of other queues, the caller helps until done.
+    void parallel_for(size_t begin, size_t end, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+    size_t size() const { return workers.size() + 1; }
+
+  private:
+    struct Task {
+      size_t begin;
+      size_t end;
+      const std::function<void(size_t, size_t)>* body;
+      std::atomic<size_t>* remaining;
+    };
+
+    struct Queue {
+      std::mutex mutex;
+      std::deque<Task> tasks;
+    };
+
+    bool pop_local(size_t index, Task& task);
+    bool steal(size_t thief, Task& task);
+    bool find_task(size_t index, Task& task);
+    void run_task(const Task& task);
+    void worker_loop(size_t index);
+
+    std::vector<std::thread> workers;
+
+    // One queue per worker plus one for the calling thread
+    std::vector<std::unique_ptr<Queue>> queues;
+
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+    std::atomic<size_t> pending{0};
+    bool stopping = false;
+};
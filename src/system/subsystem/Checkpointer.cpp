@@ -0,0 +1,230 @@
+#include "Checkpointer.hpp"
+#include "../FluidSystem.hpp"
+
+#include <vulkan/vulkan_core.h>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+Checkpointer::Checkpointer(VkDevice device, VkPhysicalDevice physical_device, uint32_t capacity) : device(device), physical_device(physical_device), capacity(capacity) {}
+
+Checkpointer::~Checkpointer() {
+  if (!enabled) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_one();
+  writer.join();
+
+  std::cout << "Wrote " << written.load() << " background checkpoints to " << path;
+  if (skipped > 0) {
+    std::cout << ", skipped " << skipped << " while one was still writing";
+  }
+  std::cout << '\n';
+}
+
+void Checkpointer::init() {
+  if (path.empty() || interval == 0) {
+    return;
+  }
+
+  create_readback();
+
+  enabled = true;
+  writer = std::thread(&Checkpointer::writer_loop, this);
+}
+
+void Checkpointer::create_readback() {
+  readback = std::make_unique<HostBuffer>(
+    device,
+    physical_device,
+    sizeof(CheckpointReadback) + sizeof(FluidData) * capacity,
+    VK_BUFFER_USAGE_TRANSFER_DST_BIT
+  );
+  std::memset(readback->map(), 0, sizeof(CheckpointReadback));
+}
+
+void Checkpointer::resize(uint32_t capacity) {
+  flush();
+
+  std::lock_guard<std::mutex> lock(mutex);
+  this->capacity = capacity;
+  if (enabled) {
+    create_readback();
+  }
+}
+
+bool Checkpointer::begin_step() {
+  if (!enabled) {
+    return false;
+  }
+
+  step++;
+  if (step % interval != 0) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (pending_sequence != 0) {
+    skipped++;
+    return false;
+  }
+  return true;
+}
+
+void Checkpointer::record(VkCommandBuffer commandbuffer, VkBuffer particles, VkBuffer counts, const CheckpointHeader& header) {
+  VkMemoryBarrier step_barrier{};
+  step_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  step_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+  step_barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+    VK_PIPELINE_STAGE_TRANSFER_BIT,
+    0,
+    1, &step_barrier,
+    0, nullptr,
+    0, nullptr
+  );
+
+  VkBufferCopy count_copy{};
+  count_copy.srcOffset = 0;
+  count_copy.dstOffset = offsetof(CheckpointReadback, counts);
+  count_copy.size = sizeof(PopulationCounts);
+  vkCmdCopyBuffer(commandbuffer, counts, readback->buffer, 1, &count_copy);
+
+  VkBufferCopy particle_copy{};
+  particle_copy.srcOffset = 0;
+  particle_copy.dstOffset = sizeof(CheckpointReadback);
+  particle_copy.size = sizeof(FluidData) * capacity;
+  vkCmdCopyBuffer(commandbuffer, particles, readback->buffer, 1, &particle_copy);
+
+  // The sequence lands after the copies, so a matching sequence means a whole state
+  VkBufferMemoryBarrier copy_barrier{};
+  copy_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  copy_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  copy_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  copy_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  copy_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  copy_barrier.buffer = readback->buffer;
+  copy_barrier.offset = 0;
+  copy_barrier.size = VK_WHOLE_SIZE;
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_TRANSFER_BIT,
+    VK_PIPELINE_STAGE_TRANSFER_BIT,
+    0,
+    0, nullptr,
+    1, &copy_barrier,
+    0, nullptr
+  );
+
+  vkCmdFillBuffer(commandbuffer, readback->buffer, offsetof(CheckpointReadback, sequence), sizeof(uint32_t), next_sequence);
+
+  VkBufferMemoryBarrier host_barrier = copy_barrier;
+  host_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_TRANSFER_BIT,
+    VK_PIPELINE_STAGE_HOST_BIT,
+    0,
+    0, nullptr,
+    1, &host_barrier,
+    0, nullptr
+  );
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending_sequence = next_sequence;
+    pending_header = header;
+  }
+  wake.notify_one();
+
+  next_sequence = next_sequence == UINT32_MAX ? 1 : next_sequence + 1;
+}
+
+void Checkpointer::flush() {
+  if (!enabled) {
+    return;
+  }
+
+  const volatile uint32_t* sequence = static_cast<const volatile uint32_t*>(readback->map());
+
+  std::unique_lock<std::mutex> lock(mutex);
+  // The device is idle, a copy that has not landed was never submitted
+  if (pending_sequence != 0 && *sequence != pending_sequence) {
+    pending_sequence = 0;
+    return;
+  }
+  done.wait(lock, [&] { return pending_sequence == 0; });
+}
+
+void Checkpointer::writer_loop() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    wake.wait(lock, [&] { return stopping || pending_sequence != 0; });
+    if (pending_sequence == 0) {
+      return;
+    }
+
+    // Looked up under the lock every time, resize replaces the buffer
+    const char* mapped = static_cast<const char*>(readback->map());
+    const volatile uint32_t* sequence = reinterpret_cast<const volatile uint32_t*>(mapped + offsetof(CheckpointReadback, sequence));
+
+    if (*sequence != pending_sequence) {
+      if (stopping) {
+        // The device is idle by now, what has not landed never will
+        return;
+      }
+      wake.wait_for(lock, std::chrono::microseconds(500));
+      continue;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    CheckpointHeader header = pending_header;
+    lock.unlock();
+    write(header);
+    lock.lock();
+
+    pending_sequence = 0;
+    done.notify_all();
+  }
+}
+
+void Checkpointer::write(const CheckpointHeader& base) {
+  const char* mapped = static_cast<const char*>(readback->map());
+
+  CheckpointReadback state;
+  std::memcpy(&state, mapped, sizeof(CheckpointReadback));
+  const FluidData* slots = reinterpret_cast<const FluidData*>(mapped + sizeof(CheckpointReadback));
+
+  // Emitted particles sit behind the live count until the next sort, removed
+  // ones are dropped so the file only holds what a restore needs
+  uint32_t count = std::min(state.counts.total, capacity);
+  std::vector<FluidData> live;
+  live.reserve(count);
+  for (uint32_t i = 0; i < count; i++) {
+    if (slots[i].velocity.w >= 0.0f) live.push_back(slots[i]);
+  }
+
+  CheckpointHeader header = base;
+  header.step = state.counts.step;
+  header.live = static_cast<uint32_t>(live.size());
+
+  try {
+    Checkpoint::write(path, header, live.data());
+    written++;
+  } catch (const std::exception& error) {
+    std::cerr << error.what() << '\n';
+  }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "../../buffer/HostBuffer.hpp"
+#include "../../record/Checkpoint.hpp"
+#include "Population.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Start of the readback buffer, the particle slots follow
+struct alignas(16) CheckpointReadback {
+  // Written last, after the copies, so a matching sequence means a whole state
+  uint32_t sequence;
+  uint32_t padding[3];
+  PopulationCounts counts;
+};
+
+class Checkpointer {
+
+  public:
+    // Copies the particle buffer and the counts into a persistently mapped
+    // host buffer at the end of every interval-th step. A writer thread
+    // writes the checkpoint once the copy has landed, so the step never
+    // waits on the disk. A checkpoint falling due while the previous one is
+    // still being written is skipped.
+    Checkpointer(VkDevice device, VkPhysicalDevice physical_device, uint32_t capacity);
+    ~Checkpointer();
+
+    Checkpointer(const Checkpointer&) = delete;
+    Checkpointer& operator=(const Checkpointer&) = delete;
+
+    void init();
+
+    // True when this step is due and the readback buffer is free
+    bool begin_step();
+    void record(VkCommandBuffer commandbuffer, VkBuffer particles, VkBuffer counts, const CheckpointHeader& header);
+
+    // Waits for the writer to finish what has landed, the device must be idle
+    void flush();
+    // Reallocates the readback for capacity particles, flushes first
+    void resize(uint32_t capacity);
+
+    // Empty turns checkpoints off
+    inline static std::string path;
+    // Steps between background checkpoints, zero only writes one at exit
+    inline static uint32_t interval = 0;
+
+  private:
+    void create_readback();
+    void writer_loop();
+    void write(const CheckpointHeader& header);
+
+    VkDevice device;
+    VkPhysicalDevice physical_device;
+    uint32_t capacity;
+
+    std::unique_ptr<HostBuffer> readback;
+    uint64_t step = 0;
+    uint32_t next_sequence = 1;
+    bool enabled = false;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    // Sequence the writer waits on, zero when the buffer is free
+    uint32_t pending_sequence = 0;
+    CheckpointHeader pending_header;
+    bool stopping = false;
+    std::thread writer;
+
+    std::atomic<uint64_t> written{0};
+    uint64_t skipped = 0;
+};
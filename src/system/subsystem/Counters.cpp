@@ -0,0 +1,213 @@
+#include "Counters.hpp"
+#include "../Solver.hpp"
+
+#include <vulkan/vulkan_core.h>
+#include <array>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+
+Counters::Counters(VkDevice device, VkPhysicalDevice physical_device) : device(device), physical_device(physical_device) {
+  counters = std::make_unique<Buffer>(
+    device,
+    physical_device,
+    sizeof(SimulationCounters),
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+  );
+}
+
+void Counters::init(DescriptorBuilder& builder, VkDescriptorSetLayout data_layout, VkDescriptorSetLayout density_layout, VkDescriptorSetLayout count_layout) {
+  if (interval == 0) {
+    return;
+  }
+
+  SimulationCounters empty{};
+  for (auto& readback : readbacks) {
+    readback = std::make_unique<HostBuffer>(device, physical_device, sizeof(SimulationCounters), VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    readback->fillData(&empty, sizeof(SimulationCounters));
+  }
+
+  occupancy_pipeline = std::make_unique<ComputePipeline>(device, "shaders/vertex.occupancy.comp.spv");
+  occupancy_pipeline->create({data_layout, density_layout, count_layout}, {}, Solver::specialization(true));
+}
+
+void Counters::begin_frame(uint32_t current_frame) {
+  frame = current_frame;
+  if (interval == 0) {
+    return;
+  }
+
+  // Oldest first from next_slot, so the newest of a batch is the one kept
+  for (uint32_t i = 0; i < READBACK_SLOTS; i++) {
+    uint32_t slot = (next_slot + i) % READBACK_SLOTS;
+    if (pending[slot] != frame + 1) continue;
+
+    readbacks[slot]->getData(&sample);
+    sampled = true;
+    report(std::cout);
+    pending[slot] = 0;
+  }
+}
+
+bool Counters::begin_step() {
+  if (interval == 0) {
+    return false;
+  }
+
+  // Skips the sample rather than wait when every slot is still in flight
+  bool counting = step % interval == 0 && pending[next_slot] == 0;
+  step++;
+  return counting;
+}
+
+void Counters::reset(VkCommandBuffer commandbuffer) {
+  // The previous sample's copy still reads the counters
+  VkBufferMemoryBarrier copy_barrier{};
+  copy_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  copy_barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  copy_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  copy_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  copy_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  copy_barrier.buffer = counters->buffer;
+  copy_barrier.offset = 0;
+  copy_barrier.size = VK_WHOLE_SIZE;
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_TRANSFER_BIT,
+    VK_PIPELINE_STAGE_TRANSFER_BIT,
+    0,
+    0, nullptr,
+    1, &copy_barrier,
+    0, nullptr
+  );
+
+  vkCmdFillBuffer(commandbuffer, counters->buffer, 0, counters->size, 0);
+
+  VkBufferMemoryBarrier reset_barrier{};
+  reset_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  reset_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  reset_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  reset_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  reset_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  reset_barrier.buffer = counters->buffer;
+  reset_barrier.offset = 0;
+  reset_barrier.size = VK_WHOLE_SIZE;
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_TRANSFER_BIT,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    0,
+    0, nullptr,
+    1, &reset_barrier,
+    0, nullptr
+  );
+}
+
+void Counters::occupancy(VkCommandBuffer commandbuffer, VkDescriptorSet data_set, VkDescriptorSet density_set, VkDescriptorSet count_set, VkBuffer count_buffer, VkDeviceSize count_offset) {
+  std::array<VkDescriptorSet, 3> sets = {data_set, density_set, count_set};
+  occupancy_pipeline->bind_descriptor_sets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, 0, static_cast<uint32_t>(sets.size()), sets.data());
+  occupancy_pipeline->bind_pipeline(commandbuffer);
+  vkCmdDispatchIndirect(commandbuffer, count_buffer, count_offset);
+
+  // Density and move add to the same counters with atomics
+  VkBufferMemoryBarrier occupancy_barrier{};
+  occupancy_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  occupancy_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  occupancy_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  occupancy_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  occupancy_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  occupancy_barrier.buffer = counters->buffer;
+  occupancy_barrier.offset = 0;
+  occupancy_barrier.size = VK_WHOLE_SIZE;
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    0,
+    0, nullptr,
+    1, &occupancy_barrier,
+    0, nullptr
+  );
+}
+
+void Counters::read_back(VkCommandBuffer commandbuffer) {
+  VkBufferMemoryBarrier counter_barrier{};
+  counter_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  counter_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  counter_barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  counter_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  counter_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  counter_barrier.buffer = counters->buffer;
+  counter_barrier.offset = 0;
+  counter_barrier.size = VK_WHOLE_SIZE;
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    VK_PIPELINE_STAGE_TRANSFER_BIT,
+    0,
+    0, nullptr,
+    1, &counter_barrier,
+    0, nullptr
+  );
+
+  HostBuffer& readback = *readbacks[next_slot];
+
+  VkBufferCopy region{};
+  region.size = counters->size;
+  vkCmdCopyBuffer(commandbuffer, counters->buffer, readback.buffer, 1, &region);
+
+  VkBufferMemoryBarrier host_barrier{};
+  host_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  host_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  host_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  host_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  host_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  host_barrier.buffer = readback.buffer;
+  host_barrier.offset = 0;
+  host_barrier.size = VK_WHOLE_SIZE;
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_TRANSFER_BIT,
+    VK_PIPELINE_STAGE_HOST_BIT,
+    0,
+    0, nullptr,
+    1, &host_barrier,
+    0, nullptr
+  );
+
+  // Read in begin_frame once this frame slot's fence has been waited on again
+  pending[next_slot] = frame + 1;
+  next_slot = (next_slot + 1) % READBACK_SLOTS;
+}
+
+void Counters::report(std::ostream& out) const {
+  auto percent = [](uint32_t part, uint32_t whole) {
+    return whole == 0 ? 0.0 : 100.0 * part / whole;
+  };
+
+  // Lower edge of the bin holding the p-th particle
+  auto percentile = [&](double p) {
+    uint64_t target = static_cast<uint64_t>(p * sample.particles);
+    uint64_t seen = 0;
+    for (uint32_t bin = 0; bin < SimulationCounters::HISTOGRAM_BINS; bin++) {
+      seen += sample.neighbour_histogram[bin];
+      if (seen > target) return bin * SimulationCounters::NEIGHBOUR_BIN_WIDTH;
+    }
+    return (SimulationCounters::HISTOGRAM_BINS - 1) * SimulationCounters::NEIGHBOUR_BIN_WIDTH;
+  };
+
+  double mean_neighbours = sample.particles == 0 ? 0.0 : static_cast<double>(sample.density_neighbours) / sample.particles;
+
+  out << std::fixed << std::setprecision(1)
+      << "counters: density " << sample.density_candidates << " pairs, " << percent(sample.density_neighbours, sample.density_candidates) << "% inside h"
+      << " | move " << sample.move_candidates << " pairs, " << percent(sample.move_neighbours, sample.move_candidates) << "% inside h"
+      << " | neighbours mean " << mean_neighbours << ", p50 >= " << percentile(0.5) << ", p95 >= " << percentile(0.95)
+      << " | keys " << sample.occupied_keys << " occupied, " << sample.collided_keys << " collided, max " << sample.max_per_key << " per key"
+      << '\n';
+}
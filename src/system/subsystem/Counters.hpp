@@ -0,0 +1,84 @@
+#pragma once
+
+#include "../../buffer/Buffer.hpp"
+#include "../../buffer/HostBuffer.hpp"
+#include "../../pipeline/ComputePipeline.hpp"
+#include "../../descriptors/DescriptorBuilder.hpp"
+
+#include <array>
+#include <memory>
+#include <ostream>
+
+// Same layout as the Counters block in density.comp, move.comp and occupancy.comp
+struct SimulationCounters {
+  static constexpr uint32_t HISTOGRAM_BINS = 32;
+  static constexpr uint32_t NEIGHBOUR_BIN_WIDTH = 4;
+  static constexpr uint32_t OCCUPANCY_BIN_WIDTH = 2;
+
+  // Pairs walked in the 27 cell search, and those inside the smoothing radius
+  uint32_t density_candidates;
+  uint32_t density_neighbours;
+  uint32_t move_candidates;
+  uint32_t move_neighbours;
+  // Particles the density pass ran for
+  uint32_t particles;
+
+  // Hash keys holding particles, keys shared by more than one grid cell, and the longest run
+  uint32_t occupied_keys;
+  uint32_t collided_keys;
+  uint32_t max_per_key;
+
+  uint32_t neighbour_histogram[HISTOGRAM_BINS];
+  uint32_t occupancy_histogram[HISTOGRAM_BINS];
+};
+
+class Counters {
+
+  public:
+    // Counts one step in every interval with the counting variants of the
+    // density and move shaders and an occupancy pass over the key runs. The
+    // results are copied into a ring of host buffers, each read once the fence
+    // of the frame that copied into it has been waited on, so a sample shows
+    // up a frame slot after its step and reading never stalls the queue.
+    Counters(VkDevice device, VkPhysicalDevice physical_device);
+    void init(DescriptorBuilder& builder, VkDescriptorSetLayout data, VkDescriptorSetLayout density, VkDescriptorSetLayout count);
+
+    // Bound at binding 2 of the density set, move already uses every set
+    const VkDescriptorBufferInfo* get_info() { return counters->get_info(); }
+
+    // Publishes what this frame slot copied last time, after its fence has signalled
+    void begin_frame(uint32_t frame);
+    // True when this step should be counted
+    bool begin_step();
+
+    void reset(VkCommandBuffer commandbuffer);
+    void occupancy(VkCommandBuffer commandbuffer, VkDescriptorSet data_set, VkDescriptorSet density_set, VkDescriptorSet count_set, VkBuffer count_buffer, VkDeviceSize count_offset);
+    void read_back(VkCommandBuffer commandbuffer);
+
+    bool has_sample() const { return sampled; }
+    const SimulationCounters& latest() const { return sample; }
+    void report(std::ostream& out) const;
+
+    // Steps between samples, zero turns counting off
+    inline static uint32_t interval = 0;
+
+  private:
+    static constexpr uint32_t READBACK_SLOTS = 8;
+
+    VkDevice device;
+    VkPhysicalDevice physical_device;
+
+    std::unique_ptr<Buffer> counters;
+    std::array<std::unique_ptr<HostBuffer>, READBACK_SLOTS> readbacks;
+    // Frame slot plus one that copied into each readback, zero when free
+    std::array<uint32_t, READBACK_SLOTS> pending{};
+
+    uint32_t next_slot = 0;
+    uint32_t frame = 0;
+    uint64_t step = 0;
+
+    SimulationCounters sample{};
+    bool sampled = false;
+
+    std::unique_ptr<ComputePipeline> occupancy_pipeline;
+};
@@ -0,0 +1,189 @@
+
+#include "DistanceField.hpp"
+#include "../../command/UploadManager.hpp"
+
+#include <vulkan/vulkan_core.h>
+#include <array>
+#include <limits>
+
+DistanceField::DistanceField(
+  VkDevice device,
+  VkPhysicalDevice physical_device,
+  DescriptorBuilder& builder,
+  uint32_t resolution
+) : device(device), physical_device(physical_device), resolution(resolution) {
+
+  volume = std::make_unique<Volume>(
+    device,
+    physical_device,
+    resolution, resolution, resolution,
+    VK_FORMAT_R16G16B16A16_SFLOAT,
+    VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT
+  );
+
+  params_buffer = std::make_unique<HostBuffer>(
+    device,
+    physical_device,
+    sizeof(DistanceFieldParams),
+    VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT
+  );
+
+  DistanceFieldParams params{};
+  params_buffer->fillData(&params, sizeof(DistanceFieldParams));
+
+  builder.clear();
+
+  builder.bind_image(0, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, volume->get_sampled_info());
+  builder.bind_buffer(1, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, params_buffer->get_info());
+  builder.build(set, layout);
+  builder.clear();
+
+  builder.bind_image(0, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, volume->get_storage_info());
+  builder.build(volume_set, volume_layout);
+  builder.clear();
+}
+
+void DistanceField::add_mesh(const Entity& entity, const glm::mat4& transform, bool container) {
+  BakeMesh mesh{};
+  mesh.container = container;
+  mesh.triangles.reserve(entity.indices.size());
+
+  for (uint32_t index : entity.indices) {
+    glm::vec4 position = transform * glm::vec4(entity.vertices[index].position, 1.0f);
+    mesh.triangles.push_back(position);
+  }
+
+  meshes.push_back(std::move(mesh));
+}
+
+void DistanceField::bake(CommandPool& commandpool, DescriptorBuilder& builder) {
+  DistanceFieldParams params{};
+
+  if (meshes.empty()) {
+    // Nothing to collide with, the volume only needs a valid layout for the descriptor
+    VkCommandBuffer commandbuffer = commandpool.start_single_command();
+    volume->transition_layout(
+      commandbuffer,
+      VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+      0, VK_ACCESS_SHADER_READ_BIT,
+      VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+    );
+    commandpool.end_single_command(commandbuffer);
+
+    params_buffer->fillData(&params, sizeof(DistanceFieldParams));
+    return;
+  }
+
+  glm::vec3 minimum(std::numeric_limits<float>::max());
+  glm::vec3 maximum(std::numeric_limits<float>::lowest());
+  for (const auto& mesh : meshes) {
+    for (const auto& vertex : mesh.triangles) {
+      minimum = glm::min(minimum, glm::vec3(vertex));
+      maximum = glm::max(maximum, glm::vec3(vertex));
+    }
+  }
+
+  // Leave room around the mesh so the clamped edge voxels stay outside obstacles
+  glm::vec3 extent = maximum - minimum;
+  glm::vec3 padding = extent * 0.05f + 2.0f * extent / static_cast<float>(resolution) + glm::vec3(0.2f);
+  minimum -= padding;
+  maximum += padding;
+
+  std::vector<std::unique_ptr<Buffer>> triangle_buffers;
+  std::vector<VkDescriptorSet> triangle_sets(meshes.size());
+  triangle_buffers.reserve(meshes.size());
+
+  for (size_t i = 0; i < meshes.size(); i++) {
+    VkDeviceSize size = sizeof(glm::vec4) * meshes[i].triangles.size();
+
+    triangle_buffers.push_back(std::make_unique<Buffer>(
+      device,
+      physical_device,
+      size,
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+    ));
+    commandpool.uploads().upload(triangle_buffers.back()->buffer, 0, meshes[i].triangles.data(), size);
+
+    builder.bind_buffer(0, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, triangle_buffers.back()->get_info());
+    builder.build(triangle_sets[i], triangle_layout);
+    builder.clear();
+  }
+
+  VkPushConstantRange constant{};
+  constant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  constant.size = sizeof(BakeConstant);
+  constant.offset = 0;
+
+  bake_pipeline = std::make_unique<ComputePipeline>(device, "shaders/vertex.bake.comp.spv");
+  bake_pipeline->create({volume_layout, triangle_layout}, {constant});
+
+  VkCommandBuffer commandbuffer = commandpool.start_single_command();
+
+  volume->transition_layout(
+    commandbuffer,
+    VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+    0, VK_ACCESS_TRANSFER_WRITE_BIT,
+    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT
+  );
+
+  // Start far from everything, each mesh then takes the minimum
+  VkClearColorValue far_value{};
+  far_value.float32[1] = 1.0f;
+  far_value.float32[3] = 1000.0f;
+
+  VkImageSubresourceRange range{};
+  range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  range.baseMipLevel = 0;
+  range.levelCount = 1;
+  range.baseArrayLayer = 0;
+  range.layerCount = 1;
+  vkCmdClearColorImage(commandbuffer, volume->image, VK_IMAGE_LAYOUT_GENERAL, &far_value, 1, &range);
+
+  volume->transition_layout(
+    commandbuffer,
+    VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+    VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+    VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+  );
+
+  bake_pipeline->bind_pipeline(commandbuffer);
+  uint32_t groups = (resolution + 3) / 4;
+
+  for (size_t i = 0; i < meshes.size(); i++) {
+    BakeConstant bake_constant{};
+    bake_constant.minimum = glm::vec4(minimum, 0.0f);
+    bake_constant.maximum = glm::vec4(maximum, 0.0f);
+    bake_constant.resolution = resolution;
+    bake_constant.triangle_count = static_cast<uint32_t>(meshes[i].triangles.size() / 3);
+    bake_constant.container = meshes[i].container ? 1 : 0;
+
+    std::array<VkDescriptorSet, 2> sets = {volume_set, triangle_sets[i]};
+    bake_pipeline->bind_descriptor_sets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, 0, static_cast<uint32_t>(sets.size()), sets.data());
+    bake_pipeline->bind_push_constants(commandbuffer, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(BakeConstant), &bake_constant);
+    vkCmdDispatch(commandbuffer, groups, groups, groups);
+
+    volume->transition_layout(
+      commandbuffer,
+      VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+      VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+    );
+  }
+
+  volume->transition_layout(
+    commandbuffer,
+    VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+    VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+  );
+
+  commandpool.end_single_command(commandbuffer);
+
+  params.minimum = glm::vec4(minimum, 0.0f);
+  params.maximum = glm::vec4(maximum, 0.0f);
+  params.enabled = 1;
+  params_buffer->fillData(&params, sizeof(DistanceFieldParams));
+
+  meshes.clear();
+}
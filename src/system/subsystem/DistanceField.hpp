@@ -0,0 +1,65 @@
+#pragma once
+
+#include "../../buffer/HostBuffer.hpp"
+#include "../../image/Volume.hpp"
+#include "../../pipeline/ComputePipeline.hpp"
+#include "../../descriptors/DescriptorBuilder.hpp"
+#include "../../scene/Entity.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <vector>
+
+struct DistanceFieldParams {
+  alignas(16) glm::vec4 minimum;
+  alignas(16) glm::vec4 maximum;
+  uint32_t enabled;
+};
+
+class DistanceField {
+
+  public:
+    // Meshes are baked once into a signed distance volume, positive where
+    // fluid is allowed. Particles then take one trilinear fetch per step.
+    DistanceField(VkDevice device, VkPhysicalDevice physical_device, DescriptorBuilder& builder, uint32_t resolution);
+
+    // Obstacles keep fluid outside the mesh, containers keep it inside
+    void add_mesh(const Entity& entity, const glm::mat4& transform, bool container);
+    void bake(CommandPool& commandpool, DescriptorBuilder& builder);
+
+    VkDescriptorSet set;
+    VkDescriptorSetLayout layout;
+
+  private:
+    struct BakeConstant {
+      alignas(16) glm::vec4 minimum;
+      alignas(16) glm::vec4 maximum;
+      uint32_t resolution;
+      uint32_t triangle_count;
+      uint32_t container;
+    };
+
+    struct BakeMesh {
+      std::vector<glm::vec4> triangles;
+      bool container;
+    };
+
+    VkDevice device;
+    VkPhysicalDevice physical_device;
+    uint32_t resolution;
+
+    std::vector<BakeMesh> meshes;
+
+    std::unique_ptr<Volume> volume;
+    std::unique_ptr<HostBuffer> params_buffer;
+
+    VkDescriptorSet volume_set;
+    VkDescriptorSetLayout volume_layout;
+    VkDescriptorSetLayout triangle_layout;
+
+    std::unique_ptr<ComputePipeline> bake_pipeline;
+};
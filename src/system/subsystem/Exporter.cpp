@@ -0,0 +1,356 @@
+#include "Exporter.hpp"
+#include "../../record/FrameCodec.hpp"
+
+#include <vulkan/vulkan_core.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+Exporter::Exporter(VkDevice device, VkPhysicalDevice physical_device, uint32_t capacity) : device(device), physical_device(physical_device), capacity(capacity) {}
+
+Exporter::~Exporter() {
+  if (!enabled) {
+    return;
+  }
+
+  // Owners wait for the device first, so whatever landed gets written and
+  // anything still pending was never submitted
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_one();
+  writer.join();
+
+  std::cout << "Exported " << written.load() << " frames to " << directory;
+  if (dropped > 0) {
+    std::cout << ", dropped " << dropped << " with every slot busy";
+  }
+  std::cout << '\n';
+}
+
+Exporter::Format Exporter::parse_format(const std::string& name) {
+  if (name == "raw") return Format::raw;
+  if (name == "ply") return Format::ply;
+  if (name == "vtk") return Format::vtk;
+  if (name == "fsq") return Format::fsq;
+  throw std::runtime_error("Unknown export format '" + name + "', expected raw, ply, vtk or fsq");
+}
+
+void Exporter::init(DescriptorBuilder& builder, VkDescriptorSetLayout data_layout, VkDescriptorSetLayout count_layout) {
+  if (directory.empty()) {
+    return;
+  }
+
+  std::filesystem::create_directories(directory);
+
+  uint32_t slot_count = std::max(slots, 1u);
+  buffers.resize(slot_count);
+  sets.resize(slot_count);
+  busy = std::make_unique<std::atomic<uint32_t>[]>(slot_count);
+
+  for (uint32_t slot = 0; slot < slot_count; slot++) {
+    busy[slot] = 0;
+    create_slot(builder, slot);
+    builder.build(sets[slot], layout);
+    builder.clear();
+  }
+
+  if (format == Format::fsq) {
+    encoder = std::make_unique<ThreadPool>();
+  }
+
+  pipeline = std::make_unique<ComputePipeline>(device, "shaders/vertex.export.comp.spv");
+  pipeline->create({data_layout, layout, count_layout});
+
+  enabled = true;
+  writer = std::thread(&Exporter::writer_loop, this);
+}
+
+// Leaves the slot's binding on the builder for the caller to build or update
+void Exporter::create_slot(DescriptorBuilder& builder, uint32_t slot) {
+  buffers[slot] = std::make_unique<HostBuffer>(
+    device,
+    physical_device,
+    sizeof(SnapshotHeader) + sizeof(float) * 8 * capacity,
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT
+  );
+  std::memset(buffers[slot]->map(), 0, sizeof(SnapshotHeader));
+
+  builder.bind_buffer(0, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, buffers[slot]->get_info());
+}
+
+void Exporter::flush() {
+  if (!enabled) {
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(mutex);
+  // The device is idle, a frame that has not landed was never submitted.
+  // Those sit at the back, behind everything that did land.
+  while (!pending.empty()) {
+    const char* mapped = static_cast<const char*>(buffers[pending.back().slot]->map());
+    const volatile uint32_t* sequence = reinterpret_cast<const volatile uint32_t*>(mapped + offsetof(SnapshotHeader, sequence));
+    if (*sequence == pending.back().sequence) {
+      break;
+    }
+    busy[pending.back().slot].store(0, std::memory_order_release);
+    pending.pop_back();
+  }
+  done.wait(lock, [&] { return pending.empty(); });
+}
+
+void Exporter::resize(DescriptorBuilder& builder, uint32_t capacity) {
+  flush();
+  this->capacity = capacity;
+  if (!enabled) {
+    return;
+  }
+
+  builder.clear();
+  for (uint32_t slot = 0; slot < buffers.size(); slot++) {
+    create_slot(builder, slot);
+    builder.update(sets[slot]);
+    builder.clear();
+  }
+}
+
+bool Exporter::begin_step() {
+  if (!enabled) {
+    return false;
+  }
+
+  bool exporting = step % std::max(interval, 1u) == 0;
+  step++;
+  if (!exporting) {
+    return false;
+  }
+
+  if (busy[next_slot].load(std::memory_order_acquire) != 0) {
+    dropped++;
+    frame++;
+    return false;
+  }
+  return true;
+}
+
+void Exporter::record(VkCommandBuffer commandbuffer, VkDescriptorSet data_set, VkDescriptorSet count_set, VkBuffer count_buffer, VkDeviceSize count_offset) {
+  HostBuffer& target = *buffers[next_slot];
+
+  // An empty population dispatches nothing, so the count is cleared up front
+  vkCmdFillBuffer(commandbuffer, target.buffer, offsetof(SnapshotHeader, count), sizeof(uint32_t), 0);
+
+  VkMemoryBarrier step_barrier{};
+  step_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  step_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+  step_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+    0,
+    1, &step_barrier,
+    0, nullptr,
+    0, nullptr
+  );
+
+  std::array<VkDescriptorSet, 3> bound = {data_set, sets[next_slot], count_set};
+  pipeline->bind_descriptor_sets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, 0, static_cast<uint32_t>(bound.size()), bound.data());
+  pipeline->bind_pipeline(commandbuffer);
+  vkCmdDispatchIndirect(commandbuffer, count_buffer, count_offset);
+
+  // The sequence lands after the points, so a matching sequence means a whole frame
+  VkBufferMemoryBarrier points_barrier{};
+  points_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  points_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  points_barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  points_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  points_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  points_barrier.buffer = target.buffer;
+  points_barrier.offset = 0;
+  points_barrier.size = VK_WHOLE_SIZE;
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    VK_PIPELINE_STAGE_TRANSFER_BIT,
+    0,
+    0, nullptr,
+    1, &points_barrier,
+    0, nullptr
+  );
+
+  vkCmdFillBuffer(commandbuffer, target.buffer, offsetof(SnapshotHeader, sequence), sizeof(uint32_t), next_sequence);
+
+  VkBufferMemoryBarrier host_barrier = points_barrier;
+  host_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  host_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_TRANSFER_BIT,
+    VK_PIPELINE_STAGE_HOST_BIT,
+    0,
+    0, nullptr,
+    1, &host_barrier,
+    0, nullptr
+  );
+
+  busy[next_slot].store(next_sequence, std::memory_order_release);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.push_back({next_slot, next_sequence, frame});
+  }
+  wake.notify_one();
+
+  frame++;
+  next_slot = (next_slot + 1) % buffers.size();
+  next_sequence = next_sequence == UINT32_MAX ? 1 : next_sequence + 1;
+}
+
+void Exporter::writer_loop() {
+  while (true) {
+    Pending next;
+    const char* mapped = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake.wait(lock, [&] { return stopping || !pending.empty(); });
+      if (pending.empty()) {
+        return;
+      }
+      next = pending.front();
+
+      // Slots are filled in submit order, so only the oldest needs polling.
+      // Polled under the lock, flush drops frames that never landed and resize
+      // replaces their buffers.
+      mapped = static_cast<const char*>(buffers[next.slot]->map());
+      const volatile uint32_t* sequence = reinterpret_cast<const volatile uint32_t*>(mapped + offsetof(SnapshotHeader, sequence));
+
+      if (*sequence != next.sequence) {
+        if (stopping) {
+          // The device is idle by now, what has not landed never will
+          pending.clear();
+          return;
+        }
+        wake.wait_for(lock, std::chrono::microseconds(500));
+        continue;
+      }
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    SnapshotHeader header;
+    std::memcpy(&header, mapped, sizeof(SnapshotHeader));
+    write_frame(header, reinterpret_cast<const float*>(mapped + sizeof(SnapshotHeader)), next.frame);
+    written++;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      pending.pop_front();
+      busy[next.slot].store(0, std::memory_order_release);
+    }
+    done.notify_all();
+  }
+}
+
+// VTK legacy binary is big endian
+static void write_big_endian(std::ofstream& file, const void* value) {
+  char bytes[4];
+  std::memcpy(bytes, value, 4);
+  std::swap(bytes[0], bytes[3]);
+  std::swap(bytes[1], bytes[2]);
+  file.write(bytes, 4);
+}
+
+void Exporter::write_frame(const SnapshotHeader& header, const float* points, uint64_t frame) {
+  uint32_t count = std::min(header.count, capacity);
+
+  // Removed particles are dropped here, packed so each format is one write
+  FramePoints live;
+  live.values.reserve(count * 8);
+  for (uint32_t i = 0; i < count; i++) {
+    if (points[i * 8 + 3] >= 0.0f) live.values.insert(live.values.end(), points + i * 8, points + i * 8 + 8);
+  }
+  uint32_t live_count = static_cast<uint32_t>(live.count());
+  const std::vector<float>& values = live.values;
+
+  static const char* EXTENSIONS[] = {"bin", "ply", "vtk", "fsq"};
+  std::ostringstream name;
+  name << directory << "/frame_" << std::setw(6) << std::setfill('0') << frame << "." << EXTENSIONS[static_cast<int>(format)];
+
+  std::ofstream file(name.str(), std::ios::binary);
+  if (!file.is_open()) {
+    std::cerr << "Unable to write " << name.str() << '\n';
+    return;
+  }
+
+  switch (format) {
+    // Live count, then x y z density vx vy vz and one unused as little endian floats
+    case Format::raw:
+      file.write(reinterpret_cast<const char*>(&live_count), sizeof(uint32_t));
+      file.write(reinterpret_cast<const char*>(values.data()), sizeof(float) * values.size());
+      break;
+
+    case Format::ply:
+      file << "ply\n"
+           << "format binary_little_endian 1.0\n"
+           << "element vertex " << live_count << "\n"
+           << "property float x\n"
+           << "property float y\n"
+           << "property float z\n"
+           << "property float density\n"
+           << "property float vx\n"
+           << "property float vy\n"
+           << "property float vz\n"
+           << "property float unused\n"
+           << "end_header\n";
+      file.write(reinterpret_cast<const char*>(values.data()), sizeof(float) * values.size());
+      break;
+
+    case Format::vtk:
+      file << "# vtk DataFile Version 3.0\n"
+           << "fluidsim frame " << frame << "\n"
+           << "BINARY\n"
+           << "DATASET POLYDATA\n"
+           << "POINTS " << live_count << " float\n";
+      for (uint32_t i = 0; i < live_count; i++) {
+        for (int axis = 0; axis < 3; axis++) write_big_endian(file, &values[i * 8 + axis]);
+      }
+
+      file << "\nVERTICES " << live_count << " " << live_count * 2 << "\n";
+      for (uint32_t i = 0; i < live_count; i++) {
+        int32_t cell[2] = {1, static_cast<int32_t>(i)};
+        write_big_endian(file, &cell[0]);
+        write_big_endian(file, &cell[1]);
+      }
+
+      file << "\nPOINT_DATA " << live_count << "\n"
+           << "SCALARS density float 1\n"
+           << "LOOKUP_TABLE default\n";
+      for (uint32_t i = 0; i < live_count; i++) {
+        write_big_endian(file, &values[i * 8 + 3]);
+      }
+
+      file << "\nVECTORS velocity float\n";
+      for (uint32_t i = 0; i < live_count; i++) {
+        for (int axis = 0; axis < 3; axis++) write_big_endian(file, &values[i * 8 + 4 + axis]);
+      }
+      file << "\n";
+      break;
+
+    // Quantized and chunked, see FrameCodec for the layout and error bounds
+    case Format::fsq: {
+      std::vector<uint8_t> bytes = FrameCodec::encode(live, *encoder);
+      file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+      break;
+    }
+  }
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "../../buffer/HostBuffer.hpp"
+#include "../../pipeline/ComputePipeline.hpp"
+#include "../../descriptors/DescriptorBuilder.hpp"
+#include "../cpu/ThreadPool.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Same layout as the Snapshot block in export.comp, followed by count points
+// of eight floats: x y z density vx vy vz and one unused
+struct SnapshotHeader {
+  // Written last, after the points, so a matching sequence means a whole frame
+  uint32_t sequence;
+  // Slots the pass covered, live and removed
+  uint32_t count;
+  uint32_t padding[2];
+};
+
+class Exporter {
+
+  public:
+    // Packs position, density and velocity of every particle into one of a ring of
+    // persistently mapped host buffers at the end of a step. A writer thread
+    // polls the ring, so nothing ever waits on the queue, and writes each
+    // frame to disk once its sequence has landed. A step finding its slot
+    // still busy is dropped rather than stall the simulation.
+    Exporter(VkDevice device, VkPhysicalDevice physical_device, uint32_t capacity);
+    ~Exporter();
+
+    Exporter(const Exporter&) = delete;
+    Exporter& operator=(const Exporter&) = delete;
+
+    void init(DescriptorBuilder& builder, VkDescriptorSetLayout data, VkDescriptorSetLayout count);
+
+    // True when this step should be exported and a slot is free for it
+    bool begin_step();
+    void record(VkCommandBuffer commandbuffer, VkDescriptorSet data_set, VkDescriptorSet count_set, VkBuffer count_buffer, VkDeviceSize count_offset);
+
+    // Waits for the writer to finish what has landed, the device must be idle
+    void flush();
+    // Reallocates the ring for capacity particles and rewrites its sets, flushes first
+    void resize(DescriptorBuilder& builder, uint32_t capacity);
+
+    enum class Format { raw, ply, vtk, fsq };
+    static Format parse_format(const std::string& name);
+
+    // Empty turns exporting off
+    inline static std::string directory;
+    inline static Format format = Format::raw;
+    // Steps between exported frames
+    inline static uint32_t interval = 1;
+    // Frames in flight between the GPU and the writer, with batched headless
+    // submits this has to cover at least the steps in flight to keep them all
+    inline static uint32_t slots = 8;
+
+  private:
+    struct Pending {
+      uint32_t slot;
+      uint32_t sequence;
+      uint64_t frame;
+    };
+
+    void create_slot(DescriptorBuilder& builder, uint32_t slot);
+    void writer_loop();
+    void write_frame(const SnapshotHeader& header, const float* points, uint64_t frame);
+
+    VkDevice device;
+    VkPhysicalDevice physical_device;
+    uint32_t capacity;
+
+    std::vector<std::unique_ptr<HostBuffer>> buffers;
+    std::vector<VkDescriptorSet> sets;
+    VkDescriptorSetLayout layout;
+    // Sequence a slot waits on, zero once the writer is done with it
+    std::unique_ptr<std::atomic<uint32_t>[]> busy;
+
+    uint32_t next_slot = 0;
+    uint32_t next_sequence = 1;
+    uint64_t step = 0;
+    uint64_t frame = 0;
+    bool enabled = false;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::deque<Pending> pending;
+    bool stopping = false;
+    std::thread writer;
+
+    std::atomic<uint64_t> written{0};
+    uint64_t dropped = 0;
+
+    // Only made for fsq, which encodes its chunks in parallel
+    std::unique_ptr<ThreadPool> encoder;
+
+    std::unique_ptr<ComputePipeline> pipeline;
+};
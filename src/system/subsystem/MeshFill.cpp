@@ -0,0 +1,179 @@
+#include "MeshFill.hpp"
+
+#include <vulkan/vulkan_core.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+static constexpr uint32_t CLEAR = 0;
+static constexpr uint32_t COUNT = 1;
+static constexpr uint32_t SCAN = 2;
+static constexpr uint32_t WRITE = 3;
+
+// Per dispatch dimension, larger lattices spill into y
+static constexpr uint32_t MAX_GROUPS_X = 65535;
+
+MeshFill::MeshFill(VkDevice device, VkPhysicalDevice physical_device) : device(device), physical_device(physical_device) {}
+
+void MeshFill::add_mesh(DescriptorBuilder& builder, const Entity& entity, const glm::mat4& transform, const glm::vec3& velocity) {
+  Region region{};
+  region.field = std::make_unique<DistanceField>(device, physical_device, builder, resolution);
+  // Container mode keeps the inside positive
+  region.field->add_mesh(entity, transform, true);
+  region.velocity = velocity;
+
+  region.minimum = glm::vec3(std::numeric_limits<float>::max());
+  region.maximum = glm::vec3(std::numeric_limits<float>::lowest());
+  for (uint32_t index : entity.indices) {
+    glm::vec3 position = glm::vec3(transform * glm::vec4(entity.vertices[index].position, 1.0f));
+    region.minimum = glm::min(region.minimum, position);
+    region.maximum = glm::max(region.maximum, position);
+  }
+
+  regions.push_back(std::move(region));
+}
+
+glm::uvec3 MeshFill::dimensions(const Region& region) const {
+  glm::vec3 cells = glm::floor((region.maximum - region.minimum) / spacing);
+  return glm::uvec3(glm::max(cells, glm::vec3(1.0f)));
+}
+
+uint64_t MeshFill::lattice_points() const {
+  uint64_t points = 0;
+  for (const auto& region : regions) {
+    glm::uvec3 size = dimensions(region);
+    points += static_cast<uint64_t>(size.x) * size.y * size.z;
+  }
+  return points;
+}
+
+void MeshFill::dispatch(VkCommandBuffer commandbuffer, uint32_t group_count) {
+  uint32_t groups_x = std::max(std::min(group_count, MAX_GROUPS_X), 1u);
+  uint32_t groups_y = (group_count + groups_x - 1) / groups_x;
+  vkCmdDispatch(commandbuffer, groups_x, std::max(groups_y, 1u), 1);
+}
+
+void MeshFill::barrier(VkCommandBuffer commandbuffer) {
+  VkMemoryBarrier memory_barrier{};
+  memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  memory_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+  memory_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    0,
+    1, &memory_barrier,
+    0, nullptr,
+    0, nullptr
+  );
+}
+
+void MeshFill::fill(
+  CommandPool& commandpool,
+  DescriptorBuilder& builder,
+  VkDescriptorSet data_set,
+  VkDescriptorSetLayout data_layout,
+  VkDescriptorSet count_set,
+  VkDescriptorSetLayout count_layout,
+  VkBuffer count_buffer,
+  uint32_t capacity,
+  uint32_t table_cells,
+  uint32_t seed
+) {
+  if (regions.empty()) {
+    return;
+  }
+
+  uint32_t max_groups = 1;
+  for (const auto& region : regions) {
+    glm::uvec3 size = dimensions(region);
+    uint64_t points = static_cast<uint64_t>(size.x) * size.y * size.z;
+    max_groups = std::max(max_groups, static_cast<uint32_t>(std::min<uint64_t>((points + 255) / 256, UINT32_MAX)));
+  }
+
+  // Base slot, padding to a vec4, then one count or offset per lattice group
+  Buffer groups(
+    device,
+    physical_device,
+    sizeof(uint32_t) * (4 + max_groups),
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+  );
+
+  VkDescriptorSet group_set;
+  VkDescriptorSetLayout group_layout;
+  builder.bind_buffer(0, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, groups.get_info());
+  builder.build(group_set, group_layout);
+  builder.clear();
+
+  for (auto& region : regions) {
+    region.field->bake(commandpool, builder);
+  }
+
+  VkPushConstantRange constant{};
+  constant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  constant.size = sizeof(FillConstant);
+  constant.offset = 0;
+
+  pipeline = std::make_unique<ComputePipeline>(device, "shaders/vertex.fill.comp.spv");
+  pipeline->create({data_layout, regions.front().field->layout, group_layout, count_layout}, {constant});
+
+  VkCommandBuffer commandbuffer = commandpool.start_single_command();
+  pipeline->bind_pipeline(commandbuffer);
+
+  // Every mesh appends after the live count, so it starts from nothing
+  vkCmdFillBuffer(commandbuffer, count_buffer, 0, VK_WHOLE_SIZE, 0);
+
+  FillConstant fill_constant{};
+  fill_constant.capacity = capacity;
+  fill_constant.table_cells = table_cells;
+
+  std::array<VkDescriptorSet, 4> sets = {data_set, regions.front().field->set, group_set, count_set};
+  pipeline->bind_descriptor_sets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, 0, static_cast<uint32_t>(sets.size()), sets.data());
+
+  fill_constant.pass = CLEAR;
+  pipeline->bind_push_constants(commandbuffer, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(FillConstant), &fill_constant);
+  dispatch(commandbuffer, (capacity + 255) / 256);
+  barrier(commandbuffer);
+
+  for (size_t i = 0; i < regions.size(); i++) {
+    const Region& region = regions[i];
+    glm::uvec3 size = dimensions(region);
+    uint64_t points = static_cast<uint64_t>(size.x) * size.y * size.z;
+
+    // Centred in the bounds, so the lattice sits evenly inside the surface
+    glm::vec3 used = glm::vec3(size) * spacing;
+    glm::vec3 origin = region.minimum + 0.5f * (region.maximum - region.minimum - used) + 0.5f * spacing;
+
+    fill_constant.origin = glm::vec4(origin, spacing);
+    fill_constant.velocity = glm::vec4(region.velocity, jitter);
+    fill_constant.dimensions = glm::uvec4(size, 0);
+    fill_constant.group_count = static_cast<uint32_t>(std::min<uint64_t>((points + 255) / 256, UINT32_MAX));
+    fill_constant.seed = seed + static_cast<uint32_t>(i) * 0x9e3779b9u;
+
+    sets[1] = region.field->set;
+    pipeline->bind_descriptor_sets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, 0, static_cast<uint32_t>(sets.size()), sets.data());
+
+    fill_constant.pass = COUNT;
+    pipeline->bind_push_constants(commandbuffer, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(FillConstant), &fill_constant);
+    dispatch(commandbuffer, fill_constant.group_count);
+    barrier(commandbuffer);
+
+    fill_constant.pass = SCAN;
+    pipeline->bind_push_constants(commandbuffer, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(FillConstant), &fill_constant);
+    vkCmdDispatch(commandbuffer, 1, 1, 1);
+    barrier(commandbuffer);
+
+    fill_constant.pass = WRITE;
+    pipeline->bind_push_constants(commandbuffer, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(FillConstant), &fill_constant);
+    dispatch(commandbuffer, fill_constant.group_count);
+    barrier(commandbuffer);
+  }
+
+  commandpool.end_single_command(commandbuffer);
+
+  regions.clear();
+}
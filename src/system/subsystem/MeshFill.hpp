@@ -0,0 +1,72 @@
+#pragma once
+
+#include "../../buffer/Buffer.hpp"
+#include "../../pipeline/ComputePipeline.hpp"
+#include "../../descriptors/DescriptorBuilder.hpp"
+#include "../../scene/Entity.hpp"
+#include "DistanceField.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <vector>
+
+class MeshFill {
+
+  public:
+    // Places the starting particles inside meshes on the GPU. Each mesh is
+    // baked into a signed distance volume the same way boundaries are, a
+    // lattice over its bounds keeps the points that land inside, and a
+    // count, scan and write pass packs them straight into the particle
+    // buffer. The host never holds the particles.
+    MeshFill(VkDevice device, VkPhysicalDevice physical_device);
+
+    void add_mesh(DescriptorBuilder& builder, const Entity& entity, const glm::mat4& transform, const glm::vec3& velocity);
+    bool empty() const { return regions.empty(); }
+
+    // Lattice points over every mesh's bounds, the most fill can place
+    uint64_t lattice_points() const;
+
+    // Replaces everything in the particle buffer, sets the live count and the draw's instance count
+    void fill(CommandPool& commandpool, DescriptorBuilder& builder, VkDescriptorSet data_set, VkDescriptorSetLayout data_layout, VkDescriptorSet count_set, VkDescriptorSetLayout count_layout, VkBuffer count_buffer, uint32_t capacity, uint32_t table_cells, uint32_t seed);
+
+    // Distance between neighbouring particles
+    inline static float spacing = 0.16f;
+    // Random offset per particle as a fraction of the spacing, zero for a plain lattice
+    inline static float jitter = 0.5f;
+    // Voxels per side of each mesh's distance volume
+    inline static uint32_t resolution = 96;
+
+  private:
+    struct FillConstant {
+      alignas(16) glm::vec4 origin;
+      alignas(16) glm::vec4 velocity;
+      alignas(16) glm::uvec4 dimensions;
+      uint32_t capacity;
+      uint32_t group_count;
+      uint32_t seed;
+      uint32_t pass;
+      uint32_t table_cells;
+    };
+
+    struct Region {
+      std::unique_ptr<DistanceField> field;
+      glm::vec3 minimum;
+      glm::vec3 maximum;
+      glm::vec3 velocity;
+    };
+
+    glm::uvec3 dimensions(const Region& region) const;
+    void dispatch(VkCommandBuffer commandbuffer, uint32_t group_count);
+    void barrier(VkCommandBuffer commandbuffer);
+
+    VkDevice device;
+    VkPhysicalDevice physical_device;
+
+    std::vector<Region> regions;
+
+    std::unique_ptr<ComputePipeline> pipeline;
+};
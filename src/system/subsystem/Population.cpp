@@ -0,0 +1,323 @@
+
+#include "Population.hpp"
+
+#include <vulkan/vulkan_core.h>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+Population::Population(
+  VkDevice device,
+  VkPhysicalDevice physical_device,
+  uint32_t capacity
+) : device(device), physical_device(physical_device), capacity(capacity) {
+
+  counts = std::make_unique<Buffer>(
+    device,
+    physical_device,
+    sizeof(PopulationCounts),
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+  );
+
+  draw = std::make_unique<Buffer>(
+    device,
+    physical_device,
+    sizeof(VkDrawIndexedIndirectCommand),
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+  );
+
+  readback = std::make_unique<HostBuffer>(
+    device,
+    physical_device,
+    sizeof(PopulationCounts),
+    VK_BUFFER_USAGE_TRANSFER_DST_BIT
+  );
+  std::memset(readback->map(), 0, sizeof(PopulationCounts));
+
+  emitters = std::make_unique<HostBuffer>(
+    device,
+    physical_device,
+    sizeof(EmitterData)*MAX_EMITTERS,
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+  );
+
+  sinks = std::make_unique<HostBuffer>(
+    device,
+    physical_device,
+    sizeof(SinkData)*MAX_SINKS,
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+  );
+}
+
+void Population::init(DescriptorBuilder& builder, VkDescriptorSetLayout data_layout) {
+  builder.clear();
+
+  // binding 0 for the counts, binding 1 for the draw arguments, 2 and 3 for emitters and sinks
+  builder.bind_buffer(0, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, counts->get_info());
+  builder.bind_buffer(1, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, draw->get_info());
+  builder.bind_buffer(2, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, emitters->get_info());
+  builder.bind_buffer(3, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sinks->get_info());
+  builder.build(set, layout);
+  builder.clear();
+
+  VkPushConstantRange constant{};
+  constant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  constant.size = sizeof(PushConstant);
+  constant.offset = 0;
+
+  emit_pipeline = std::make_unique<ComputePipeline>(device, "shaders/vertex.emit.comp.spv");
+  emit_pipeline->create({data_layout, layout}, {constant});
+
+  count_pipeline = std::make_unique<ComputePipeline>(device, "shaders/vertex.count.comp.spv");
+  count_pipeline->create({layout}, {constant});
+
+  sink_pipeline = std::make_unique<ComputePipeline>(device, "shaders/vertex.sink.comp.spv");
+  sink_pipeline->create({data_layout, layout}, {constant});
+}
+
+void Population::add_emitter(const ParticleEmitter& emitter) {
+  if (emitter_data.size() >= MAX_EMITTERS) {
+    throw std::runtime_error("Too many particle emitters");
+  }
+
+  EmitterData data{};
+  data.position = glm::vec4(emitter.position, emitter.radius);
+  data.velocity = glm::vec4(emitter.velocity, static_cast<float>(std::min(emitter.rate, 256u)));
+  emitter_data.push_back(data);
+
+  emitters->fillData(emitter_data.data(), sizeof(EmitterData)*emitter_data.size());
+}
+
+void Population::add_sink(const ParticleSink& sink) {
+  if (sink_data.size() >= MAX_SINKS) {
+    throw std::runtime_error("Too many particle sinks");
+  }
+
+  SinkData data{};
+  data.minimum = glm::vec4(sink.minimum, 0.0f);
+  data.maximum = glm::vec4(sink.maximum, 0.0f);
+  sink_data.push_back(data);
+
+  sinks->fillData(sink_data.data(), sizeof(SinkData)*sink_data.size());
+}
+
+void Population::reset(CommandPool& commandpool, uint32_t live, uint32_t step) {
+  live = std::min(live, capacity);
+
+  // Split the same way as count.comp, past 65535 groups the rest go into y
+  uint32_t groups = (live + 255) / 256;
+  uint32_t groups_x = std::min(groups, 65535u);
+  uint32_t groups_y = groups_x == 0 ? 1 : (groups + groups_x - 1) / groups_x;
+
+  PopulationCounts values{};
+  values.live_x = groups_x;
+  values.live_y = groups_y;
+  values.live_z = 1;
+  values.live = live;
+  values.total_x = groups_x;
+  values.total_y = groups_y;
+  values.total_z = 1;
+  values.total = live;
+  values.step = step;
+
+  // Host loaded particles are drawn before any step rewrites the instance count
+  uint32_t instance_count = live;
+
+  VkCommandBuffer commandbuffer = commandpool.start_single_command();
+  vkCmdUpdateBuffer(commandbuffer, counts->buffer, 0, sizeof(PopulationCounts), &values);
+  vkCmdUpdateBuffer(commandbuffer, draw->buffer, offsetof(VkDrawIndexedIndirectCommand, instanceCount), sizeof(uint32_t), &instance_count);
+  commandpool.end_single_command(commandbuffer);
+}
+
+void Population::set_index_count(CommandPool& commandpool, uint32_t index_count) {
+  // The instance count is rewritten from the live count every step
+  VkDrawIndexedIndirectCommand command{};
+  command.indexCount = index_count;
+
+  VkCommandBuffer commandbuffer = commandpool.start_single_command();
+  vkCmdUpdateBuffer(commandbuffer, draw->buffer, 0, sizeof(VkDrawIndexedIndirectCommand), &command);
+  commandpool.end_single_command(commandbuffer);
+}
+
+void Population::count_barrier(VkCommandBuffer commandbuffer, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access) {
+  std::array<VkBufferMemoryBarrier, 2> barriers{};
+  std::array<VkBuffer, 2> buffers = {counts->buffer, draw->buffer};
+  for (size_t i = 0; i < barriers.size(); i++) {
+    barriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barriers[i].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barriers[i].dstAccessMask = dst_access;
+    barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[i].buffer = buffers[i];
+    barriers[i].offset = 0;
+    barriers[i].size = VK_WHOLE_SIZE;
+  }
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    dst_stage,
+    0,
+    0, nullptr,
+    static_cast<uint32_t>(barriers.size()), barriers.data(),
+    0, nullptr
+  );
+}
+
+void Population::update_counts(VkCommandBuffer commandbuffer, uint32_t mode) {
+  PushConstant constant = {capacity, static_cast<uint32_t>(emitter_data.size()), static_cast<uint32_t>(sink_data.size()), mode};
+
+  count_pipeline->bind_descriptor_sets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, 0, 1, &set);
+  count_pipeline->bind_push_constants(commandbuffer, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstant), &constant);
+  count_pipeline->bind_pipeline(commandbuffer);
+  vkCmdDispatch(commandbuffer, 1, 1, 1);
+
+  count_barrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT
+  );
+}
+
+void Population::emit(VkCommandBuffer commandbuffer, VkDescriptorSet data_set, VkBuffer data_buffer) {
+  if (!emitter_data.empty()) {
+    PushConstant constant = {capacity, static_cast<uint32_t>(emitter_data.size()), static_cast<uint32_t>(sink_data.size()), 0};
+
+    // One workgroup per emitter, each thread appends at most one particle
+    std::array<VkDescriptorSet, 2> sets = {data_set, set};
+    emit_pipeline->bind_descriptor_sets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, 0, static_cast<uint32_t>(sets.size()), sets.data());
+    emit_pipeline->bind_push_constants(commandbuffer, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstant), &constant);
+    emit_pipeline->bind_pipeline(commandbuffer);
+    vkCmdDispatch(commandbuffer, static_cast<uint32_t>(emitter_data.size()), 1, 1);
+
+    VkBufferMemoryBarrier data_barrier{};
+    data_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    data_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    data_barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+    data_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    data_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    data_barrier.buffer = data_buffer;
+    data_barrier.offset = 0;
+    data_barrier.size = VK_WHOLE_SIZE;
+
+    vkCmdPipelineBarrier(
+      commandbuffer,
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      0,
+      0, nullptr,
+      1, &data_barrier,
+      0, nullptr
+    );
+
+    count_barrier(commandbuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+  }
+
+  // Clamp to the capacity and size the passes that run before the sort
+  update_counts(commandbuffer, 0);
+}
+
+void Population::settle(VkCommandBuffer commandbuffer) {
+  // Dead particles are now at the tail, drop them from the live count
+  update_counts(commandbuffer, 1);
+}
+
+void Population::remove(VkCommandBuffer commandbuffer, VkDescriptorSet data_set, VkBuffer data_buffer) {
+  if (sink_data.empty()) {
+    return;
+  }
+
+  PushConstant constant = {capacity, static_cast<uint32_t>(emitter_data.size()), static_cast<uint32_t>(sink_data.size()), 0};
+
+  std::array<VkDescriptorSet, 2> sets = {data_set, set};
+  sink_pipeline->bind_descriptor_sets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, 0, static_cast<uint32_t>(sets.size()), sets.data());
+  sink_pipeline->bind_push_constants(commandbuffer, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstant), &constant);
+  sink_pipeline->bind_pipeline(commandbuffer);
+  dispatch_live(commandbuffer);
+
+  VkBufferMemoryBarrier data_barrier{};
+  data_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  data_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  data_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  data_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  data_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  data_barrier.buffer = data_buffer;
+  data_barrier.offset = 0;
+  data_barrier.size = VK_WHOLE_SIZE;
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+    0,
+    0, nullptr,
+    1, &data_barrier,
+    0, nullptr
+  );
+
+  count_barrier(commandbuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+}
+
+void Population::read_back(VkCommandBuffer commandbuffer) {
+  VkBufferMemoryBarrier count_barrier{};
+  count_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  count_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  count_barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  count_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  count_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  count_barrier.buffer = counts->buffer;
+  count_barrier.offset = 0;
+  count_barrier.size = VK_WHOLE_SIZE;
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    VK_PIPELINE_STAGE_TRANSFER_BIT,
+    0,
+    0, nullptr,
+    1, &count_barrier,
+    0, nullptr
+  );
+
+  VkBufferCopy region{};
+  region.size = sizeof(PopulationCounts);
+  vkCmdCopyBuffer(commandbuffer, counts->buffer, readback->buffer, 1, &region);
+
+  VkBufferMemoryBarrier host_barrier{};
+  host_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  host_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  host_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  host_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  host_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  host_barrier.buffer = readback->buffer;
+  host_barrier.offset = 0;
+  host_barrier.size = VK_WHOLE_SIZE;
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_TRANSFER_BIT,
+    VK_PIPELINE_STAGE_HOST_BIT,
+    0,
+    0, nullptr,
+    1, &host_barrier,
+    0, nullptr
+  );
+}
+
+uint32_t Population::occupied() const {
+  // A single aligned word, a copy landing meanwhile gives the old or the new total
+  const volatile PopulationCounts* values = static_cast<const volatile PopulationCounts*>(readback->map());
+  return values->total;
+}
+
+void Population::dispatch_live(VkCommandBuffer commandbuffer) {
+  vkCmdDispatchIndirect(commandbuffer, counts->buffer, offsetof(PopulationCounts, live_x));
+}
+
+void Population::dispatch_total(VkCommandBuffer commandbuffer) {
+  vkCmdDispatchIndirect(commandbuffer, counts->buffer, offsetof(PopulationCounts, total_x));
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "../../buffer/Buffer.hpp"
+#include "../../buffer/HostBuffer.hpp"
+#include "../../pipeline/ComputePipeline.hpp"
+#include "../../descriptors/DescriptorBuilder.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <vector>
+
+struct ParticleEmitter {
+  // Centre of the spawn sphere
+  glm::vec3 position = glm::vec3(0.0f);
+  float radius = 0.2f;
+  glm::vec3 velocity = glm::vec3(0.0f);
+  // Particles added per step, at most 256
+  uint32_t rate = 16;
+};
+
+struct ParticleSink {
+  glm::vec3 minimum = glm::vec3(0.0f);
+  glm::vec3 maximum = glm::vec3(0.0f);
+};
+
+// Device side counters, the first three words double as the indirect dispatch over live particles
+struct PopulationCounts {
+  uint32_t live_x;
+  uint32_t live_y;
+  uint32_t live_z;
+  uint32_t live;
+  uint32_t total_x;
+  uint32_t total_y;
+  uint32_t total_z;
+  // Live plus the particles emitted this step, before the sinks are removed
+  uint32_t total;
+  uint32_t dead;
+  uint32_t step;
+};
+
+class Population {
+
+  public:
+    // Live particles always sit at the front of the particle buffer. Sinks mark
+    // particles dead, the sort moves them to the tail and the tail is the free
+    // list emitters append to, so no pass needs the count on the host.
+    Population(VkDevice device, VkPhysicalDevice physical_device, uint32_t capacity);
+    void init(DescriptorBuilder& builder, VkDescriptorSetLayout data);
+
+    void add_emitter(const ParticleEmitter& emitter);
+    void add_sink(const ParticleSink& sink);
+
+    // step seeds the emitters, restored checkpoints carry theirs on
+    void reset(CommandPool& commandpool, uint32_t live, uint32_t step = 0);
+    void set_index_count(CommandPool& commandpool, uint32_t index_count);
+
+    void emit(VkCommandBuffer commandbuffer, VkDescriptorSet data_set, VkBuffer data_buffer);
+    void settle(VkCommandBuffer commandbuffer);
+    void remove(VkCommandBuffer commandbuffer, VkDescriptorSet data_set, VkBuffer data_buffer);
+
+    // Copies the counts into a mapped buffer at the end of a step, read a few
+    // frames late by occupied without waiting on the queue
+    void read_back(VkCommandBuffer commandbuffer);
+    // Live plus emitted slots as of the last step that landed
+    uint32_t occupied() const;
+
+    // Slots emitters may fill, the device must be idle
+    void set_capacity(uint32_t capacity) { this->capacity = capacity; }
+
+    void dispatch_live(VkCommandBuffer commandbuffer);
+    void dispatch_total(VkCommandBuffer commandbuffer);
+
+    VkBuffer count_buffer() const { return counts->buffer; }
+    VkBuffer draw_buffer() const { return draw->buffer; }
+
+    inline static constexpr uint32_t MAX_EMITTERS = 64;
+    inline static constexpr uint32_t MAX_SINKS = 64;
+
+    VkDescriptorSet set;
+    VkDescriptorSetLayout layout;
+
+  private:
+    void update_counts(VkCommandBuffer commandbuffer, uint32_t mode);
+    void count_barrier(VkCommandBuffer commandbuffer, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access);
+
+    struct PushConstant {
+      uint32_t capacity;
+      uint32_t emitter_count;
+      uint32_t sink_count;
+      uint32_t mode;
+    };
+
+    struct EmitterData {
+      // xyz centre, w radius
+      glm::vec4 position;
+      // xyz velocity, w rate
+      glm::vec4 velocity;
+    };
+
+    struct SinkData {
+      glm::vec4 minimum;
+      glm::vec4 maximum;
+    };
+
+    VkDevice device;
+    VkPhysicalDevice physical_device;
+
+    uint32_t capacity;
+
+    std::vector<EmitterData> emitter_data;
+    std::vector<SinkData> sink_data;
+
+    std::unique_ptr<Buffer> counts;
+
+    // VkDrawIndexedIndirectCommand for the instanced particle draw
+    std::unique_ptr<Buffer> draw;
+
+    // Host visible copy of counts written by read_back
+    std::unique_ptr<HostBuffer> readback;
+
+    std::unique_ptr<HostBuffer> emitters;
+    std::unique_ptr<HostBuffer> sinks;
+
+    std::unique_ptr<ComputePipeline> emit_pipeline;
+    std::unique_ptr<ComputePipeline> count_pipeline;
+    std::unique_ptr<ComputePipeline> sink_pipeline;
+};
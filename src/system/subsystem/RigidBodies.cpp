@@ -0,0 +1,358 @@
+
+#include "RigidBodies.hpp"
+#include "../Solver.hpp"
+#include "../../command/UploadManager.hpp"
+#include "../../renderpass/Swapchain.hpp"
+
+#include <vulkan/vulkan_core.h>
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <stdexcept>
+
+RigidBodies::RigidBodies(
+  VkDevice device,
+  VkPhysicalDevice physical_device,
+  uint32_t capacity
+) : device(device), physical_device(physical_device), capacity(std::min(capacity, MAX_BODIES)) {
+
+  bodies = std::make_unique<Buffer>(
+    device,
+    physical_device,
+    sizeof(BodyData)*this->capacity,
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+  );
+
+  accumulators = std::make_unique<Buffer>(
+    device,
+    physical_device,
+    sizeof(glm::ivec4)*5*this->capacity,
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+  );
+
+  cells = std::make_unique<Buffer>(
+    device,
+    physical_device,
+    sizeof(uint32_t)*(CELL_OVERFLOW + 2),
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+  );
+
+  pairs = std::make_unique<Buffer>(
+    device,
+    physical_device,
+    sizeof(uint32_t)*4 + sizeof(glm::uvec2)*MAX_PAIRS,
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+  );
+
+  static_assert(READBACK_SLOTS >= Swapchain::MAX_FRAMES_IN_FLIGHT, "one overflow readback per frame in flight");
+  uint32_t empty = 0;
+  for (auto& readback : readbacks) {
+    readback = std::make_unique<HostBuffer>(device, physical_device, sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    readback->fillData(&empty, sizeof(uint32_t));
+  }
+}
+
+void RigidBodies::init(DescriptorBuilder& builder, VkDescriptorSetLayout boundary_layout) {
+  builder.clear();
+
+  builder.bind_buffer(0, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, bodies->get_info());
+  builder.bind_buffer(1, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, accumulators->get_info());
+  builder.bind_buffer(2, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, cells->get_info());
+  builder.bind_buffer(3, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, pairs->get_info());
+  builder.build(set, layout);
+  builder.clear();
+
+  builder.bind_buffer(0, VK_SHADER_STAGE_VERTEX_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, bodies->get_info());
+  builder.build(graphics_set, graphics_layout);
+  builder.clear();
+
+  VkPushConstantRange constant{};
+  constant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  constant.size = sizeof(PushConstant);
+  constant.offset = 0;
+
+  broad_pipeline = std::make_unique<ComputePipeline>(device, "shaders/vertex.broad.comp.spv");
+  broad_pipeline->create({layout}, {constant}, Solver::specialization());
+
+  narrow_pipeline = std::make_unique<ComputePipeline>(device, "shaders/vertex.narrow.comp.spv");
+  narrow_pipeline->create({layout}, {constant});
+
+  integrate_pipeline = std::make_unique<ComputePipeline>(device, "shaders/vertex.integrate.comp.spv");
+  integrate_pipeline->create({layout, boundary_layout}, {constant}, Solver::specialization());
+}
+
+void RigidBodies::add_body(const RigidBodyDesc& desc) {
+  if (body_count + pending.size() >= capacity) {
+    throw std::runtime_error("Too many rigid bodies");
+  }
+
+  glm::vec3 extent = desc.half_extent;
+  float volume;
+  float inertia;
+  float bounding;
+
+  if (desc.shape == RigidShape::Sphere) {
+    extent = glm::vec3(desc.half_extent.x);
+    volume = 4.0f / 3.0f * 3.1415926538f * extent.x * extent.x * extent.x;
+    inertia = 0.4f * extent.x * extent.x;
+    bounding = extent.x;
+  } else {
+    glm::vec3 size = 2.0f * extent;
+    volume = size.x * size.y * size.z;
+    // Scalar approximation of the box inertia tensor
+    inertia = (glm::dot(size, size) * 2.0f / 3.0f) / 12.0f;
+    bounding = glm::length(extent);
+  }
+
+  float mass = desc.density * volume;
+
+  BodyData body{};
+  body.position = glm::vec4(desc.position, mass > 0.0f ? 1.0f / mass : 0.0f);
+  body.orientation = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+  body.velocity = glm::vec4(desc.velocity, static_cast<float>(desc.shape));
+  body.angular = glm::vec4(0.0f, 0.0f, 0.0f, mass > 0.0f ? 1.0f / (mass * inertia) : 0.0f);
+  body.extent = glm::vec4(extent, bounding);
+
+  pending.push_back(body);
+}
+
+void RigidBodies::upload(CommandPool& commandpool) {
+  VkCommandBuffer commandbuffer = commandpool.start_single_command();
+  vkCmdFillBuffer(commandbuffer, accumulators->buffer, 0, VK_WHOLE_SIZE, 0);
+  // The move pass reads the grid even before the first broad phase
+  vkCmdFillBuffer(commandbuffer, cells->buffer, 0, VK_WHOLE_SIZE, 0);
+  commandpool.end_single_command(commandbuffer);
+
+  if (pending.empty()) {
+    return;
+  }
+
+  VkDeviceSize size = sizeof(BodyData) * pending.size();
+  commandpool.uploads().upload(bodies->buffer, sizeof(BodyData) * body_count, pending.data(), size);
+
+  body_count += static_cast<uint32_t>(pending.size());
+  pending.clear();
+}
+
+void RigidBodies::broad_phase(VkCommandBuffer commandbuffer) {
+  vkCmdFillBuffer(commandbuffer, cells->buffer, 0, VK_WHOLE_SIZE, 0);
+  vkCmdFillBuffer(commandbuffer, pairs->buffer, 0, sizeof(uint32_t)*4, 0);
+
+  std::array<VkBufferMemoryBarrier, 2> reset_barriers{};
+  std::array<VkBuffer, 2> buffers = {cells->buffer, pairs->buffer};
+  for (size_t i = 0; i < reset_barriers.size(); i++) {
+    reset_barriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    reset_barriers[i].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    reset_barriers[i].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    reset_barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    reset_barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    reset_barriers[i].buffer = buffers[i];
+    reset_barriers[i].offset = 0;
+    reset_barriers[i].size = VK_WHOLE_SIZE;
+  }
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_TRANSFER_BIT,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    0,
+    0, nullptr,
+    static_cast<uint32_t>(reset_barriers.size()), reset_barriers.data(),
+    0, nullptr
+  );
+
+  PushConstant constant = {body_count};
+
+  // Single workgroup sorts the bounds along x in shared memory and sweeps
+  broad_pipeline->bind_descriptor_sets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, 0, 1, &set);
+  broad_pipeline->bind_push_constants(commandbuffer, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstant), &constant);
+  broad_pipeline->bind_pipeline(commandbuffer);
+  vkCmdDispatch(commandbuffer, 1, 1, 1);
+
+  std::array<VkBufferMemoryBarrier, 2> broad_barriers{};
+  for (size_t i = 0; i < broad_barriers.size(); i++) {
+    broad_barriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    broad_barriers[i].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    broad_barriers[i].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    broad_barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    broad_barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    broad_barriers[i].buffer = buffers[i];
+    broad_barriers[i].offset = 0;
+    broad_barriers[i].size = VK_WHOLE_SIZE;
+  }
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    0,
+    0, nullptr,
+    static_cast<uint32_t>(broad_barriers.size()), broad_barriers.data(),
+    0, nullptr
+  );
+}
+
+void RigidBodies::narrow_phase(VkCommandBuffer commandbuffer) {
+  PushConstant constant = {body_count};
+
+  narrow_pipeline->bind_descriptor_sets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, 0, 1, &set);
+  narrow_pipeline->bind_push_constants(commandbuffer, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstant), &constant);
+  narrow_pipeline->bind_pipeline(commandbuffer);
+  vkCmdDispatchIndirect(commandbuffer, pairs->buffer, 0);
+
+  VkBufferMemoryBarrier accumulator_barrier{};
+  accumulator_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  accumulator_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  accumulator_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  accumulator_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  accumulator_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  accumulator_barrier.buffer = accumulators->buffer;
+  accumulator_barrier.offset = 0;
+  accumulator_barrier.size = VK_WHOLE_SIZE;
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    0,
+    0, nullptr,
+    1, &accumulator_barrier,
+    0, nullptr
+  );
+}
+
+void RigidBodies::read_overflow(VkCommandBuffer commandbuffer) {
+  HostBuffer& readback = *readbacks[frame];
+
+  // Earlier steps of the same submit copy into the same slot
+  std::array<VkBufferMemoryBarrier, 2> copy_barriers{};
+  copy_barriers[0].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  copy_barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  copy_barriers[0].buffer = cells->buffer;
+  copy_barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  copy_barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  copy_barriers[1].buffer = readback.buffer;
+  for (auto& barrier : copy_barriers) {
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+  }
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+    VK_PIPELINE_STAGE_TRANSFER_BIT,
+    0,
+    0, nullptr,
+    static_cast<uint32_t>(copy_barriers.size()), copy_barriers.data(),
+    0, nullptr
+  );
+
+  VkBufferCopy region{};
+  region.srcOffset = sizeof(uint32_t) * CELL_OVERFLOW;
+  region.size = sizeof(uint32_t);
+  vkCmdCopyBuffer(commandbuffer, cells->buffer, readback.buffer, 1, &region);
+
+  // The next broad phase clears the cells the copy read
+  std::array<VkBufferMemoryBarrier, 2> host_barriers = copy_barriers;
+  host_barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  host_barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  host_barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  host_barriers[1].dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_TRANSFER_BIT,
+    VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+    0,
+    0, nullptr,
+    static_cast<uint32_t>(host_barriers.size()), host_barriers.data(),
+    0, nullptr
+  );
+}
+
+void RigidBodies::begin_frame(uint32_t current_frame) {
+  frame = current_frame % READBACK_SLOTS;
+  if (body_count == 0) {
+    return;
+  }
+
+  uint32_t dropped = 0;
+  readbacks[frame]->getData(&dropped);
+  if (dropped > max_overflow) {
+    max_overflow = dropped;
+    std::cout << "Rigid bodies: " << dropped << " body cell entries past the " << CELL_SLOTS
+              << " slots, fluid there checks every body" << '\n';
+  }
+}
+
+void RigidBodies::detect_collisions(VkCommandBuffer commandbuffer) {
+  if (body_count == 0) {
+    return;
+  }
+
+  broad_phase(commandbuffer);
+  read_overflow(commandbuffer);
+  narrow_phase(commandbuffer);
+}
+
+void RigidBodies::integrate(VkCommandBuffer commandbuffer, VkDescriptorSet boundary_set, uint32_t boundary_offset) {
+  if (body_count == 0) {
+    return;
+  }
+
+  // Fluid forces were accumulated by the move pass
+  VkBufferMemoryBarrier accumulator_barrier{};
+  accumulator_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  accumulator_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  accumulator_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  accumulator_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  accumulator_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  accumulator_barrier.buffer = accumulators->buffer;
+  accumulator_barrier.offset = 0;
+  accumulator_barrier.size = VK_WHOLE_SIZE;
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    0,
+    0, nullptr,
+    1, &accumulator_barrier,
+    0, nullptr
+  );
+
+  PushConstant constant = {body_count};
+
+  std::array<VkDescriptorSet, 2> sets = {set, boundary_set};
+  integrate_pipeline->bind_descriptor_sets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, 0, static_cast<uint32_t>(sets.size()), sets.data(), 1, &boundary_offset);
+  integrate_pipeline->bind_push_constants(commandbuffer, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstant), &constant);
+  integrate_pipeline->bind_pipeline(commandbuffer);
+  vkCmdDispatch(commandbuffer, (body_count / 64) + 1, 1, 1);
+
+  VkBufferMemoryBarrier body_barrier{};
+  body_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  body_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  body_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  body_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  body_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  body_barrier.buffer = bodies->buffer;
+  body_barrier.offset = 0;
+  body_barrier.size = VK_WHOLE_SIZE;
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+    0,
+    0, nullptr,
+    1, &body_barrier,
+    0, nullptr
+  );
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "../../buffer/Buffer.hpp"
+#include "../../buffer/HostBuffer.hpp"
+#include "../../pipeline/ComputePipeline.hpp"
+#include "../../descriptors/DescriptorBuilder.hpp"
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/glm.hpp>
+
+#include <array>
+#include <memory>
+#include <vector>
+
+enum class RigidShape : uint32_t {
+  Sphere = 0,
+  Box = 1,
+};
+
+struct RigidBodyDesc {
+  RigidShape shape = RigidShape::Sphere;
+  glm::vec3 position = glm::vec3(0.0f);
+  glm::vec3 velocity = glm::vec3(0.0f);
+  // Radius in x for spheres
+  glm::vec3 half_extent = glm::vec3(0.5f);
+  // Zero makes the body static
+  float density = 200.0f;
+};
+
+struct BodyData {
+  // xyz position, w inverse mass
+  glm::vec4 position;
+  // Quaternion xyzw
+  glm::vec4 orientation;
+  // xyz velocity, w shape
+  glm::vec4 velocity;
+  // xyz angular velocity, w inverse inertia
+  glm::vec4 angular;
+  // Half extents (radius in x for spheres), w bounding radius
+  glm::vec4 extent;
+};
+
+class RigidBodies {
+
+  public:
+    // Broad phase, GJK/EPA narrow phase and integration all run on the GPU,
+    // fluid forces reach the bodies through fixed point atomics in the move pass
+    RigidBodies(VkDevice device, VkPhysicalDevice physical_device, uint32_t capacity);
+    void init(DescriptorBuilder& builder, VkDescriptorSetLayout boundary_layout);
+
+    void add_body(const RigidBodyDesc& desc);
+    void upload(CommandPool& commandpool);
+
+    // Reports body cell overflow copied back by this frame slot last time,
+    // after its fence has signalled
+    void begin_frame(uint32_t frame);
+
+    void detect_collisions(VkCommandBuffer commandbuffer);
+    void integrate(VkCommandBuffer commandbuffer, VkDescriptorSet boundary_set, uint32_t boundary_offset);
+
+    uint32_t count() const { return body_count; }
+    // Most body entries one broad phase could not fit in the cell slots so far
+    uint32_t overflow() const { return max_overflow; }
+
+    inline static constexpr uint32_t MAX_BODIES = 1024;
+    inline static constexpr uint32_t MAX_PAIRS = 16384;
+    inline static constexpr uint32_t CELL_COUNT = 4096;
+    inline static constexpr uint32_t CELL_SLOTS = 15;
+    // Past the cells, the entries dropped from full cells and the body count.
+    // Fluid in a full cell falls back to every body, see move.comp.
+    inline static constexpr uint32_t CELL_OVERFLOW = CELL_COUNT * (CELL_SLOTS + 1);
+    inline static constexpr uint32_t READBACK_SLOTS = 4;
+
+    VkDescriptorSet set;
+    VkDescriptorSetLayout layout;
+
+    VkDescriptorSet graphics_set;
+    VkDescriptorSetLayout graphics_layout;
+
+  private:
+    void broad_phase(VkCommandBuffer commandbuffer);
+    void narrow_phase(VkCommandBuffer commandbuffer);
+    void read_overflow(VkCommandBuffer commandbuffer);
+
+    struct PushConstant {
+      uint32_t body_count;
+    };
+
+    VkDevice device;
+    VkPhysicalDevice physical_device;
+
+    uint32_t capacity;
+    uint32_t body_count = 0;
+
+    std::vector<BodyData> pending;
+
+    std::unique_ptr<Buffer> bodies;
+
+    // Fixed point force, torque, impulse, angular impulse and correction per body
+    std::unique_ptr<Buffer> accumulators;
+
+    // Coarse hash grid listing the bodies overlapping each cell
+    std::unique_ptr<Buffer> cells;
+
+    // Indirect dispatch size and count followed by the overlapping pairs
+    std::unique_ptr<Buffer> pairs;
+
+    // Overflow count of the last broad phase in each frame slot
+    std::array<std::unique_ptr<HostBuffer>, READBACK_SLOTS> readbacks;
+    uint32_t frame = 0;
+    uint32_t max_overflow = 0;
+
+    std::unique_ptr<ComputePipeline> broad_pipeline;
+    std::unique_ptr<ComputePipeline> narrow_pipeline;
+    std::unique_ptr<ComputePipeline> integrate_pipeline;
+};
@@ -0,0 +1,226 @@
+
+#include "Sleep.hpp"
+#include "../Solver.hpp"
+#include <vulkan/vulkan_core.h>
+#include <array>
+#include <vector>
+
+Sleep::Sleep(
+  VkDevice device,
+  VkPhysicalDevice physical_device,
+  uint32_t count,
+  uint32_t table_cells
+) : device(device), physical_device(physical_device), data_count(count), table_cells(table_cells) {
+
+  cells = std::make_unique<Buffer>(
+    device,
+    physical_device,
+    sizeof(uint32_t)*table_cells,
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+  );
+
+  create_active();
+
+  // x, y, z group counts followed by the active particle count
+  arguments = std::make_unique<Buffer>(
+    device,
+    physical_device,
+    sizeof(uint32_t)*4,
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+  );
+}
+
+void Sleep::create_active() {
+  active = std::make_unique<Buffer>(
+    device,
+    physical_device,
+    sizeof(uint32_t)*data_count,
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+  );
+}
+
+void Sleep::resize(DescriptorBuilder& builder, uint32_t count) {
+  data_count = count;
+  create_active();
+
+  builder.bind_buffer(0, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, active->get_info());
+  builder.update(active_set);
+  builder.clear();
+}
+
+void Sleep::init(DescriptorBuilder& builder, VkDescriptorSetLayout data_layout, VkDescriptorSetLayout density_layout, VkDescriptorSetLayout count_layout, VkDescriptorSetLayout boundary_layout, VkDescriptorSetLayout body_layout) {
+  builder.clear();
+
+  builder.bind_buffer(1, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, cells->get_info());
+  builder.build(cell_set, cell_layout);
+  builder.clear();
+
+  // binding 0 for the indices, binding 1 for the dispatch arguments
+  builder.bind_buffer(0, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, active->get_info());
+  builder.bind_buffer(1, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, arguments->get_info());
+  builder.build(active_set, active_layout);
+  builder.clear();
+
+  VkPushConstantRange constant{};
+  constant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  constant.size = sizeof(PushConstant);
+  constant.offset = 0;
+
+  mark_pipeline = std::make_unique<ComputePipeline>(device, "shaders/vertex.mark.comp.spv");
+  mark_pipeline->create({data_layout, cell_layout, count_layout, boundary_layout, body_layout}, {constant}, Solver::specialization());
+
+  compact_pipeline = std::make_unique<ComputePipeline>(device, "shaders/vertex.compact.comp.spv");
+  compact_pipeline->create({data_layout, cell_layout, active_layout, density_layout, count_layout, data_layout}, {constant}, Solver::specialization());
+
+  arguments_pipeline = std::make_unique<ComputePipeline>(device, "shaders/vertex.arguments.comp.spv");
+  arguments_pipeline->create({active_layout}, {constant});
+}
+
+void Sleep::reset(VkCommandBuffer commandbuffer, bool sleeping) {
+  // Without sleeping the cells are never marked or read
+  if (sleeping) {
+    vkCmdFillBuffer(commandbuffer, cells->buffer, 0, cells->size, 0);
+  }
+  vkCmdFillBuffer(commandbuffer, arguments->buffer, 0, arguments->size, 0);
+
+  std::array<VkBufferMemoryBarrier, 2> reset_barriers{};
+  std::array<VkBuffer, 2> buffers = {arguments->buffer, cells->buffer};
+  uint32_t barrier_count = sleeping ? 2 : 1;
+  for (size_t i = 0; i < barrier_count; i++) {
+    reset_barriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    reset_barriers[i].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    reset_barriers[i].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    reset_barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    reset_barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    reset_barriers[i].buffer = buffers[i];
+    reset_barriers[i].offset = 0;
+    reset_barriers[i].size = VK_WHOLE_SIZE;
+  }
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_TRANSFER_BIT,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    0,
+    0, nullptr,
+    barrier_count, reset_barriers.data(),
+    0, nullptr
+  );
+}
+
+void Sleep::mark_cells(VkCommandBuffer commandbuffer, VkDescriptorSet data_set, VkDescriptorSet count_set, VkBuffer count_buffer, VkDeviceSize count_offset, VkDescriptorSet boundary_set, uint32_t boundary_offset, VkDescriptorSet body_set) {
+  PushConstant constant = {data_count, Solver::rest_steps, moved_faces, waking_all ? 1u : 0u};
+
+  std::array<VkDescriptorSet, 5> sets = {data_set, cell_set, count_set, boundary_set, body_set};
+  mark_pipeline->bind_descriptor_sets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, 0, static_cast<uint32_t>(sets.size()), sets.data(), 1, &boundary_offset);
+  mark_pipeline->bind_push_constants(commandbuffer, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstant), &constant);
+  mark_pipeline->bind_pipeline(commandbuffer);
+  vkCmdDispatchIndirect(commandbuffer, count_buffer, count_offset);
+
+  VkBufferMemoryBarrier cell_barrier{};
+  cell_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  cell_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  cell_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  cell_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  cell_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  cell_barrier.buffer = cells->buffer;
+  cell_barrier.offset = 0;
+  cell_barrier.size = VK_WHOLE_SIZE;
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    0,
+    0, nullptr,
+    1, &cell_barrier,
+    0, nullptr
+  );
+}
+
+void Sleep::compact(VkCommandBuffer commandbuffer, VkDescriptorSet data_set, VkDescriptorSet write_set, VkDescriptorSet density_set, VkBuffer density_buffer, VkDescriptorSet count_set, VkBuffer count_buffer, VkDeviceSize count_offset) {
+  PushConstant constant = {data_count, Solver::rest_steps, 0, 0};
+
+  std::array<VkDescriptorSet, 6> sets = {data_set, cell_set, active_set, density_set, count_set, write_set};
+  compact_pipeline->bind_descriptor_sets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, 0, static_cast<uint32_t>(sets.size()), sets.data());
+  compact_pipeline->bind_push_constants(commandbuffer, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstant), &constant);
+  compact_pipeline->bind_pipeline(commandbuffer);
+  vkCmdDispatchIndirect(commandbuffer, count_buffer, count_offset);
+
+  std::vector<VkBufferMemoryBarrier> barriers;
+  for (VkBuffer buffer : {active->buffer, arguments->buffer, density_buffer}) {
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = buffer;
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+
+    barriers.push_back(barrier);
+  }
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    0,
+    0, nullptr,
+    static_cast<uint32_t>(barriers.size()), barriers.data(),
+    0, nullptr
+  );
+}
+
+void Sleep::write_arguments(VkCommandBuffer commandbuffer) {
+  PushConstant constant = {data_count, Solver::rest_steps, 0, 0};
+
+  arguments_pipeline->bind_descriptor_sets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, 0, 1, &active_set);
+  arguments_pipeline->bind_push_constants(commandbuffer, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(PushConstant), &constant);
+  arguments_pipeline->bind_pipeline(commandbuffer);
+  vkCmdDispatch(commandbuffer, 1, 1, 1);
+
+  VkBufferMemoryBarrier arguments_barrier{};
+  arguments_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  arguments_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  arguments_barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+  arguments_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  arguments_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  arguments_barrier.buffer = arguments->buffer;
+  arguments_barrier.offset = 0;
+  arguments_barrier.size = VK_WHOLE_SIZE;
+
+  vkCmdPipelineBarrier(
+    commandbuffer,
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+    0,
+    0, nullptr,
+    1, &arguments_barrier,
+    0, nullptr
+  );
+}
+
+void Sleep::run(VkCommandBuffer commandbuffer, VkDescriptorSet data_set, VkDescriptorSet write_set, VkDescriptorSet density_set, VkBuffer density_buffer, VkDescriptorSet count_set, VkBuffer count_buffer, VkDeviceSize count_offset, VkDescriptorSet boundary_set, uint32_t boundary_offset, VkDescriptorSet body_set) {
+  bool sleeping = Solver::rest_steps != 0;
+
+  reset(commandbuffer, sleeping);
+  // With sleeping off, compaction lists every live particle without looking at the cells
+  if (sleeping) {
+    mark_cells(commandbuffer, data_set, count_set, count_buffer, count_offset, boundary_set, boundary_offset, body_set);
+  }
+  // The wake requests only hold for the step they were made before
+  moved_faces = 0;
+  waking_all = false;
+
+  compact(commandbuffer, data_set, write_set, density_set, density_buffer, count_set, count_buffer, count_offset);
+  write_arguments(commandbuffer);
+}
+
+void Sleep::dispatch(VkCommandBuffer commandbuffer) {
+  vkCmdDispatchIndirect(commandbuffer, arguments->buffer, 0);
+}
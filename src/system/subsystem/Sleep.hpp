@@ -0,0 +1,73 @@
+#pragma once
+
+#include "../../buffer/Buffer.hpp"
+#include "../../pipeline/ComputePipeline.hpp"
+#include "../../descriptors/DescriptorBuilder.hpp"
+
+#include <memory>
+
+
+class Sleep {
+
+  public:
+    // Particles whose velocity and density stayed below the rest thresholds
+    // for Solver::rest_steps steps are left out of the active list, unless a
+    // neighbouring cell still holds an awake particle, a box face that moved
+    // or a moving rigid body is within reach.
+    Sleep(VkDevice device, VkPhysicalDevice physical_device, uint32_t count, uint32_t table_cells);
+    void init(DescriptorBuilder& builder, VkDescriptorSetLayout data, VkDescriptorSetLayout density, VkDescriptorSetLayout count, VkDescriptorSetLayout boundary, VkDescriptorSetLayout bodies);
+    // Reallocates the active list for count particles and rewrites its set, the
+    // device must be idle. The list is rebuilt every step.
+    void resize(DescriptorBuilder& builder, uint32_t count);
+
+    // Marking and compaction run over the live particles, dispatched from the count buffer.
+    // Compaction copies the sleeping particles from data_set into write_set.
+    void run(VkCommandBuffer commandbuffer, VkDescriptorSet data_set, VkDescriptorSet write_set, VkDescriptorSet density_set, VkBuffer density_buffer, VkDescriptorSet count_set, VkBuffer count_buffer, VkDeviceSize count_offset, VkDescriptorSet boundary_set, uint32_t boundary_offset, VkDescriptorSet body_set);
+    void dispatch(VkCommandBuffer commandbuffer);
+
+    // Wakes the resting particles near the given box faces on the next run,
+    // one bit per face in BoxBoundary order
+    void wake_faces(uint32_t faces) { moved_faces |= faces; }
+    // Wakes every particle on the next run, for boundary changes the faces can't describe
+    void wake_all() { waking_all = true; }
+
+    VkDescriptorSet active_set;
+    VkDescriptorSetLayout active_layout;
+
+  private:
+    void create_active();
+    void reset(VkCommandBuffer commandbuffer, bool sleeping);
+    void mark_cells(VkCommandBuffer commandbuffer, VkDescriptorSet data_set, VkDescriptorSet count_set, VkBuffer count_buffer, VkDeviceSize count_offset, VkDescriptorSet boundary_set, uint32_t boundary_offset, VkDescriptorSet body_set);
+    void compact(VkCommandBuffer commandbuffer, VkDescriptorSet data_set, VkDescriptorSet write_set, VkDescriptorSet density_set, VkBuffer density_buffer, VkDescriptorSet count_set, VkBuffer count_buffer, VkDeviceSize count_offset);
+    void write_arguments(VkCommandBuffer commandbuffer);
+
+    struct PushConstant {
+      uint32_t particle_count;
+      uint32_t rest_steps;
+      uint32_t moved_faces;
+      uint32_t wake_all;
+    };
+
+    VkDevice device;
+    VkPhysicalDevice physical_device;
+
+    uint32_t data_count;
+    uint32_t table_cells;
+
+    uint32_t moved_faces = 0;
+    bool waking_all = false;
+
+    VkDescriptorSet cell_set;
+    VkDescriptorSetLayout cell_layout;
+
+    // One flag per hash cell, set when the cell holds an awake particle
+    std::unique_ptr<Buffer> cells;
+
+    // Compacted awake particle indices, and the indirect dispatch size with the active count
+    std::unique_ptr<Buffer> active;
+    std::unique_ptr<Buffer> arguments;
+
+    std::unique_ptr<ComputePipeline> mark_pipeline;
+    std::unique_ptr<ComputePipeline> compact_pipeline;
+    std::unique_ptr<ComputePipeline> arguments_pipeline;
+};
@@ -1,6 +1,7 @@
 
 #include "Sort.hpp"
 #include "../../buffer/HostBuffer.hpp"
+#include "../Solver.hpp"
 #include "../FluidSystem.hpp"
 #include <vulkan/vulkan_core.h>
 #include <array>
@@ -13,13 +14,29 @@ Sort::Sort(
   uint32_t size
 ) : device(device), physical_device(physical_device), data_count(count), data_size(size) {
 
+  data_temp_set.resize(2);
+  scan_set.resize(4);
+  create_buffers();
+
+  offset = std::make_unique<Buffer>(
+    device, 
+    physical_device, 
+    sizeof(uint32_t), 
+    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 
+    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+  );
+}
+
+void Sort::create_buffers() {
+  data_temp.clear();
+  scans.clear();
+
   data_temp.reserve(2);
-  data_temp_set.reserve(2);
   for (size_t i = 0; i < 2; i++) {
     data_temp.emplace_back(
       device, 
       physical_device, 
-      data_count*data_size, 
+      static_cast<VkDeviceSize>(data_count)*data_size, 
       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 
       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
     ); 
@@ -28,21 +45,12 @@ Sort::Sort(
   keys = std::make_unique<Buffer>(
     device, 
     physical_device, 
-    data_size*data_count, 
-    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 
-    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-  ); 
-
-  offset = std::make_unique<Buffer>(
-    device, 
-    physical_device, 
-    sizeof(uint32_t), 
+    static_cast<VkDeviceSize>(data_count)*data_size, 
     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 
     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
   ); 
 
   scans.reserve(4);
-  scan_set.resize(4);
   for (size_t i = 0; i < 4; i++) {
     scans.emplace_back(
       device, 
@@ -54,11 +62,7 @@ Sort::Sort(
   }
 }
 
-void Sort::init(DescriptorBuilder& handler, VkDescriptorSetLayout data_layout, uint32_t x, uint32_t y, uint32_t z) {
-  
-  groupCountX = x;
-  groupCountY = y;
-  groupCountZ = z;
+void Sort::init(DescriptorBuilder& handler, VkDescriptorSetLayout data_layout, VkDescriptorSetLayout count_layout) {
 
 
   handler.clear();
@@ -102,29 +106,52 @@ void Sort::init(DescriptorBuilder& handler, VkDescriptorSetLayout data_layout, u
 
 
   key_pipeline = std::make_unique<ComputePipeline>(device, "shaders/vertex.key.comp.spv");
-  key_pipeline->create({key_layout, data_temp_layout, scan_layout, scan_layout, scan_layout, scan_layout}, {constant});
+  key_pipeline->create({key_layout, data_temp_layout, scan_layout, scan_layout, scan_layout, scan_layout, count_layout}, {constant}, Solver::specialization());
 
   // Calculating offset from histogram 
   offset_pipeline = std::make_unique<ComputePipeline>(device, "shaders/vertex.offset.comp.spv");   
-  offset_pipeline->create({data_temp_layout, offset_layout}, {constant});
+  offset_pipeline->create({data_temp_layout, offset_layout, count_layout}, {constant});
 
 
   // Changing digits into 1 and 0's
   digits_pipeline = std::make_unique<ComputePipeline>(device, "shaders/vertex.digits.comp.spv");
-  digits_pipeline->create({scan_layout}, {constant});
+  digits_pipeline->create({scan_layout, count_layout}, {constant});
 
   // exlcusive prefix scan for digits
   scanning_pipeline = std::make_unique<ComputePipeline>(device, "shaders/vertex.scan.comp.spv");  
-  scanning_pipeline->create({scan_layout, scan_layout}, {constant});
+  scanning_pipeline->create({scan_layout, scan_layout, count_layout}, {constant});
 
   sorting_pipeline = std::make_unique<ComputePipeline>(device, "shaders/vertex.sort.comp.spv");  
-  sorting_pipeline->create({data_temp_layout, data_temp_layout, scan_layout, scan_layout, offset_layout}, {constant});
+  sorting_pipeline->create({data_temp_layout, data_temp_layout, scan_layout, scan_layout, offset_layout, count_layout}, {constant});
+}
+
+void Sort::resize(DescriptorBuilder& builder, uint32_t count) {
+  data_count = count;
+  create_buffers();
+
+  builder.clear();
+
+  builder.bind_buffer(0, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, keys->get_info());
+  builder.update(key_set);
+  builder.clear();
+
+  for (size_t i = 0; i < data_temp_set.size(); i++) {
+    builder.bind_buffer(0, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, data_temp[i].get_info());
+    builder.update(data_temp_set[i]);
+    builder.clear();
+  }
+
+  for (size_t i = 0; i < scan_set.size(); i++) {
+    builder.bind_buffer(2, VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, scans[i].get_info());
+    builder.update(scan_set[i]);
+    builder.clear();
+  }
 }
 
 void Sort::init_temp(VkCommandBuffer commandbuffer, VkBuffer initial, CommandPool& commandpool) {
   // Copies inital data in temp data at index 0
   VkBufferCopy data_region{};
-  data_region.size = data_count*data_size;
+  data_region.size = static_cast<VkDeviceSize>(data_count)*data_size;
   vkCmdCopyBuffer(commandbuffer, initial, data_temp[0].buffer, 1, &data_region);
 
   VkBufferMemoryBarrier data_copy_barrier{};
@@ -151,7 +178,7 @@ void Sort::init_temp(VkCommandBuffer commandbuffer, VkBuffer initial, CommandPoo
 
 void Sort::extract_key(VkCommandBuffer commandbuffer, uint32_t data_index) {
     VkBufferCopy data_region{};
-    data_region.size = data_count*data_size;
+    data_region.size = static_cast<VkDeviceSize>(data_count)*data_size;
     vkCmdCopyBuffer(commandbuffer, data_temp[data_index].buffer, keys->buffer, 1, &data_region);
 
     VkBufferMemoryBarrier data_copy_barrier{};
@@ -175,18 +202,19 @@ void Sort::extract_key(VkCommandBuffer commandbuffer, uint32_t data_index) {
       0, nullptr
     );
 
-    std::array<VkDescriptorSet, 6> key_sets = { 
+    std::array<VkDescriptorSet, 7> key_sets = { 
       key_set, 
       data_temp_set[data_index],
       scan_set[0],
       scan_set[1],
       scan_set[2],
       scan_set[3],
+      count_set,
     };
     key_pipeline->bind_descriptor_sets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, 0, static_cast<uint32_t>(key_sets.size()), key_sets.data());
     key_pipeline->bind_pipeline(commandbuffer);
     key_pipeline->bind_push_constants(commandbuffer, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(uint32_t), &data_count);
-    vkCmdDispatch(commandbuffer, groupCountX, groupCountY, groupCountZ);
+    dispatch(commandbuffer);
 
     std::vector<VkBufferMemoryBarrier> barriers;
     VkBufferMemoryBarrier key_barrier{};
@@ -257,11 +285,11 @@ void Sort::reset_offset(VkCommandBuffer commandbuffer) {
 void Sort::find_offset(VkCommandBuffer commandbuffer, uint32_t index, uint32_t data_index) {
     PushConstant constant = {data_count, index, 0};
 
-    std::array<VkDescriptorSet, 2> offset_sets = { data_temp_set[data_index], offset_set };
+    std::array<VkDescriptorSet, 3> offset_sets = { data_temp_set[data_index], offset_set, count_set };
     offset_pipeline->bind_descriptor_sets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, 0, static_cast<uint32_t>(offset_sets.size()), offset_sets.data());
     offset_pipeline->bind_push_constants(commandbuffer, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(uint32_t)*2, &constant);
     offset_pipeline->bind_pipeline(commandbuffer);
-    vkCmdDispatch(commandbuffer, groupCountX, groupCountY, groupCountZ);
+    dispatch(commandbuffer);
 
     VkBufferMemoryBarrier offset_barrier{};
     offset_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
@@ -288,6 +316,7 @@ void Sort::find_offset(VkCommandBuffer commandbuffer, uint32_t index, uint32_t d
 void Sort::digit_scans(VkCommandBuffer commandbuffer, uint32_t index) {
   uint32_t digit_count = 2;
   digits_pipeline->bind_pipeline(commandbuffer); 
+  digits_pipeline->bind_descriptor_sets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, 1, 1, &count_set);
 
   // First loop for 0's and 1's
   for (uint32_t i = 0; i < digit_count; i++) {
@@ -297,7 +326,7 @@ void Sort::digit_scans(VkCommandBuffer commandbuffer, uint32_t index) {
     // Second loop for read and write
     for (uint32_t j = i; j < digit_count + i; j++) {
       digits_pipeline->bind_descriptor_sets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, 0, 1, &scan_set[i + j]);
-      vkCmdDispatch(commandbuffer, groupCountX, groupCountY, groupCountZ);
+      dispatch(commandbuffer);
     }
   }
 
@@ -334,10 +363,10 @@ size_t Sort::dispatch_scan(VkCommandBuffer commandbuffer, std::array<VkDescripto
   for (size_t i = 1; i < data_count; i <<= 1) {
 
     PushConstant constant = {data_count, static_cast<uint32_t>(i)};
-    std::array<VkDescriptorSet, 2> set_buffering = {sets[read], sets[write]}; 
+    std::array<VkDescriptorSet, 3> set_buffering = {sets[read], sets[write], count_set}; 
     scanning_pipeline->bind_push_constants(commandbuffer, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(uint32_t)*2, &constant);
     scanning_pipeline->bind_descriptor_sets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, 0, static_cast<uint32_t>(set_buffering.size()), set_buffering.data());
-    vkCmdDispatch(commandbuffer, groupCountX, groupCountY, groupCountZ);
+    dispatch(commandbuffer);
 
     VkBufferMemoryBarrier scanning_barrier{};
     scanning_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
@@ -368,12 +397,13 @@ size_t Sort::dispatch_scan(VkCommandBuffer commandbuffer, std::array<VkDescripto
 
 
 void Sort::partition_sort(VkCommandBuffer commandbuffer, size_t index, size_t read_index, size_t write_index, size_t zero_index, size_t one_index) {
-    std::array<VkDescriptorSet, 5> sets = { 
+    std::array<VkDescriptorSet, 6> sets = { 
       data_temp_set[read_index], 
       data_temp_set[write_index], 
       scan_set[zero_index], 
       scan_set[one_index + 2], 
       offset_set,
+      count_set,
     };
 
     PushConstant constant = {data_count, static_cast<uint32_t>(index)};
@@ -381,7 +411,7 @@ void Sort::partition_sort(VkCommandBuffer commandbuffer, size_t index, size_t re
     sorting_pipeline->bind_pipeline(commandbuffer);
     sorting_pipeline->bind_descriptor_sets(commandbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, 0, static_cast<uint32_t>(sets.size()), sets.data());
     sorting_pipeline->bind_push_constants(commandbuffer, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(uint32_t)*2, &constant);
-    vkCmdDispatch(commandbuffer, groupCountX, groupCountY, groupCountZ);
+    dispatch(commandbuffer);
 
 
     VkBufferMemoryBarrier sorting_barrier{};
@@ -407,7 +437,7 @@ void Sort::partition_sort(VkCommandBuffer commandbuffer, size_t index, size_t re
 
 void Sort::final_fill(VkCommandBuffer commandbuffer, VkBuffer src, VkBuffer dst) {
   VkBufferCopy final_region{};
-  final_region.size = data_count*data_size;
+  final_region.size = static_cast<VkDeviceSize>(data_count)*data_size;
   vkCmdCopyBuffer(commandbuffer, src, dst, 1, &final_region);
 
   VkBufferMemoryBarrier fill_barrier{};
@@ -431,29 +461,55 @@ void Sort::final_fill(VkCommandBuffer commandbuffer, VkBuffer src, VkBuffer dst)
   );
 }
 
+void Sort::dispatch(VkCommandBuffer commandbuffer) {
+  vkCmdDispatchIndirect(commandbuffer, indirect_buffer, indirect_offset);
+}
+
 void Sort::run(
   CommandPool& commandpool, 
   VkCommandBuffer commandbuffer, 
-  VkBuffer data_buffer
+  VkBuffer data_buffer,
+  VkDescriptorSet count_set,
+  VkBuffer count_buffer,
+  VkDeviceSize count_offset
 ) {
+  this->count_set = count_set;
+  indirect_buffer = count_buffer;
+  indirect_offset = count_offset;
+
+  ProfileScope sort_scope(profiler, commandbuffer, "sort");
+
   size_t data_read_index = 0;
   size_t data_write_index = 1;
   init_temp(commandbuffer, data_buffer, commandpool);
 
   for (uint32_t index = 0; index < 32; index++) {
-    extract_key(commandbuffer, data_read_index);
-    reset_offset(commandbuffer);
-
-    find_offset(commandbuffer, index, data_read_index);
+    {
+      ProfileScope scope(profiler, commandbuffer, "sort key");
+      extract_key(commandbuffer, data_read_index);
+      reset_offset(commandbuffer);
+    }
 
+    {
+      ProfileScope scope(profiler, commandbuffer, "sort offset");
+      find_offset(commandbuffer, index, data_read_index);
+    }
 
-    digit_scans(commandbuffer, index);
+    size_t zeroes_index;
+    size_t ones_index;
+    {
+      ProfileScope scope(profiler, commandbuffer, "sort scan");
+      digit_scans(commandbuffer, index);
 
-    scanning_pipeline->bind_pipeline(commandbuffer);
-    size_t zeroes_index = dispatch_scan(commandbuffer, {scan_set[0], scan_set[1]}, {scans[0].buffer, scans[1].buffer});
-    size_t ones_index = dispatch_scan(commandbuffer, {scan_set[2], scan_set[3]}, {scans[2].buffer, scans[3].buffer});
+      scanning_pipeline->bind_pipeline(commandbuffer);
+      zeroes_index = dispatch_scan(commandbuffer, {scan_set[0], scan_set[1]}, {scans[0].buffer, scans[1].buffer});
+      ones_index = dispatch_scan(commandbuffer, {scan_set[2], scan_set[3]}, {scans[2].buffer, scans[3].buffer});
+    }
 
-    partition_sort(commandbuffer, index, data_read_index, data_write_index, zeroes_index, ones_index);
+    {
+      ProfileScope scope(profiler, commandbuffer, "sort scatter");
+      partition_sort(commandbuffer, index, data_read_index, data_write_index, zeroes_index, ones_index);
+    }
 
     data_read_index = (data_read_index + 1) % 2;
     data_write_index = (data_write_index + 1) % 2;
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "../../profiler/Profiler.hpp"
+
 #include "../../buffer/Buffer.hpp"
 #include "../../pipeline/ComputePipeline.hpp"
 #include "../../descriptors/DescriptorBuilder.hpp"
@@ -14,12 +16,20 @@ class Sort {
     // Have to ensure that data is binded before sorting is binded
     //
     Sort(VkDevice device, VkPhysicalDevice physical_device, uint32_t count, uint32_t size);
-    void init(DescriptorBuilder& builder, VkDescriptorSetLayout data, uint32_t x, uint32_t y, uint32_t z); 
+    // Every pass is dispatched indirectly, sized from the total in the count set
+    void init(DescriptorBuilder& builder, VkDescriptorSetLayout data, VkDescriptorSetLayout count);
+    // Reallocates the scratch buffers for count elements and rewrites their
+    // sets in place, the device must be idle. Nothing in them outlives a sort.
+    void resize(DescriptorBuilder& builder, uint32_t count);
 
-    void run(CommandPool& commandpool, VkCommandBuffer commandbuffer, VkBuffer data_buffer);
+    void run(CommandPool& commandpool, VkCommandBuffer commandbuffer, VkBuffer data_buffer, VkDescriptorSet count_set, VkBuffer count_buffer, VkDeviceSize count_offset);
     void print_data(CommandPool& commandpool, VkPhysicalDevice physical_device);
 
+    // Optional, every pass stage is timed under the same name
+    Profiler* profiler = nullptr;
+
   private:
+    void create_buffers();
     void init_temp(VkCommandBuffer commandbuffer, VkBuffer initial, CommandPool& commandpool);
     void extract_key(VkCommandBuffer commandbuffer, uint32_t data_index); 
     void reset_offset(VkCommandBuffer commandbuffer);
@@ -29,6 +39,7 @@ class Sort {
     size_t dispatch_scan(VkCommandBuffer commandbuffer, std::array<VkDescriptorSet, 2> sets, std::array<VkBuffer, 2> buffers);
     void partition_sort(VkCommandBuffer commandbuffer, size_t index, size_t read_index, size_t write_index, size_t zero_index, size_t one_index);
     void final_fill(VkCommandBuffer commandbuffer, VkBuffer src, VkBuffer dst);
+    void dispatch(VkCommandBuffer commandbuffer);
 
     struct PushConstant {
       uint32_t particle_count;
@@ -40,9 +51,9 @@ class Sort {
     VkPhysicalDevice physical_device;
 
 
-    uint32_t groupCountX;
-    uint32_t groupCountY;
-    uint32_t groupCountZ;
+    VkDescriptorSet count_set;
+    VkBuffer indirect_buffer;
+    VkDeviceSize indirect_offset;
 
     uint32_t data_count; 
     uint32_t data_size;